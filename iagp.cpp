@@ -29,9 +29,25 @@ SOFTWARE.
 
 #include <cstdarg> /* va_list, va_start, va_arg, va_end */
 #include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+
+#ifdef IAGP_USE_FLIGHT_RECORDER
+#ifdef _WIN32
+#include <windows.h>
+#else  // _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif  // _WIN32
+#endif  // IAGP_USE_FLIGHT_RECORDER
 
 #ifdef _MSC_VER
 #include <Windows.h>
+#include <intrin.h>
 #define DEBUG_BREAK          \
     if (IsDebuggerPresent()) \
     __debugbreak()
@@ -56,10 +72,10 @@ static IAGP_GPU_CONTEXT GetCurrentContext() {
 #endif  // GET_CURRENT_CONTEXT
 
 #ifndef IAGP_SET_CURRENT_CONTEXT
-static void SetCurrentContext(GPU_CONTEXT vContextPtr) {
+static void SetCurrentContext(IAGP_GPU_CONTEXT vContextPtr) {
     DEBUG_BREAK;  // you need to create your own function for get the opengl context
 }
-#define SET_CURRENT_CONTEXT SetCurrentContext
+#define IAGP_SET_CURRENT_CONTEXT SetCurrentContext
 #endif  // GET_CURRENT_CONTEXT
 
 #ifndef IAGP_LOG_ERROR_MESSAGE
@@ -115,29 +131,13 @@ static bool PlayPauseButton(bool& vPlayPause) {
 #define IAGP_DETAILS_TITLE "Profiler Details"
 #endif // IAGP_DETAILS_TITLE
 
-namespace iagp {
+#ifndef IAGP_OVERHEAD_TITLE
+#define IAGP_OVERHEAD_TITLE "Profiler Overhead"
+#endif  // IAGP_OVERHEAD_TITLE
 
-inline void checkGLErrors(const char* vFile, const char* vFunc, const int& vLine) {
-#ifdef _DEBUG
-    const GLenum err(glGetError());
-    if (err != GL_NO_ERROR) {
-        std::string error;
-        switch (err) {
-            case GL_INVALID_OPERATION: error = "INVALID_OPERATION"; break;
-            case GL_INVALID_ENUM: error = "INVALID_ENUM"; break;
-            case GL_INVALID_VALUE: error = "INVALID_VALUE"; break;
-            case GL_OUT_OF_MEMORY: error = "OUT_OF_MEMORY"; break;
-            case GL_INVALID_FRAMEBUFFER_OPERATION: error = "INVALID_FRAMEBUFFER_OPERATION"; break;
-            case GL_STACK_UNDERFLOW: error = "GL_STACK_UNDERFLOW"; break;
-            case GL_STACK_OVERFLOW: error = "GL_STACK_OVERFLOW"; break;
-        }
-        printf("[%s][%s][%i] GL Errors : %s\n", vFile, vFunc, vLine, error.c_str());
-        //DEBUG_BREAK;
-    }
-#endif
-}
+namespace iagp {
 
-#define CheckGLErrors checkGLErrors(__FILE__, __FUNCTION__, __LINE__)
+#define CheckGLErrors InAppGpuBackend::CheckErrors(__FILE__, __FUNCTION__, __LINE__)
 
 // contrast from 1 to 21
 // https://www.w3.org/TR/WCAG20/#relativeluminancedef
@@ -179,6 +179,18 @@ static std::string toStr(const char* fmt, ...) {
     return std::string();
 }
 
+// the cpu time in ns, from the steady clock
+static int64_t GetCpuTime() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the cpu time of the scope is added in the counter of the overhead, nothing without IAGP_USE_SELF_INSTRUMENTATION
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+#define IAGP_OVERHEAD_TIMER(COUNTER) InAppGpuOverheadTimer _overhead_timer(InAppGpuOverheadEnum::COUNTER)
+#else
+#define IAGP_OVERHEAD_TIMER(COUNTER)
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
 ////////////////////////////////////////////////////////////
 /////////////////////// QUERY ZONE /////////////////////////
 ////////////////////////////////////////////////////////////
@@ -187,257 +199,2291 @@ GLuint InAppGpuQueryZone::sMaxDepthToOpen = 100U;  // the max by default
 bool InAppGpuQueryZone::sShowLeafMode = false;
 float InAppGpuQueryZone::sContrastRatio = 4.3f;
 bool InAppGpuQueryZone::sActivateLogger = false;
-std::vector<IAGPQueryZoneWeak> InAppGpuQueryZone::sTabbedQueryZones = {};
-IAGPQueryZonePtr InAppGpuQueryZone::create(IAGP_GPU_CONTEXT vContext, const std::string& vName, const std::string& vSectionName,
-                                           const bool vIsRoot) {
-    auto res = std::make_shared<InAppGpuQueryZone>(vContext, vName, vSectionName, vIsRoot);
-    res->m_This = res;
+bool InAppGpuQueryZone::sShowCpuTrack = true;
+bool InAppGpuQueryZone::sShowFrameHistory = true;
+bool InAppGpuQueryZone::sUseLod = true;
+float InAppGpuQueryZone::sLodMinBarWidth = IAGP_LOD_MIN_BAR_WIDTH;
+InAppGpuQueryZone::circularSettings InAppGpuQueryZone::sCircularSettings;
+
+////////////////////////////////////////////////////////////
+/////////////////////// SMOOTHING //////////////////////////
+////////////////////////////////////////////////////////////
+
+float InAppGpuEmaSmoothing::sFactor = 2.0f / ((float)IAGP_MEAN_AVERAGE_LEVELS_COUNT + 1.0f);  // same age than the mean
+InAppGpuSmoothingEnum InAppGpuRuntimeSmoothing::sSmoothing = InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_EMA;
+
+void InAppGpuEmaSmoothing::AddValue(const double vValue) {
+    if (m_IsEmpty) {
+        m_Value = vValue;
+        m_IsEmpty = false;
+    } else {
+        m_Value += (vValue - m_Value) * (double)sFactor;
+    }
+}
+
+double InAppGpuEmaSmoothing::GetValue() const {
+    return m_Value;
+}
+
+void InAppGpuMeanSmoothing::AddValue(const double vValue) {
+    m_Accum += vValue - m_Values[m_Index];
+    m_Values[m_Index] = vValue;
+    m_Index = (m_Index + 1U) % sCountValues;
+    if (m_Count < sCountValues) {
+        ++m_Count;
+    }
+    if (m_Index == 0U) {
+        // the accumulated rounding errors are removed at each turn
+        m_Accum = 0.0;
+        for (const auto& value : m_Values) {
+            m_Accum += value;
+        }
+    }
+}
+
+double InAppGpuMeanSmoothing::GetValue() const {
+    return (m_Count > 0U) ? m_Accum / (double)m_Count : 0.0;
+}
+
+void InAppGpuMedianSmoothing::AddValue(const double vValue) {
+    m_Values[m_Index] = vValue;
+    m_Index = (m_Index + 1U) % sCountValues;
+    if (m_Count < sCountValues) {
+        ++m_Count;
+    }
+    double values[sCountValues];
+    memcpy(values, m_Values, sizeof(double) * m_Count);  // the first values are filled first
+    std::nth_element(values, values + m_Count / 2U, values + m_Count);
+    m_Median = values[m_Count / 2U];
+}
+
+double InAppGpuMedianSmoothing::GetValue() const {
+    return m_Median;
+}
+
+uint32_t InAppGpuMedianSmoothing::GetCount() const {
+    return m_Count;
+}
+
+void InAppGpuRuntimeSmoothing::AddValue(const double vValue) {
+    m_Ema.AddValue(vValue);
+    m_Mean.AddValue(vValue);
+    m_Median.AddValue(vValue);
+}
+
+double InAppGpuRuntimeSmoothing::GetValue() const {
+    switch (sSmoothing) {
+        case InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_EMA: return m_Ema.GetValue();
+        case InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_MEDIAN: return m_Median.GetValue();
+        case InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_MEAN:
+        default: break;
+    }
+    return m_Mean.GetValue();
+}
+
+////////////////////////////////////////////////////////////
+/////////////////////// HISTOGRAM //////////////////////////
+////////////////////////////////////////////////////////////
+
+void InAppGpuHistogram::AddValue(const GLuint64 vValue) {
+    auto& bucket = m_Buckets[m_GetBucketIndex(vValue)];
+    if (bucket == UINT16_MAX) {
+        m_HalveBuckets();
+    }
+    ++bucket;
+    ++m_Weight;
+    if (m_Count == 0U || vValue < m_Min) {
+        m_Min = vValue;
+    }
+    if (vValue > m_Max) {
+        m_Max = vValue;
+    }
+    ++m_Count;
+}
+
+void InAppGpuHistogram::Reset() {
+    memset(m_Buckets, 0, sizeof(m_Buckets));
+    m_Weight = 0U;
+    m_Count = 0U;
+    m_Min = 0U;
+    m_Max = 0U;
+}
+
+uint64_t InAppGpuHistogram::GetCount() const {
+    return m_Count;
+}
+
+GLuint64 InAppGpuHistogram::GetMin() const {
+    return m_Min;
+}
+
+GLuint64 InAppGpuHistogram::GetMax() const {
+    return m_Max;
+}
+
+GLuint64 InAppGpuHistogram::GetPercentile(const double vRatio) const {
+    if (m_Count == 0U) {
+        return 0U;
+    }
+    const uint64_t rank = (uint64_t)std::ceil(vRatio * (double)m_Weight);
+    uint64_t accum = 0U;
+    for (uint32_t idx = 0U; idx < sBucketsCount; ++idx) {
+        accum += m_Buckets[idx];
+        if (accum >= rank && accum > 0U) {
+            return m_GetBucketValue(idx);
+        }
+    }
+    return m_Max;
+}
+
+InAppGpuHistogram::percentiles InAppGpuHistogram::GetPercentiles() const {
+    percentiles res;
+    if (m_Count == 0U) {
+        return res;
+    }
+    const uint64_t rank_50 = (uint64_t)std::ceil(0.50 * (double)m_Weight);
+    const uint64_t rank_95 = (uint64_t)std::ceil(0.95 * (double)m_Weight);
+    const uint64_t rank_99 = (uint64_t)std::ceil(0.99 * (double)m_Weight);
+    res.p50 = res.p95 = res.p99 = m_Max;
+    uint64_t accum = 0U;
+    for (uint32_t idx = 0U; idx < sBucketsCount; ++idx) {
+        if (m_Buckets[idx] == 0U) {
+            continue;
+        }
+        const uint64_t last_accum = accum;
+        accum += m_Buckets[idx];
+        if (last_accum < rank_50 && accum >= rank_50) {
+            res.p50 = m_GetBucketValue(idx);
+        }
+        if (last_accum < rank_95 && accum >= rank_95) {
+            res.p95 = m_GetBucketValue(idx);
+        }
+        if (accum >= rank_99) {
+            res.p99 = m_GetBucketValue(idx);
+            break;
+        }
+    }
     return res;
 }
-InAppGpuQueryZone::circularSettings InAppGpuQueryZone::sCircularSettings;
 
-InAppGpuQueryZone::InAppGpuQueryZone(IAGP_GPU_CONTEXT vContext, const std::string& vName, const std::string& vSectionName,
-                                     const bool vIsRoot)
-    : m_Context(vContext), m_IsRoot(vIsRoot), m_SectionName(vSectionName), name(vName) {
-    m_StartFrameId = 0;
-    m_EndFrameId = 0;
-    m_StartTimeStamp = 0;
-    m_EndTimeStamp = 0;
-    m_ElapsedTime = 0.0;
-    depth = InAppGpuScopedZone::sCurrentDepth;
-    imGuiLabel = vName + "##InAppGpuQueryZone_" + std::to_string((intptr_t)this);
-
-    IAGP_SET_CURRENT_CONTEXT(m_Context);
-    CheckGLErrors;
-    glGenQueries(2, ids);
-    CheckGLErrors;
+uint32_t InAppGpuHistogram::m_GetBucketIndex(const GLuint64 vValue) {
+    // the first buckets are exact values, then each power of two have sSubBucketsCount buckets
+    if (vValue < (GLuint64)sSubBucketsCount) {
+        return (uint32_t)vValue;
+    }
+    const uint64_t value = (uint64_t)vValue;
+#ifdef _MSC_VER
+    unsigned long high_bit = 0U;
+    _BitScanReverse64(&high_bit, value);
+#else
+    const uint32_t high_bit = 63U - (uint32_t)__builtin_clzll(value);
+#endif
+    if (high_bit >= sMaxBits) {
+        return sBucketsCount - 1U;
+    }
+    const uint32_t shift = (uint32_t)high_bit - sSubBucketsBits;
+    return shift * sSubBucketsCount + (uint32_t)(value >> shift);
 }
 
-InAppGpuQueryZone::~InAppGpuQueryZone() {
-    IAGP_SET_CURRENT_CONTEXT(m_Context);
-    CheckGLErrors;
-    glDeleteQueries(2, ids);
-    CheckGLErrors;
+// the shape of the histogram is kept, a non empty bucket stay non empty
+void InAppGpuHistogram::m_HalveBuckets() {
+    m_Weight = 0U;
+    for (auto& bucket : m_Buckets) {
+        bucket = (uint16_t)((bucket + 1U) >> 1U);
+        m_Weight += bucket;
+    }
+}
+
+GLuint64 InAppGpuHistogram::m_GetBucketValue(const uint32_t vIdx) const {
+    GLuint64 res = vIdx;
+    if (vIdx >= sSubBucketsCount) {
+        // the middle of the bucket
+        const uint32_t shift = vIdx / sSubBucketsCount - 1U;
+        const uint64_t low = (uint64_t)(vIdx - shift * sSubBucketsCount) << shift;
+        res = (GLuint64)(low + (((uint64_t)1U << shift) >> 1U));
+    }
+    // the exact min and max are known
+    if (res < m_Min) {
+        res = m_Min;
+    }
+    if (res > m_Max) {
+        res = m_Max;
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////
+/////////////////////// ZONE STORE /////////////////////////
+////////////////////////////////////////////////////////////
+
+void InAppGpuZoneStore::Clear() {
+    parents.clear();
+    firstChilds.clear();
+    lastChilds.clear();
+    nextSiblings.clear();
+    depths.clear();
+    roots.clear();
+    subtreeRanks.clear();
+    queryIds.clear();
+    queryFrames.clear();
+    currentCounts.clear();
+    lastCounts.clear();
+    startFrameIds.clear();
+    endFrameIds.clear();
+    startTimeStamps.clear();
+    endTimeStamps.clear();
+    startTimes.clear();
+    endTimes.clear();
+    elapsedTimes.clear();
+    invocationEndIds.clear();
+    invocationsCollected.clear();
+    invocationStarts.clear();
+    cpuTimeStamps.clear();
+    cpuStartTimeStamps.clear();
+    cpuEndTimeStamps.clear();
+    cpuStartTimes.clear();
+    cpuEndTimes.clear();
+    cpuElapsedTimes.clear();
+    zones.clear();
+    m_Ptrs.clear();
+    m_KeyToZone.clear();
+}
+
+uint32_t InAppGpuZoneStore::size() const {
+    return (uint32_t)parents.size();
+}
+
+uint32_t InAppGpuZoneStore::FindChild(const uint32_t vParentIdx, const void* vPtr, const char* vName, const char* vSection, const uint64_t vLabelHash) const {
+    const auto is_same = [&](const uint32_t vIdx) {
+        return (parents[vIdx] == vParentIdx && m_Ptrs[vIdx] == vPtr &&  //
+                zones[vIdx].name == vName && zones[vIdx].sectionName == vSection);
+    };
+    const auto it = m_KeyToZone.find(m_GetKey(vParentIdx, vPtr, vLabelHash));
+    if (it == m_KeyToZone.end()) {
+        return sInvalidIndex;
+    }
+    if (is_same(it->second)) {
+        return it->second;
+    }
+    // hash collision, the zone is not in the map but can be in the childs
+    if (vParentIdx != sInvalidIndex) {
+        for (uint32_t idx = firstChilds[vParentIdx]; idx != sInvalidIndex; idx = nextSiblings[idx]) {
+            if (is_same(idx)) {
+                return idx;
+            }
+        }
+    }
+    return sInvalidIndex;
+}
+
+uint32_t InAppGpuZoneStore::AddZone(const uint32_t vParentIdx, const void* vPtr, const char* vName, const char* vSection,
+                                    const uint64_t vLabelHash, const bool vIsRoot) {
+    const uint32_t idx = size();
+    parents.push_back(vParentIdx);
+    firstChilds.push_back(sInvalidIndex);
+    lastChilds.push_back(sInvalidIndex);
+    nextSiblings.push_back(sInvalidIndex);
+    depths.push_back(vParentIdx == sInvalidIndex ? 0U : depths[vParentIdx] + 1U);
+    roots.push_back(vParentIdx == sInvalidIndex ? idx : roots[vParentIdx]);
+    uint32_t subtree_rank = 0U;
+    if (vParentIdx != sInvalidIndex) {
+        if (depths[vParentIdx] > 0U) {
+            subtree_rank = subtreeRanks[vParentIdx];
+        } else if (lastChilds[vParentIdx] != sInvalidIndex) {  // a new child of the root
+            subtree_rank = subtreeRanks[lastChilds[vParentIdx]] + 1U;
+        }
+    }
+    subtreeRanks.push_back(subtree_rank);
+    if (vParentIdx != sInvalidIndex) {
+        if (firstChilds[vParentIdx] == sInvalidIndex) {
+            firstChilds[vParentIdx] = idx;
+        } else {
+            nextSiblings[lastChilds[vParentIdx]] = idx;
+        }
+        lastChilds[vParentIdx] = idx;
+    }
+
+    queryIds.resize(queryIds.size() + 2U * IAGP_FRAMES_IN_FLIGHT, 0U);
+    queryFrames.resize(queryFrames.size() + IAGP_FRAMES_IN_FLIGHT, 0U);
+    currentCounts.resize(currentCounts.size() + IAGP_FRAMES_IN_FLIGHT, 0U);
+    lastCounts.push_back(0U);
+    startFrameIds.push_back(0U);
+    endFrameIds.push_back(0U);
+    startTimeStamps.push_back(0U);
+    endTimeStamps.push_back(0U);
+    startTimes.push_back(0.0);
+    endTimes.push_back(0.0);
+    elapsedTimes.push_back(0.0);
+
+    invocationEndIds.push_back(0U);
+    invocationsCollected.push_back(0U);
+    invocationStarts.push_back(0U);
+
+    cpuTimeStamps.resize(cpuTimeStamps.size() + 2U * IAGP_FRAMES_IN_FLIGHT, 0);
+    cpuStartTimeStamps.push_back(0U);
+    cpuEndTimeStamps.push_back(0U);
+    cpuStartTimes.push_back(0.0);
+    cpuEndTimes.push_back(0.0);
+    cpuElapsedTimes.push_back(0.0);
+
+    zones.emplace_back();  // the cold part
+    auto& zone = zones.back();
+    zone.isRoot = vIsRoot;
+    zone.name = vName;
+    zone.sectionName = vSection;
+
+    m_Ptrs.push_back(vPtr);
+    // in case of hash collision the key is kept by the first zone
+    m_KeyToZone.emplace(m_GetKey(vParentIdx, vPtr, vLabelHash), idx);
+
+    return idx;
+}
+
+GLuint* InAppGpuZoneStore::GetQueryIds(const uint32_t vIdx, const uint32_t vSlotIdx) {
+    return &queryIds[(vIdx * IAGP_FRAMES_IN_FLIGHT + vSlotIdx) * 2U];
+}
+
+uint64_t& InAppGpuZoneStore::GetQueryFrame(const uint32_t vIdx, const uint32_t vSlotIdx) {
+    return queryFrames[vIdx * IAGP_FRAMES_IN_FLIGHT + vSlotIdx];
+}
+
+GLuint& InAppGpuZoneStore::GetCurrentCount(const uint32_t vIdx, const uint32_t vSlotIdx) {
+    return currentCounts[vIdx * IAGP_FRAMES_IN_FLIGHT + vSlotIdx];
+}
 
-    name.clear();
-    m_StartFrameId = 0;
-    m_EndFrameId = 0;
-    m_StartTimeStamp = 0;
-    m_EndTimeStamp = 0;
-    m_ElapsedTime = 0.0;
-    zonesOrdered.clear();
-    zonesDico.clear();
+int64_t* InAppGpuZoneStore::GetCpuTimeStamps(const uint32_t vIdx, const uint32_t vSlotIdx) {
+    return &cpuTimeStamps[(vIdx * IAGP_FRAMES_IN_FLIGHT + vSlotIdx) * 2U];
 }
 
-void InAppGpuQueryZone::Clear() {
-    m_StartFrameId = 0;
-    m_EndFrameId = 0;
-    m_StartTimeStamp = 0;
-    m_EndTimeStamp = 0;
-    m_ElapsedTime = 0.0;
+void InAppGpuZoneStore::SetCpuTimeStamps(const uint32_t vIdx, const uint32_t vSlotIdx, const int64_t vClockOffset) {
+    // must be called before SetEndTimeStamp, so the cpu times are computed with the gpu times
+    const int64_t* cpu_times = GetCpuTimeStamps(vIdx, vSlotIdx);
+    const int64_t start_time = cpu_times[0] + vClockOffset;
+    const int64_t end_time = cpu_times[1] + vClockOffset;
+    cpuStartTimeStamps[vIdx] = (start_time > 0) ? (GLuint64)start_time : 0U;
+    cpuEndTimeStamps[vIdx] = (end_time > 0) ? (GLuint64)end_time : 0U;
 }
 
-void InAppGpuQueryZone::SetStartTimeStamp(const GLuint64& vValue) {
-    m_StartTimeStamp = vValue;
-    ++m_StartFrameId;
+void InAppGpuZoneStore::SetStartTimeStamp(const uint32_t vIdx, const GLuint64& vValue) {
+    startTimeStamps[vIdx] = vValue;
+    ++startFrameIds[vIdx];
 }
 
-void InAppGpuQueryZone::SetEndTimeStamp(const GLuint64& vValue) {
-    m_EndTimeStamp = vValue;
-    ++m_EndFrameId;
+void InAppGpuZoneStore::SetEndTimeStamp(const uint32_t vIdx, const GLuint64& vValue) {
+    endTimeStamps[vIdx] = vValue;
+    ++endFrameIds[vIdx];
 
 #ifdef IAGP_DEBUG_MODE_LOGGING
-    IAGP_DEBUG_MODE_LOGGING("%*s end id retrieved : %u", depth, "", ids[1]);
+    IAGP_DEBUG_MODE_LOGGING("%*s end retrieved : zone %u", depths[vIdx], "", vIdx);
 #endif
     // start computation of elapsed time
     // no needed after
     // will be used for Graph and labels
     // so DrawMetricGraph must be the first
-    ComputeElapsedTime();
+    ComputeElapsedTime(vIdx);
 
-    if (InAppGpuQueryZone::sActivateLogger && zonesOrdered.empty())  // only the leafs
+    if (InAppGpuQueryZone::sActivateLogger && firstChilds[vIdx] == sInvalidIndex)  // only the leafs
     {
         /*double v = (double)vValue / 1e9;
         LogVarLightInfo("<profiler section=\"%s\" epoch_time=\"%f\" name=\"%s\" render_time_ms=\"%f\">",
-            m_SectionName.c_str(), v, name.c_str(), m_ElapsedTime);*/
+            zones[vIdx].sectionName.c_str(), v, zones[vIdx].name.c_str(), elapsedTimes[vIdx]);*/
     }
 }
 
-void InAppGpuQueryZone::ComputeElapsedTime() {
+void InAppGpuZoneStore::ComputeElapsedTime(const uint32_t vIdx) {
     // we take the last frame
-    if (m_StartFrameId == m_EndFrameId) {
-        m_AverageStartValue.AddValue(m_StartTimeStamp);  // ns to ms
-        m_AverageEndValue.AddValue(m_EndTimeStamp);      // ns to ms
-        m_StartTime = (double)(m_AverageStartValue.GetAverage() * 1e-6);
-        m_EndTime = (double)(m_AverageEndValue.GetAverage() * 1e-6);
-        m_ElapsedTime = m_EndTime - m_StartTime;
+    if (startFrameIds[vIdx] == endFrameIds[vIdx]) {
+        // the root start of this frame, its start is always retrieved before the ends of its childs
+        const int64_t root_start = (int64_t)startTimeStamps[roots[vIdx]];
+        const int64_t elapsed = (int64_t)(endTimeStamps[vIdx] - startTimeStamps[vIdx]);
+        zones[vIdx].smoothedStartOffset.AddValue((double)((int64_t)startTimeStamps[vIdx] - root_start) * 1e-6);  // ns to ms
+        zones[vIdx].smoothedElapsedTime.AddValue((double)elapsed * 1e-6);
+        startTimes[vIdx] = zones[vIdx].smoothedStartOffset.GetValue();
+        elapsedTimes[vIdx] = zones[vIdx].smoothedElapsedTime.GetValue();
+        endTimes[vIdx] = startTimes[vIdx] + elapsedTimes[vIdx];
+        if (elapsed >= 0) {
+            zones[vIdx].histogram.AddValue((GLuint64)elapsed);  // not smoothed
+        }
+        if (cpuEndTimeStamps[vIdx] > 0U) {
+            // can be negative, the cpu submit before the gpu execute
+            zones[vIdx].smoothedCpuStartOffset.AddValue((double)((int64_t)cpuStartTimeStamps[vIdx] - root_start) * 1e-6);
+            zones[vIdx].smoothedCpuElapsedTime.AddValue((double)((int64_t)(cpuEndTimeStamps[vIdx] - cpuStartTimeStamps[vIdx])) * 1e-6);
+            cpuStartTimes[vIdx] = zones[vIdx].smoothedCpuStartOffset.GetValue();
+            cpuElapsedTimes[vIdx] = zones[vIdx].smoothedCpuElapsedTime.GetValue();
+            cpuEndTimes[vIdx] = cpuStartTimes[vIdx] + cpuElapsedTimes[vIdx];
+        }
     }
 }
 
-void InAppGpuQueryZone::DrawDetails() {
-    if (m_StartFrameId) {
-        bool res = false;
+void InAppGpuZoneStore::ResetStatistics() {
+    for (auto& zone : zones) {
+        zone.histogram.Reset();
+    }
+}
 
-        ImGui::TableNextColumn();  // tree
+size_t InAppGpuZoneStore::GetHotBytes() const {
+    size_t res = 0U;
+    m_ForEachHotArray([&res](const auto& vArray) { res += vArray.size() * sizeof(vArray[0]); });
+    return res;
+}
 
-        ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_CollapsingHeader | ImGuiTreeNodeFlags_DefaultOpen;
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+// the capacity of the arrays, the strings not in the small buffer, and an estimation of the map
+size_t InAppGpuZoneStore::GetHeapBytes() const {
+    size_t res = 0U;
+    const auto add_array = [&res](const auto& vArray) { res += vArray.capacity() * sizeof(vArray[0]); };
+    const auto add_string = [&res](const std::string& vString) {
+        const char* data_ptr = vString.data();
+        const char* string_ptr = reinterpret_cast<const char*>(&vString);
+        if (data_ptr < string_ptr || data_ptr >= string_ptr + sizeof(vString)) {
+            res += vString.capacity() + 1U;
+        }
+    };
+    m_ForEachHotArray(add_array);
+    add_array(zones);
+    for (const auto& zone : zones) {
+        add_string(zone.name);
+        add_string(zone.sectionName);
+        add_string(zone.barLabel);
+        add_string(zone.cpuBarLabel);
+        add_string(zone.imGuiLabel);
+        add_string(zone.imGuiTitle);
+    }
+    // a node by entry, with the key, the value and the link
+    res += m_KeyToZone.bucket_count() * sizeof(void*);
+    res += m_KeyToZone.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + sizeof(void*));
+    return res;
+}
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
+uint64_t InAppGpuZoneStore::m_GetKey(const uint32_t vParentIdx, const void* vPtr, const uint64_t vLabelHash) {
+    // fnv-1a, continued from the hash of the label
+    uint64_t hash = vLabelHash;
+    const auto mix = [&hash](const void* vData, const size_t vSize) {
+        const auto* bytes = static_cast<const uint8_t*>(vData);
+        for (size_t idx = 0U; idx < vSize; ++idx) {
+            hash ^= bytes[idx];
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(&vParentIdx, sizeof(vParentIdx));
+    mix(&vPtr, sizeof(vPtr));
+    return hash;
+}
 
-        bool any_childs_to_show = false;
-        for (const auto& zone : zonesOrdered) {
-            if (zone != nullptr && zone->m_ElapsedTime > 0.0) {
-                any_childs_to_show = true;
-                break;
-            }
+////////////////////////////////////////////////////////////
+/////////////////////// AGGREGATION ////////////////////////
+////////////////////////////////////////////////////////////
+
+void InAppGpuAggregateTree::Clear(const char* vRootName) {
+    parents.clear();
+    firstChilds.clear();
+    lastChilds.clear();
+    nextSiblings.clear();
+    depths.clear();
+    names.clear();
+    frameTimes.clear();
+    frameCounts.clear();
+    smoothedTimes.clear();
+    elapsedTimes.clear();
+    counts.clear();
+    barLabels.clear();
+    barLabelKeys.clear();
+    barLabelSizes.clear();
+    expanded.clear();
+    m_KeyToNode.clear();
+    GetNode(sInvalidIndex, vRootName);
+}
+
+uint32_t InAppGpuAggregateTree::size() const {
+    return (uint32_t)parents.size();
+}
+
+uint32_t InAppGpuAggregateTree::GetNode(const uint32_t vParentIdx, const std::string& vName) {
+    const uint64_t key = HashLabel(vName.c_str(), ((uint64_t)vParentIdx + 1U) * 1099511628211ULL);
+    const auto it = m_KeyToNode.find(key);
+    if (it != m_KeyToNode.end()) {
+        return it->second;
+    }
+    const uint32_t idx = size();
+    parents.push_back(vParentIdx);
+    firstChilds.push_back(sInvalidIndex);
+    lastChilds.push_back(sInvalidIndex);
+    nextSiblings.push_back(sInvalidIndex);
+    depths.push_back(vParentIdx == sInvalidIndex ? 0U : depths[vParentIdx] + 1U);
+    if (vParentIdx != sInvalidIndex) {
+        if (firstChilds[vParentIdx] == sInvalidIndex) {
+            firstChilds[vParentIdx] = idx;
+        } else {
+            nextSiblings[lastChilds[vParentIdx]] = idx;
         }
+        lastChilds[vParentIdx] = idx;
+    }
+    names.push_back(vName);
+    frameTimes.push_back(0.0);
+    frameCounts.push_back(0U);
+    smoothedTimes.emplace_back();
+    elapsedTimes.push_back(0.0);
+    counts.push_back(0U);
+    barLabels.emplace_back();
+    barLabelKeys.push_back(-1);
+    barLabelSizes.emplace_back();
+    expanded.push_back(vParentIdx == sInvalidIndex ? 1U : 0U);  // only the root is open
+    m_KeyToNode.emplace(key, idx);
+    return idx;
+}
+
+void InAppGpuAggregateTree::BeginFrame() {
+    std::fill(frameTimes.begin(), frameTimes.end(), 0.0);
+    std::fill(frameCounts.begin(), frameCounts.end(), 0U);
+}
+
+void InAppGpuAggregateTree::AddTime(const uint32_t vNodeIdx, const double vTime, const GLuint vCount) {
+    frameTimes[vNodeIdx] += vTime;
+    frameCounts[vNodeIdx] += vCount;
+}
+
+// the nodes absent of the frame are smoothed with 0
+void InAppGpuAggregateTree::EndFrame() {
+    for (uint32_t idx = 0U; idx < size(); ++idx) {
+        smoothedTimes[idx].AddValue(frameTimes[idx]);
+        elapsedTimes[idx] = smoothedTimes[idx].GetValue();
+        counts[idx] = frameCounts[idx];
+    }
+}
+
+#ifdef IAGP_USE_VULKAN
+
+////////////////////////////////////////////////////////////
+/////////////////////// BACKENDS ///////////////////////////
+////////////////////////////////////////////////////////////
+
+void InAppGpuVulkanBackend::LogError(const char* vMessage) {
+    IAGP_LOG_ERROR_MESSAGE("%s", vMessage);
+}
+
+#endif  // IAGP_USE_VULKAN
+
+////////////////////////////////////////////////////////////
+/////////////////////// QUERY POOL /////////////////////////
+////////////////////////////////////////////////////////////
+
+InAppGpuQueryPool::InAppGpuQueryPool(IAGP_GPU_CONTEXT vContext) : m_Context(vContext) {
+}
+
+void InAppGpuQueryPool::Init() {
+    if (m_Queries.empty()) {
+        m_AddChunk();
+    }
+}
+
+void InAppGpuQueryPool::Unit() {
+    if (!m_Queries.empty()) {
+        IAGP_SET_CURRENT_CONTEXT(m_Context);
+        CheckGLErrors;
+        InAppGpuBackend::DeleteQueries((GLsizei)m_Queries.size(), m_Queries.data());
+        CheckGLErrors;
+    }
+    m_Queries.clear();
+    m_FreeQueries.clear();
+    m_Stats = {};
+}
 
-        if (!any_childs_to_show) {
-            flags |= ImGuiTreeNodeFlags_Leaf;
+void InAppGpuQueryPool::Acquire(GLuint* vOutIds, const uint32_t vCount) {
+    for (uint32_t idx = 0U; idx < vCount; ++idx) {
+        if (m_FreeQueries.empty()) {
+            m_AddChunk();
         }
+        vOutIds[idx] = m_FreeQueries.back();
+        m_FreeQueries.pop_back();
+    }
+    m_Stats.inUse += vCount;
+    if (m_Stats.inUse > m_Stats.highWater) {
+        m_Stats.highWater = m_Stats.inUse;
+    }
+}
 
-        if (m_Highlighted) {
-            flags |= ImGuiTreeNodeFlags_Framed;
+void InAppGpuQueryPool::Release(const GLuint* vIds, const uint32_t vCount) {
+    for (uint32_t idx = 0U; idx < vCount; ++idx) {
+        if (vIds[idx] != 0U) {
+            m_FreeQueries.push_back(vIds[idx]);
+            --m_Stats.inUse;
         }
+    }
+}
 
-        const auto colorU32 = ImGui::ColorConvertFloat4ToU32(cv4);
-        const bool pushed = PushStyleColorWithContrast(colorU32, ImGuiCol_Text, ImVec4(0, 0, 0, 1), InAppGpuQueryZone::sContrastRatio);
+const InAppGpuQueryPool::poolStats& InAppGpuQueryPool::GetStats() const {
+    return m_Stats;
+}
 
-        ImGui::PushStyleColor(ImGuiCol_Header, cv4);
-        const auto hovered_color = ImVec4(cv4.x * 0.9f, cv4.y * 0.9f, cv4.z * 0.9f, 1.0f);
-        const auto active_color = ImVec4(cv4.x * 0.8f, cv4.y * 0.8f, cv4.z * 0.8f, 1.0f);
-        ImGui::PushStyleColor(ImGuiCol_HeaderHovered, hovered_color);
-        ImGui::PushStyleColor(ImGuiCol_HeaderActive, active_color);
+void InAppGpuQueryPool::m_AddChunk() {
+    // the only place where the driver is called
+    const size_t offset = m_Queries.size();
+    m_Queries.resize(offset + IAGP_QUERY_POOL_CHUNK_SIZE);
+    CheckGLErrors;
+    InAppGpuBackend::GenQueries((GLsizei)IAGP_QUERY_POOL_CHUNK_SIZE, m_Queries.data() + offset);
+    CheckGLErrors;
+    // reversed for give the queries in the allocation order
+    m_FreeQueries.insert(m_FreeQueries.begin(), m_Queries.rbegin(), m_Queries.rbegin() + IAGP_QUERY_POOL_CHUNK_SIZE);
+    m_Stats.capacity += IAGP_QUERY_POOL_CHUNK_SIZE;
+    ++m_Stats.chunksCount;
+}
 
-        if (m_IsRoot) {
-            res = ImGui::TreeNodeEx(this, flags, "%s : frame [%u]", name.c_str(), m_StartFrameId - 1U);
-        } else if (!m_SectionName.empty()) {
-            res = ImGui::TreeNodeEx(this, flags, "%s : %s", m_SectionName.c_str(), name.c_str());
-        } else {
-            res = ImGui::TreeNodeEx(this, flags, "%s", name.c_str());
+////////////////////////////////////////////////////////////
+/////////////////////// OVERHEAD ///////////////////////////
+////////////////////////////////////////////////////////////
+
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+
+void InAppGpuOverhead::Add(const InAppGpuOverheadEnum vCounter, const uint64_t vTime) {
+    m_Times[vCounter].fetch_add(vTime, std::memory_order_relaxed);
+    m_Calls[vCounter].fetch_add(1U, std::memory_order_relaxed);
+}
+
+InAppGpuOverhead::counter InAppGpuOverhead::Get(const InAppGpuOverheadEnum vCounter) const {
+    counter res;
+    res.time = m_Times[vCounter].load(std::memory_order_relaxed);
+    res.calls = m_Calls[vCounter].load(std::memory_order_relaxed);
+    return res;
+}
+
+void InAppGpuOverhead::Update(const int vFrame) {
+    // the ui can be not drawn at each frame, so the differences are divided by the count of frames
+    const int frames_count = vFrame - m_LastFrame;
+    if (frames_count <= 0) {
+        return;
+    }
+    const bool is_first = (m_LastFrame < 0);
+    m_LastFrame = vFrame;
+    for (int32_t idx = 0; idx < (int32_t)IN_APP_GPU_OVERHEAD_Count; ++idx) {
+        const auto current = Get((InAppGpuOverheadEnum)idx);
+        if (!is_first) {
+            const auto& last = m_LastCounters[idx];
+            m_FrameTimes[idx].AddValue((double)(current.time - last.time) * 1e-3 / frames_count);  // ns to us
+            m_FrameCalls[idx].AddValue((double)(current.calls - last.calls) / frames_count);
+        }
+        m_LastCounters[idx] = current;
+    }
+}
+
+double InAppGpuOverhead::GetFrameTime(const InAppGpuOverheadEnum vCounter) const {
+    return m_FrameTimes[vCounter].GetValue();
+}
+
+double InAppGpuOverhead::GetFrameCalls(const InAppGpuOverheadEnum vCounter) const {
+    return m_FrameCalls[vCounter].GetValue();
+}
+
+const char* InAppGpuOverhead::GetName(const InAppGpuOverheadEnum vCounter) {
+    switch (vCounter) {
+        case InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_SCOPE_BEGIN: return "Scope begin";
+        case InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_SCOPE_END: return "Scope end";
+        case InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_GET_QUERY_ZONE: return "GetQueryZone";
+        case InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_COLLECT: return "Collect";
+        case InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_DRAW_FLAME_GRAPH: return "Draw flame graph";
+        case InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_DRAW_DETAILS: return "Draw details";
+        case InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_Count:
+        default: break;
+    }
+    return "";
+}
+
+InAppGpuOverheadTimer::InAppGpuOverheadTimer(const InAppGpuOverheadEnum vCounter) : m_Counter(vCounter), m_StartTime(GetCpuTime()) {
+}
+
+InAppGpuOverheadTimer::~InAppGpuOverheadTimer() {
+    InAppGpuProfiler::Instance()->GetOverheadRef().Add(m_Counter, (uint64_t)(GetCpuTime() - m_StartTime));
+}
+
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
+////////////////////////////////////////////////////////////
+/////////////////////// FLIGHT RECORDER ////////////////////
+////////////////////////////////////////////////////////////
+
+#ifdef IAGP_USE_FLIGHT_RECORDER
+
+static uint8_t* WriteVarint(uint8_t* vPtr, uint64_t vValue) {
+    while (vValue >= 0x80U) {
+        *vPtr++ = (uint8_t)(vValue | 0x80U);
+        vValue >>= 7U;
+    }
+    *vPtr++ = (uint8_t)vValue;
+    return vPtr;
+}
+
+static bool ReadVarint(const uint8_t*& vPtr, const uint8_t* vEnd, uint64_t& vOutValue) {
+    vOutValue = 0U;
+    for (uint32_t shift = 0U; shift < 64U && vPtr < vEnd; shift += 7U) {
+        const uint8_t byte = *vPtr++;
+        vOutValue |= (uint64_t)(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0U) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the small negative deltas stay small
+static uint64_t ZigZag(const int64_t vValue) {
+    return ((uint64_t)vValue << 1U) ^ (uint64_t)(vValue >> 63);
+}
+
+static int64_t UnZigZag(const uint64_t vValue) {
+    return (int64_t)(vValue >> 1U) ^ -(int64_t)(vValue & 1U);
+}
+
+InAppGpuFlightRecorder::~InAppGpuFlightRecorder() {
+    Close();
+}
+
+bool InAppGpuFlightRecorder::Open(const std::string& vFilePathName, const size_t vRingSize, const size_t vStringsSize) {
+    Close();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_Map(vFilePathName, sizeof(fileHeader) + vStringsSize + vRingSize)) {
+        IAGP_LOG_ERROR_MESSAGE("the flight recorder cant map the file %s", vFilePathName.c_str());
+        return false;
+    }
+    m_HeaderPtr = reinterpret_cast<fileHeader*>(m_Datas);
+    m_StringsPtr = m_Datas + sizeof(fileHeader);
+    m_RingPtr = m_StringsPtr + vStringsSize;
+    // a new recording at each open, the file of a crash must be copied before
+    *m_HeaderPtr = fileHeader();
+    memcpy(m_HeaderPtr->magic, "IAGPFR01", 8U);
+    m_HeaderPtr->version = sVersion;
+    m_HeaderPtr->session = ++m_Session;  // the names will be written again
+    m_HeaderPtr->stringsCapacity = vStringsSize;
+    m_HeaderPtr->ringCapacity = vRingSize;
+    m_IsOpened.store(true, std::memory_order_release);
+    return true;
+}
+
+void InAppGpuFlightRecorder::Close() {
+    m_IsOpened.store(false, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Unmap();
+}
+
+bool InAppGpuFlightRecorder::IsOpened() const {
+    return m_IsOpened.load(std::memory_order_acquire);
+}
+
+void InAppGpuFlightRecorder::RecordFrame(const uint64_t vContext, const uint32_t vGeneration, const uint64_t vFrameId, InAppGpuZoneStore& vStore,
+                                         const std::vector<InAppGpuCollectedZone>& vZones) {
+    if (!m_IsOpened.load(std::memory_order_acquire) || vZones.empty()) {
+        return;
+    }
+    // the collecting thread never wait, if another context is recording the frame is dropped
+    std::unique_lock<std::mutex> lock(m_Mutex, std::try_to_lock);
+    if (!lock.owns_lock() || m_HeaderPtr == nullptr) {
+        return;
+    }
+    auto& header = *m_HeaderPtr;
+
+    // the names are written once, the first time the zone is recorded
+    for (const auto& zone : vZones) {
+        if (vStore.zones[zone.zoneIdx].recorderSession != m_Session) {
+            vStore.zones[zone.zoneIdx].recorderSession = m_Session;
+            m_WriteName(vContext, vGeneration, zone.zoneIdx, vStore);
+        }
+    }
+
+    // the max size of the varints, so the frame is encoded in place without temporary buffer
+    const uint64_t max_size = 8U + 5U * 10U + (uint64_t)vZones.size() * (2U * 5U + 4U * 10U);
+    if (max_size > header.ringCapacity) {
+        ++header.framesDropped;
+        return;
+    }
+    if (header.head + max_size > header.ringCapacity) {
+        // no place at the end, the frames after the head are lost and we continue at the start
+        while (header.wrapped != 0U && header.framesCount > 0U) {
+            m_PopFrame();
         }
+        header.endPos = header.head;
+        header.head = 0U;
+        header.wrapped = (header.framesCount > 0U) ? 1U : 0U;
+    }
+    // the oldest frames overwritten by this one
+    while (header.wrapped != 0U && header.tail < header.head + max_size) {
+        m_PopFrame();
+    }
+    if (header.framesCount == 0U) {
+        header.tail = header.head;
+    }
+    // the header say the old frames are lost before they are overwritten
+    std::atomic_thread_fence(std::memory_order_release);
+
+    GLuint64 base_time = vZones[0].startTimeStamp;
+    for (const auto& zone : vZones) {
+        base_time = (zone.startTimeStamp < base_time) ? zone.startTimeStamp : base_time;
+    }
+    uint8_t* frame_ptr = m_RingPtr + header.head;
+    uint8_t* ptr = frame_ptr + 8U;
+    ptr = WriteVarint(ptr, vContext);
+    ptr = WriteVarint(ptr, vGeneration);
+    ptr = WriteVarint(ptr, vFrameId);
+    ptr = WriteVarint(ptr, base_time);
+    ptr = WriteVarint(ptr, vZones.size());
+    for (const auto& zone : vZones) {
+        ptr = WriteVarint(ptr, zone.zoneIdx);
+        ptr = WriteVarint(ptr, zone.count);
+        ptr = WriteVarint(ptr, ZigZag((int64_t)(zone.startTimeStamp - base_time)));
+        ptr = WriteVarint(ptr, ZigZag((int64_t)(zone.endTimeStamp - zone.startTimeStamp)));
+        ptr = WriteVarint(ptr, ZigZag((int64_t)(zone.cpuStartTimeStamp - base_time)));
+        ptr = WriteVarint(ptr, ZigZag((int64_t)(zone.cpuEndTimeStamp - zone.cpuStartTimeStamp)));
+    }
+    const uint32_t size = (uint32_t)(ptr - frame_ptr - 8U);
+    memcpy(frame_ptr, &sFrameMagic, 4U);
+    memcpy(frame_ptr + 4U, &size, 4U);
+
+    // the frame is complete before the header give it
+    std::atomic_thread_fence(std::memory_order_release);
+    header.head += 8U + size;
+    ++header.framesCount;
+    ++header.framesWritten;
+}
+
+bool InAppGpuFlightRecorder::Load(const std::string& vFilePathName, std::vector<recordedName>& vOutNames, std::vector<recordedFrame>& vOutFrames) {
+    vOutNames.clear();
+    vOutFrames.clear();
+    return Load(
+        vFilePathName, [&vOutNames](const recordedName& vName) { vOutNames.push_back(vName); },
+        [&vOutFrames](const recordedFrame& vFrame) { vOutFrames.push_back(vFrame); });
+}
 
-        ImGui::PopStyleColor(3);
+bool InAppGpuFlightRecorder::Load(const std::string& vFilePathName, const std::function<void(const recordedName&)>& vNameFunctor,
+                                  const std::function<void(const recordedFrame&)>& vFrameFunctor) {
+    FILE* file_ptr = fopen(vFilePathName.c_str(), "rb");
+    if (file_ptr == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> datas;
+    fseek(file_ptr, 0, SEEK_END);
+    const long file_size = ftell(file_ptr);
+    fseek(file_ptr, 0, SEEK_SET);
+    if (file_size > 0) {
+        datas.resize((size_t)file_size);
+        datas.resize(fread(datas.data(), 1U, datas.size(), file_ptr));
+    }
+    fclose(file_ptr);
+
+    fileHeader header;
+    if (datas.size() < sizeof(fileHeader)) {
+        return false;
+    }
+    memcpy(&header, datas.data(), sizeof(fileHeader));
+    if (memcmp(header.magic, "IAGPFR01", 8U) != 0 || header.version != sVersion ||  //
+        sizeof(fileHeader) + header.stringsCapacity + header.ringCapacity > datas.size() || header.stringsSize > header.stringsCapacity) {
+        return false;
+    }
+
+    // the names
+    const uint8_t* strings_ptr = datas.data() + sizeof(fileHeader);
+    uint64_t pos = 0U;
+    while (pos + 4U <= header.stringsSize) {
+        uint32_t size = 0U;
+        memcpy(&size, strings_ptr + pos, 4U);
+        if (size < 22U || pos + 4U + size > header.stringsSize) {
+            break;  // the name was in writing
+        }
+        const uint8_t* ptr = strings_ptr + pos + 4U;
+        recordedName name;
+        memcpy(&name.context, ptr, 8U);
+        memcpy(&name.generation, ptr + 8U, 4U);
+        memcpy(&name.zoneIdx, ptr + 12U, 4U);
+        memcpy(&name.parentIdx, ptr + 16U, 4U);
+        const char* chars = reinterpret_cast<const char*>(ptr + 20U);
+        const size_t chars_size = size - 20U;
+        name.section = std::string(chars, strnlen(chars, chars_size));
+        if (name.section.size() + 1U < chars_size) {
+            name.name = std::string(chars + name.section.size() + 1U, strnlen(chars + name.section.size() + 1U, chars_size - name.section.size() - 1U));
+        }
+        if (vNameFunctor != nullptr) {
+            vNameFunctor(name);
+        }
+        pos += 4U + size;
+    }
+
+    // the frames, from the oldest
+    const uint8_t* ring_ptr = strings_ptr + header.stringsCapacity;
+    pos = header.tail;
+    bool wrapped = (header.wrapped != 0U);
+    recordedFrame frame;  // reused, so the zones are not allocated for each frame
+    for (uint64_t frame_idx = 0U; frame_idx < header.framesCount; ++frame_idx) {
+        if (wrapped && pos >= header.endPos) {
+            pos = 0U;
+            wrapped = false;
+        }
+        uint32_t magic = 0U;
+        uint32_t size = 0U;
+        if (pos + 8U > header.ringCapacity) {
+            break;
+        }
+        memcpy(&magic, ring_ptr + pos, 4U);
+        memcpy(&size, ring_ptr + pos + 4U, 4U);
+        if (magic != sFrameMagic || pos + 8U + size > header.ringCapacity) {
+            break;  // corrupted
+        }
+        const uint8_t* ptr = ring_ptr + pos + 8U;
+        const uint8_t* end = ptr + size;
+        frame.zones.clear();
+        uint64_t generation = 0U, base_time = 0U, zones_count = 0U;
+        bool ok = ReadVarint(ptr, end, frame.context) && ReadVarint(ptr, end, generation) &&  //
+                  ReadVarint(ptr, end, frame.frameId) && ReadVarint(ptr, end, base_time) && ReadVarint(ptr, end, zones_count);
+        frame.generation = (uint32_t)generation;
+        for (uint64_t zone_idx = 0U; ok && zone_idx < zones_count; ++zone_idx) {
+            uint64_t values[6];
+            for (auto& value : values) {
+                ok &= ReadVarint(ptr, end, value);
+            }
+            if (ok) {
+                InAppGpuCollectedZone zone;
+                zone.zoneIdx = (uint32_t)values[0];
+                zone.count = (GLuint)values[1];
+                zone.startTimeStamp = base_time + (GLuint64)UnZigZag(values[2]);
+                zone.endTimeStamp = zone.startTimeStamp + (GLuint64)UnZigZag(values[3]);
+                zone.cpuStartTimeStamp = base_time + (GLuint64)UnZigZag(values[4]);
+                zone.cpuEndTimeStamp = zone.cpuStartTimeStamp + (GLuint64)UnZigZag(values[5]);
+                frame.zones.push_back(zone);
+            }
+        }
+        if (!ok) {
+            break;
+        }
+        if (vFrameFunctor != nullptr) {
+            vFrameFunctor(frame);
+        }
+        pos += 8U + size;
+    }
+    return true;
+}
+
+bool InAppGpuFlightRecorder::m_Map(const std::string& vFilePathName, const size_t vSize) {
+#ifdef _WIN32
+    m_FileHandle = CreateFileA(vFilePathName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_FileHandle == INVALID_HANDLE_VALUE) {
+        m_FileHandle = nullptr;
+        return false;
+    }
+    m_MappingHandle = CreateFileMappingA(m_FileHandle, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)vSize >> 32U), (DWORD)((uint64_t)vSize & 0xFFFFFFFFU), nullptr);
+    if (m_MappingHandle != nullptr) {
+        m_Datas = static_cast<uint8_t*>(MapViewOfFile(m_MappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, vSize));
+    }
+#else   // _WIN32
+    m_FileDescriptor = open(vFilePathName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_FileDescriptor < 0) {
+        return false;
+    }
+    if (ftruncate(m_FileDescriptor, (off_t)vSize) == 0) {
+        void* ptr = mmap(nullptr, vSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_FileDescriptor, 0);
+        if (ptr != MAP_FAILED) {
+            m_Datas = static_cast<uint8_t*>(ptr);
+        }
+    }
+#endif  // _WIN32
+    if (m_Datas == nullptr) {
+        m_Unmap();
+        return false;
+    }
+    m_DatasSize = vSize;
+    return true;
+}
+
+void InAppGpuFlightRecorder::m_Unmap() {
+    // the pages are written by the os, even after a crash
+#ifdef _WIN32
+    if (m_Datas != nullptr) {
+        FlushViewOfFile(m_Datas, 0);
+        UnmapViewOfFile(m_Datas);
+    }
+    if (m_MappingHandle != nullptr) {
+        CloseHandle(m_MappingHandle);
+        m_MappingHandle = nullptr;
+    }
+    if (m_FileHandle != nullptr) {
+        CloseHandle(m_FileHandle);
+        m_FileHandle = nullptr;
+    }
+#else   // _WIN32
+    if (m_Datas != nullptr) {
+        msync(m_Datas, m_DatasSize, MS_ASYNC);
+        munmap(m_Datas, m_DatasSize);
+    }
+    if (m_FileDescriptor >= 0) {
+        close(m_FileDescriptor);
+        m_FileDescriptor = -1;
+    }
+#endif  // _WIN32
+    m_Datas = nullptr;
+    m_DatasSize = 0U;
+    m_HeaderPtr = nullptr;
+    m_StringsPtr = nullptr;
+    m_RingPtr = nullptr;
+}
+
+void InAppGpuFlightRecorder::m_WriteName(const uint64_t vContext, const uint32_t vGeneration, const uint32_t vZoneIdx, const InAppGpuZoneStore& vStore) {
+    auto& header = *m_HeaderPtr;
+    const auto& zone = vStore.zones[vZoneIdx];
+    const uint32_t size = 20U + (uint32_t)zone.sectionName.size() + 1U + (uint32_t)zone.name.size() + 1U;
+    if (header.stringsSize + 4U + size > header.stringsCapacity) {
+        ++header.stringsDropped;
+        return;
+    }
+    uint8_t* ptr = m_StringsPtr + header.stringsSize;
+    memcpy(ptr, &size, 4U);
+    memcpy(ptr + 4U, &vContext, 8U);
+    memcpy(ptr + 12U, &vGeneration, 4U);
+    memcpy(ptr + 16U, &vZoneIdx, 4U);
+    memcpy(ptr + 20U, &vStore.parents[vZoneIdx], 4U);
+    memcpy(ptr + 24U, zone.sectionName.c_str(), zone.sectionName.size() + 1U);
+    memcpy(ptr + 24U + zone.sectionName.size() + 1U, zone.name.c_str(), zone.name.size() + 1U);
+    std::atomic_thread_fence(std::memory_order_release);
+    header.stringsSize += 4U + size;
+}
+
+void InAppGpuFlightRecorder::m_PopFrame() {
+    auto& header = *m_HeaderPtr;
+    uint32_t size = 0U;
+    memcpy(&size, m_RingPtr + header.tail + 4U, 4U);
+    header.tail += 8U + size;
+    --header.framesCount;
+    if (header.wrapped != 0U && header.tail >= header.endPos) {
+        header.tail = 0U;
+        header.wrapped = 0U;
+    }
+}
+
+#endif  // IAGP_USE_FLIGHT_RECORDER
+
+////////////////////////////////////////////////////////////
+/////////////////////// TRACE EXPORTER /////////////////////
+////////////////////////////////////////////////////////////
+
+InAppGpuTraceExporter::~InAppGpuTraceExporter() {
+    Close();
+}
+
+bool InAppGpuTraceExporter::Open(const std::string& vFilePathName) {
+    Close();
+    m_FilePtr = fopen(vFilePathName.c_str(), "wb");
+    if (m_FilePtr == nullptr) {
+        IAGP_LOG_ERROR_MESSAGE("cant open the trace file %s", vFilePathName.c_str());
+        return false;
+    }
+    m_IsFirstEvent = true;
+    m_IsBaseTimeSet = false;
+    m_BaseTime = 0U;
+    m_Tracks.clear();
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", m_FilePtr);
+    return true;
+}
+
+void InAppGpuTraceExporter::Close() {
+    if (m_FilePtr != nullptr) {
+        fputs("\n]}\n", m_FilePtr);
+        fclose(m_FilePtr);
+        m_FilePtr = nullptr;
+    }
+}
+
+bool InAppGpuTraceExporter::IsOpened() const {
+    return (m_FilePtr != nullptr);
+}
+
+void InAppGpuTraceExporter::AddZone(const uint64_t vContext, const uint64_t vFrameId, const std::string& vSection, const std::string& vName,
+                                    const InAppGpuCollectedZone& vZone) {
+    if (m_FilePtr == nullptr) {
+        return;
+    }
+    const uint32_t track = m_GetTrack(vContext);
+    m_WriteEvent(track, vFrameId, vSection, vName, vZone.startTimeStamp, vZone.endTimeStamp, vZone.count);
+    if (vZone.cpuEndTimeStamp > 0U) {
+        m_WriteEvent(track + 1U, vFrameId, vSection, vName, vZone.cpuStartTimeStamp, vZone.cpuEndTimeStamp, vZone.count);
+    }
+}
+
+void InAppGpuTraceExporter::AddFrame(const std::vector<InAppGpuCollectedZone>& vZones) {
+    if (m_IsBaseTimeSet || vZones.empty()) {
+        return;
+    }
+    // the first frame give the origin of the timeline, the cpu start before the gpu
+    m_IsBaseTimeSet = true;
+    m_BaseTime = vZones[0].startTimeStamp;
+    for (const auto& zone : vZones) {
+        m_BaseTime = (zone.startTimeStamp < m_BaseTime) ? zone.startTimeStamp : m_BaseTime;
+        if (zone.cpuEndTimeStamp > 0U && zone.cpuStartTimeStamp < m_BaseTime) {
+            m_BaseTime = zone.cpuStartTimeStamp;
+        }
+    }
+}
+
+uint32_t InAppGpuTraceExporter::m_GetTrack(const uint64_t vContext) {
+    const auto it = m_Tracks.find(vContext);
+    if (it != m_Tracks.end()) {
+        return it->second;
+    }
+    // two tracks by context, the gpu one then the cpu one
+    const uint32_t track = (uint32_t)m_Tracks.size() * 2U + 1U;
+    m_Tracks[vContext] = track;
+    fprintf(m_FilePtr, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU context 0x%llx\"}}",  //
+            m_IsFirstEvent ? "" : ",", track, (unsigned long long)vContext);
+    fprintf(m_FilePtr, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"CPU context 0x%llx\"}}",  //
+            track + 1U, (unsigned long long)vContext);
+    m_IsFirstEvent = false;
+    return track;
+}
+
+void InAppGpuTraceExporter::m_WriteEvent(const uint32_t vTrack, const uint64_t vFrameId, const std::string& vSection, const std::string& vName,
+                                         const GLuint64 vStart, const GLuint64 vEnd, const GLuint vCount) {
+    // one complete event by zone, in us
+    const double start = (double)((int64_t)(vStart - m_BaseTime)) * 1e-3;
+    const double duration = (vEnd > vStart) ? (double)(vEnd - vStart) * 1e-3 : 0.0;
+    fprintf(m_FilePtr, "%s\n{\"name\":\"%s\",", m_IsFirstEvent ? "" : ",", m_Escape(vName));
+    fprintf(m_FilePtr, "\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%llu,\"count\":%u}}",  //
+            m_Escape(vSection), start, duration, vTrack, (unsigned long long)vFrameId, vCount);
+    m_IsFirstEvent = false;
+}
+
+const char* InAppGpuTraceExporter::m_Escape(const std::string& vStr) {
+    m_Escaped.clear();
+    for (const char c : vStr) {
+        if (c == '"' || c == '\\') {
+            m_Escaped += '\\';
+            m_Escaped += c;
+        } else if ((uint8_t)c < 0x20U) {
+            m_Escaped += ' ';
+        } else {
+            m_Escaped += c;
+        }
+    }
+    return m_Escaped.c_str();
+}
+
+////////////////////////////////////////////////////////////
+/////////////////////// GL CONTEXT /////////////////////////
+////////////////////////////////////////////////////////////
+
+// the generations are unique between the contexts, since a new context can be allocated at the address of a destroyed one
+// and the call sites identify a zone by the context address and its generation
+static uint32_t GetNewGeneration() {
+    static std::atomic<uint32_t> s_Generation{0U};
+    return ++s_Generation;
+}
+
+IAGPContextPtr InAppGpuGLContext::create(IAGP_GPU_CONTEXT vContext) {
+    auto res = std::make_shared<InAppGpuGLContext>(vContext);
+    res->m_This = res;
+    res->Init();
+    return res;
+}
+
+InAppGpuGLContext::InAppGpuGLContext(IAGP_GPU_CONTEXT vContext) : m_Context(vContext), m_QueryPool(vContext) {
+    m_Generation = GetNewGeneration();
+    m_ClearAggregates();
+}
+
+InAppGpuGLContext::~InAppGpuGLContext() {
+    Unit();
+}
+
+void InAppGpuGLContext::Clear() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto& slot : m_FrameSlots) {
+#ifdef IAGP_USE_COLLECTOR_THREAD
+        if (slot.pending.load(std::memory_order_acquire)) {
+            continue;  // the collector thread will release it, and ignore its zones
+        }
+#endif  // IAGP_USE_COLLECTOR_THREAD
+        m_ReleaseFrame(slot, false);
+        if (!slot.invocationQueries.empty()) {
+            m_QueryPool.Release(slot.invocationQueries.data(), (uint32_t)slot.invocationQueries.size());
+            slot.invocationQueries.clear();
+        }
+    }
+    // the current frame can be in recording, we keep it collectable
+    if (m_CurrentFrameId > 0U) {
+        m_RetiredFrameId = m_CurrentFrameId - 1U;
+    }
+    // the queries go back to the pool, without driver call
+    if (!m_Store.queryIds.empty()) {
+        m_QueryPool.Release(m_Store.queryIds.data(), (uint32_t)m_Store.queryIds.size());
+    }
+    m_Store.Clear();
+    m_DetailsRows.clear();
+    m_DetailsShownZones.clear();
+    m_DetailsDirty = true;
+    m_ClearAggregates();
+    m_SelectedZone = InAppGpuZoneStore::sInvalidIndex;
+    m_DepthToLastZone.clear();
+    m_FrameHistoryHead = 0U;
+    m_FrameHistoryCount = 0U;
+    m_IsFrameInspected = false;
+    m_IsCapturePending = false;
+    m_TriggerMasks.clear();
+    m_TriggerMedians.clear();
+    m_Generation = GetNewGeneration();
+}
+
+void InAppGpuGLContext::Init() {
+    // the first chunk is allocated before the first frame
+    // so the creation of zones will not call the driver in a measured zone
+    m_QueryPool.Init();
+}
+
+void InAppGpuGLContext::Unit() {
+    Clear();
+    m_QueryPool.Unit();
+    for (auto& slot : m_FrameSlots) {
+        InAppGpuBackend::DeleteFrameQueries(slot.queries);  // the frames are retired by the clear
+        CheckGLErrors;
+    }
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    for (auto& slot : m_FrameSlots) {
+        if (slot.resultsBuffer != 0U) {
+            InAppGpuBackend::DeleteResultsBuffer(slot.resultsBuffer);
+            CheckGLErrors;
+            slot.resultsCapacity = 0U;
+        }
+    }
+#endif  // IAGP_USE_COLLECTOR_THREAD
+}
+
+void InAppGpuGLContext::Collect() {
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    if (m_UseCollector) {
+        return;  // the collector thread do it
+    }
+#endif  // IAGP_USE_COLLECTOR_THREAD
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_COLLECT);
+
+#ifdef IAGP_DEBUG_MODE_LOGGING
+    IAGP_DEBUG_MODE_LOGGING("------ Collect Trhead (%i) -----", (intptr_t)m_Context);
+#endif
+
+    const int64_t cost_start = m_IsCostMeasured ? GetCpuTime() : 0;
+    // the gpu retire the frames in submission order
+    // so we stop at the first frame not finished
+    while (m_RetiredFrameId < m_CurrentFrameId) {
+        const uint64_t frame_id = m_RetiredFrameId + 1U;
+        const uint32_t slot_idx = (uint32_t)(frame_id % IAGP_FRAMES_IN_FLIGHT);
+        auto& slot = m_FrameSlots[slot_idx];
+        if (slot.frameId != frame_id) {  // the frame was discarded
+            ++m_RetiredFrameId;
+            continue;
+        }
+#ifdef IAGP_USE_COLLECTOR_THREAD
+        if (slot.pending.load(std::memory_order_acquire)) {
+            break;  // the collector thread is stopping, it will release the frame
+        }
+#endif  // IAGP_USE_COLLECTOR_THREAD
+        if (slot.fence == nullptr) {
+            if (frame_id == m_CurrentFrameId) {  // the frame is not ended
+                break;
+            }
+            ++m_RetiredFrameId;  // the frame was never ended
+            continue;
+        }
+        // the next frame will reuse this slot, so we have no choice than waiting for the gpu
+        const bool must_wait = (m_CurrentFrameId - frame_id + 1U) >= IAGP_FRAMES_IN_FLIGHT;
+        if (!m_IsFrameRetired(slot, must_wait)) {
+            break;
+        }
+        m_ReadBackFrame(slot_idx);
+        m_ReleaseFrame(slot, true);
+        ++m_RetiredFrameId;
+    }
+    if (m_IsCostMeasured) {
+        m_SamplingCost += GetCpuTime() - cost_start;
+    }
+
+#ifdef IAGP_DEBUG_MODE_LOGGING
+    IAGP_DEBUG_MODE_LOGGING("------ End Frame -----");
+#endif
+}
+
+void InAppGpuGLContext::EndFrame() {
+    auto& slot = m_FrameSlots[GetCurrentSlot()];
+    if (slot.frameId == m_CurrentFrameId && slot.fence == nullptr) {
+#ifdef IAGP_USE_COLLECTOR_THREAD
+        if (m_UseCollector) {
+            m_PushFrameToCollector(GetCurrentSlot());
+            return;
+        }
+#endif  // IAGP_USE_COLLECTOR_THREAD
+        slot.fence = InAppGpuBackend::InsertFence(slot.queries);
+        CheckGLErrors;
+    }
+}
+
+void InAppGpuGLContext::WriteStartTimeStamp(const uint32_t vZoneIdx, const uint32_t vGeneration) {
+    if (!IsZoneAlive(vZoneIdx, vGeneration)) {
+        return;
+    }
+    if (!m_IsFrameRecorded || !m_IsZoneSampled(vZoneIdx)) {
+        return;
+    }
+    const int64_t cost_start = m_IsCostMeasured ? GetCpuTime() : 0;
+    const uint32_t slot_idx = GetCurrentSlot();
+    auto& slot = m_FrameSlots[slot_idx];
+    const GLuint* ids = m_Store.GetQueryIds(vZoneIdx, slot_idx);
+    auto& query_frame = m_Store.GetQueryFrame(vZoneIdx, slot_idx);
+    if (query_frame != m_CurrentFrameId) {  // first call in this frame
+        query_frame = m_CurrentFrameId;
+        m_Store.GetCurrentCount(vZoneIdx, slot_idx) = 0U;
+        m_Store.GetCpuTimeStamps(vZoneIdx, slot_idx)[0] = GetCpuTime();  // the cpu time go from the first call to the last
+    } else {
+        // the next calls take a query pair in the pool of the slot, so each call is measured
+        ids = m_GetInvocationQueries(slot);
+    }
+    InAppGpuBackend::WriteTimeStamp(slot.queries, (uint32_t)slot.records.size(), ids[0]);
+    m_Store.invocationEndIds[vZoneIdx] = ids[1];
+    slot.records.push_back({ids[0], vZoneIdx, false});
+    slot.lastQueryId = ids[0];
+    if (m_IsCostMeasured) {
+        m_SamplingCost += GetCpuTime() - cost_start;
+    }
+}
+
+void InAppGpuGLContext::WriteEndTimeStamp(const uint32_t vZoneIdx, const uint32_t vGeneration) {
+    if (!IsZoneAlive(vZoneIdx, vGeneration)) {
+        return;
+    }
+    if (!m_IsFrameRecorded) {
+        return;
+    }
+    const uint32_t slot_idx = GetCurrentSlot();
+    auto& slot = m_FrameSlots[slot_idx];
+    const GLuint id = m_Store.invocationEndIds[vZoneIdx];
+    if (id == 0U) {  // the start was not written in this frame, or the zone is not sampled
+        return;
+    }
+    const int64_t cost_start = m_IsCostMeasured ? GetCpuTime() : 0;
+    m_Store.invocationEndIds[vZoneIdx] = 0U;
+    InAppGpuBackend::WriteTimeStamp(slot.queries, (uint32_t)slot.records.size(), id);
+    m_Store.GetCpuTimeStamps(vZoneIdx, slot_idx)[1] = GetCpuTime();
+    ++m_Store.GetCurrentCount(vZoneIdx, slot_idx);
+    slot.records.push_back({id, vZoneIdx, true});
+    slot.lastQueryId = id;
+    if (m_Store.depths[vZoneIdx] == 0U) {  // the root zone is the frame
+        EndFrame();
+    }
+    if (m_IsCostMeasured) {
+        m_SamplingCost += GetCpuTime() - cost_start;
+    }
+}
+
+uint32_t InAppGpuGLContext::GetCurrentSlot() const {
+    return (uint32_t)(m_CurrentFrameId % IAGP_FRAMES_IN_FLIGHT);
+}
+
+uint32_t InAppGpuGLContext::GetGeneration() const {
+    return m_Generation;
+}
+
+bool InAppGpuGLContext::IsZoneAlive(const uint32_t vZoneIdx, const uint32_t vGeneration) const {
+    // a zone can be in recording when the context is cleared
+    return (vGeneration == m_Generation && vZoneIdx < m_Store.size());
+}
+
+uint32_t& InAppGpuGLContext::GetCurrentDepthRef() {
+    return m_CurrentDepth;
+}
+
+uint32_t InAppGpuGLContext::GetMaxDepth() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_MaxDepth;
+}
+
+const InAppGpuZoneStore& InAppGpuGLContext::GetZoneStore() const {
+    return m_Store;
+}
+
+const InAppGpuQueryPool::poolStats& InAppGpuGLContext::GetQueryPoolStats() const {
+    return m_QueryPool.GetStats();
+}
+
+uint32_t InAppGpuGLContext::GetSamplingPeriod() const {
+    switch (InAppGpuProfiler::sSamplingMode) {
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_FRAMES:
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_SUBTREES: return (uint32_t)ImMax(InAppGpuProfiler::sSamplingPeriod, 1);
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ADAPTIVE: return m_SamplingPeriod;
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ALL:
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_Count:
+        default: return 1U;
+    }
+}
+
+// the mean cpu time of the profiler per frame in us, only measured by the adaptive sampling
+double InAppGpuGLContext::GetSamplingCost() const {
+    return m_SampledFrameCost.GetValue() / (double)m_SamplingPeriod;
+}
+
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+size_t InAppGpuGLContext::GetZoneTreeBytes() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Store.GetHeapBytes();
+}
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
+void InAppGpuGLContext::DrawFlamGraph(const InAppGpuGraphTypeEnum& vGraphType) {
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_DRAW_FLAME_GRAPH);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Store.size() > 0U) {
+        m_UpdateShownTimes();
+        if (InAppGpuQueryZone::sShowFrameHistory) {
+            m_DrawFrameHistory();
+        }
+        if (m_SelectedZone < m_Store.size()) {
+            const uint32_t selected_zone = m_SelectedZone;
+            m_DrawBreadCrumbTrail(selected_zone, m_SelectedZone);
+            m_DrawFlamGraph(vGraphType, selected_zone, m_SelectedZone);
+        } else {
+            m_DrawFlamGraph(vGraphType, 0U, m_SelectedZone);
+        }
+    }
+}
+
+bool InAppGpuGLContext::DrawFlamGraph(const InAppGpuGraphTypeEnum& vGraphType, const uint32_t vZoneIdx, const uint32_t vGeneration,
+                                      uint32_t& vOutSelectedZone) {
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_DRAW_FLAME_GRAPH);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!IsZoneAlive(vZoneIdx, vGeneration)) {
+        return false;
+    }
+    m_UpdateShownTimes();
+    m_DrawFlamGraph(vGraphType, vZoneIdx, vOutSelectedZone);
+    return true;
+}
+
+// only the rows in the view are submitted, so the cost dont depend of the count of zones
+void InAppGpuGLContext::DrawDetails(const InAppGpuDetailsColumnEnum& vSortColumn, const bool vSortDescending) {
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_DRAW_DETAILS);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Store.size() > 0U) {
+        m_UpdateShownTimes();
+        m_UpdateDetailsRows(vSortColumn, vSortDescending);
+        ImGui::PushID(this);
+        ImGuiListClipper clipper;
+        clipper.Begin((int)m_DetailsRows.size());
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                m_DrawDetailsRow(m_DetailsRows[row]);
+            }
+        }
+        ImGui::PopID();
+    }
+}
+
+void InAppGpuGLContext::ResetStatistics() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Store.ResetStatistics();
+}
+
+bool InAppGpuGLContext::InspectFrame(const InAppGpuHistoryFrame& vFrame) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_InspectFrame(vFrame);
+    return m_IsFrameInspected && m_InspectedFrameId == vFrame.frameId;
+}
+
+std::string InAppGpuGLContext::GetZoneTitle(const uint32_t vZoneIdx, const uint32_t vGeneration) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (IsZoneAlive(vZoneIdx, vGeneration)) {
+        return m_Store.zones[vZoneIdx].imGuiTitle;
+    }
+    return {};
+}
+
+uint32_t InAppGpuGLContext::GetQueryZoneForName(const void* vPtr, const std::string& vName, const std::string& vSection, const bool vIsRoot) {
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_GET_QUERY_ZONE);
+    return m_GetQueryZone(vPtr, vName.c_str(), vSection.c_str(), HashZoneLabel(vSection.c_str(), vName.c_str()), vIsRoot);
+}
+
+uint32_t InAppGpuGLContext::GetQueryZoneForCallSite(const void* vPtr, InAppGpuCallSite& vCallSite, const bool vIsRoot) {
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_GET_QUERY_ZONE);
+    // only the thread where the context is current record in it
+    // so the zones can be read without lock here
+    const uint32_t depth = m_CurrentDepth;
+    if (depth > 0U) {  // the root zone begin the frame, so it never take the fast path
+        const uint32_t parent_idx = m_GetQueryZoneFromDepth(depth - 1U);
+        for (const auto& entry : vCallSite.entries) {
+            if (entry.context == this && entry.generation == m_Generation &&  //
+                entry.parentIdx == parent_idx && entry.ptr == vPtr) {
+                m_SetQueryZoneForDepth(entry.zoneIdx, depth);
+                return entry.zoneIdx;
+            }
+        }
+    }
+    const uint32_t res = m_GetQueryZone(vPtr, vCallSite.fmt, vCallSite.section, vCallSite.hash, vIsRoot);
+    if (res != InAppGpuZoneStore::sInvalidIndex) {
+        // a helper called from several parents keep one entry per parent
+        auto& entry = vCallSite.entries[vCallSite.nextEntry];
+        vCallSite.nextEntry = (vCallSite.nextEntry + 1U) % IAGP_CALL_SITE_PARENTS_COUNT;
+        entry.context = this;
+        entry.ptr = vPtr;
+        entry.generation = m_Generation;
+        entry.parentIdx = m_Store.parents[res];
+        entry.zoneIdx = res;
+    }
+    return res;
+}
+
+uint32_t InAppGpuGLContext::AddRecordedZone(const uint32_t vParentIdx, const std::string& vName, const std::string& vSection) {
+    if (vParentIdx != InAppGpuZoneStore::sInvalidIndex && vParentIdx >= m_Store.size()) {
+        return InAppGpuZoneStore::sInvalidIndex;  // a parent is always added before its childs
+    }
+    const bool is_root = (vParentIdx == InAppGpuZoneStore::sInvalidIndex);
+    return m_AddZone(vParentIdx, nullptr, vName.c_str(), vSection.c_str(), HashZoneLabel(vSection.c_str(), vName.c_str()), is_root);
+}
+
+void InAppGpuGLContext::ReplayFrame(const std::vector<InAppGpuCollectedZone>& vZones) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const uint32_t zones_count = m_Store.size();
+    // the zones are in end order, but the root starts are needed before the ends of the childs
+    for (const auto& zone : vZones) {
+        if (zone.zoneIdx < zones_count) {
+            m_Store.SetStartTimeStamp(zone.zoneIdx, zone.startTimeStamp);
+        }
+    }
+    for (const auto& zone : vZones) {
+        if (zone.zoneIdx < zones_count) {
+            m_Store.lastCounts[zone.zoneIdx] = zone.count;
+            m_Store.cpuStartTimeStamps[zone.zoneIdx] = zone.cpuStartTimeStamp;
+            m_Store.cpuEndTimeStamps[zone.zoneIdx] = zone.cpuEndTimeStamp;
+            m_Store.SetEndTimeStamp(zone.zoneIdx, zone.endTimeStamp);
+        }
+    }
+    m_UpdateDetailsShownZones(vZones);
+    m_UpdateAggregates(vZones);
+}
+
+uint32_t InAppGpuGLContext::m_GetQueryZone(const void* vPtr, const char* vName, const char* vSection, const uint64_t vLabelHash, const bool vIsRoot) {
+    uint32_t res = InAppGpuZoneStore::sInvalidIndex;
+
+    /////////////////////////////////////////////
+    //////////////// CREATION ///////////////////
+    /////////////////////////////////////////////
+
+    if (m_CurrentDepth == 0) {  // root zone
+#ifdef IAGP_DEBUG_MODE_LOGGING
+        IAGP_DEBUG_MODE_LOGGING("------ Start Frame -----");
+#endif
+        m_DepthToLastZone.clear();
+        m_BeginFrame();
+        if (m_Store.size() > 0U && m_Store.zones[0].name != vName) {
+            // at depth 0 there is only one frame
+            IAGP_LOG_DEBUG_ERROR_MESSAGE("was registerd at depth %u %s. but we got %s\nwe clear the profiler",  //
+                                         m_CurrentDepth, m_Store.zones[0].name.c_str(), vName);
+            // maybe the scoped frame is taken outside of the main frame
+            Clear();
+        }
+        if (m_Store.size() == 0U) {
+            res = m_AddZone(InAppGpuZoneStore::sInvalidIndex, vPtr, vName, vSection, vLabelHash, vIsRoot);
+#ifdef IAGP_DEBUG_MODE_LOGGING
+            // IAGP_DEBUG_MODE_LOGGING("Profile : add zone %s at puDepth %u", vName, m_CurrentDepth);
+#endif
+        } else {
+            res = 0U;
+        }
+    } else {  // else child zone
+        const uint32_t parent_idx = m_GetQueryZoneFromDepth(m_CurrentDepth - 1U);
+        if (parent_idx == InAppGpuZoneStore::sInvalidIndex) {
+            return res;  // happen when profiling is activated inside a profiling zone
+        }
+        res = m_Store.FindChild(parent_idx, vPtr, vName, vSection, vLabelHash);
+        if (res == InAppGpuZoneStore::sInvalidIndex) {  // not found
+            res = m_AddZone(parent_idx, vPtr, vName, vSection, vLabelHash, vIsRoot);
+#ifdef IAGP_DEBUG_MODE_LOGGING
+            // IAGP_DEBUG_MODE_LOGGING("Profile : add zone %s at puDepth %u", vName, m_CurrentDepth);
+#endif
+        }
+    }
+
+    /////////////////////////////////////////////
+    //////////////// UTILISATION ////////////////
+    /////////////////////////////////////////////
+
+    m_SetQueryZoneForDepth(res, m_CurrentDepth);
+
+    return res;
+}
+
+uint32_t InAppGpuGLContext::m_AddZone(const uint32_t vParentIdx, const void* vPtr, const char* vName, const char* vSection, const uint64_t vLabelHash,
+                                      const bool vIsRoot) {
+    // the ui can draw the store in same time
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const uint32_t res = m_Store.AddZone(vParentIdx, vPtr, vName, vSection, vLabelHash, vIsRoot);
+    m_DetailsDirty = true;
+    m_QueryPool.Acquire(m_Store.GetQueryIds(res, 0U), 2U * IAGP_FRAMES_IN_FLIGHT);
+    m_UpdateBreadCrumbTrail(res);
+    // there is many link issues with 'max' in cross compilation so we dont using it
+    if (m_Store.depths[res] > m_MaxDepth) {
+        m_MaxDepth = m_Store.depths[res];
+    }
+    return res;
+}
+
+void InAppGpuGLContext::m_DrawFlamGraph(const InAppGpuGraphTypeEnum& vGraphType, const uint32_t vZoneIdx, uint32_t& vOutSelectedZone) {
+    ImGuiWindow* window = ImGui::GetCurrentWindow();
+    if (window->SkipItems || vZoneIdx >= m_Store.size()) {
+        return;
+    }
+
+    ImGui::PushID(this);
+    switch (vGraphType) {
+        case InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL:  // horizontal flame graph (standard and legacy)
+            m_DrawHorizontalFlameGraph(vZoneIdx, vOutSelectedZone);
+            break;
+        case InAppGpuGraphTypeEnum::IN_APP_GPU_CIRCULAR:  // circular flame graph
+            m_DrawCircularFlameGraph(vZoneIdx, vOutSelectedZone);
+            break;
+        case InAppGpuGraphTypeEnum::IN_APP_GPU_Count:
+        default: break;
+    }
+    ImGui::PopID();
+}
+
+void InAppGpuGLContext::m_BeginFrame() {
+    ++m_CurrentFrameId;
+    auto& slot = m_FrameSlots[GetCurrentSlot()];
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    const auto* profiler_ptr = InAppGpuProfiler::Instance();
+    if (profiler_ptr->IsCollectorThreadStopped()) {
+        ReleaseCollectorFrames();  // the frames pushed after the end of the collector thread
+    }
+    m_UseCollector = profiler_ptr->IsCollectorThreadRunning();
+    if (slot.pending.load(std::memory_order_acquire)) {
+        m_IsFrameRecorded = false;
+        return;  // the collector thread is late, this frame is not recorded
+    }
+#endif  // IAGP_USE_COLLECTOR_THREAD
+    m_IsFrameRecorded = m_IsFrameSampled();
+    if (!m_IsFrameRecorded) {
+        return;  // the frame is not sampled, its slot keep the frame not collected
+    }
+    if (slot.fence != nullptr || !slot.records.empty()) {
+        // the frame was not collected (the profiler is paused or Collect is not called)
+        m_ReleaseFrame(slot, false);
+    }
+    slot.frameId = m_CurrentFrameId;
+    m_CalibrateClocks();
+    slot.clockOffset = m_ClockOffset;
+    slot.isClockCalibrated = m_IsClockCalibrated;
+    if (m_CurrentFrameId - m_RetiredFrameId > IAGP_FRAMES_IN_FLIGHT) {  // the too old frames are lost
+        m_RetiredFrameId = m_CurrentFrameId - IAGP_FRAMES_IN_FLIGHT;
+    }
+}
+
+bool InAppGpuGLContext::m_IsFrameSampled() {
+    m_IsCostMeasured = false;
+    switch (InAppGpuProfiler::sSamplingMode) {
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_FRAMES: return (m_CurrentFrameId % GetSamplingPeriod()) == 0U;
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ADAPTIVE: {
+            m_IsCostMeasured = true;
+            if (m_CurrentFrameId - m_LastSampledFrameId < m_SamplingPeriod) {
+                return false;
+            }
+            if (m_LastSampledFrameId > 0U) {
+                // the cost since the last sampled frame, its scopes and the collect of the previous frames
+                // the period is the count of frames needed for spread this cost under the budget
+                m_SampledFrameCost.AddValue((double)m_SamplingCost * 1e-3);  // ns to us
+                const double budget = ImMax((double)InAppGpuProfiler::sSamplingBudget, 1.0);
+                const double period = std::ceil(m_SampledFrameCost.GetValue() / budget);
+                m_SamplingPeriod = (uint32_t)ImClamp(period, 1.0, (double)IAGP_SAMPLING_MAX_PERIOD);
+            }
+            m_SamplingCost = 0;
+            m_LastSampledFrameId = m_CurrentFrameId;
+            return true;
+        }
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ALL:
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_SUBTREES:
+        case InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_Count:
+        default: return true;
+    }
+}
+
+// the root is always sampled, so the frame keep its time
+bool InAppGpuGLContext::m_IsZoneSampled(const uint32_t vZoneIdx) const {
+    if (InAppGpuProfiler::sSamplingMode != InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_SUBTREES || m_Store.depths[vZoneIdx] == 0U) {
+        return true;
+    }
+    const uint32_t period = GetSamplingPeriod();
+    return (m_Store.subtreeRanks[vZoneIdx] % period) == (uint32_t)(m_CurrentFrameId % period);
+}
+
+bool InAppGpuGLContext::m_IsFrameRetired(frameSlot& vSlot, const bool vWait) {
+    // the flush is needed for be sure than the fence will be signaled one day
+    const bool res = InAppGpuBackend::WaitFence(vSlot.queries, vSlot.fence, true, vWait ? IAGP_FENCE_TIMEOUT : 0U);
+    CheckGLErrors;
+    if (!res) {
+        if (vWait) {
+            IAGP_LOG_ERROR_MESSAGE("frame %u not retired by the gpu after %u ns", (uint32_t)vSlot.frameId, (uint32_t)IAGP_FENCE_TIMEOUT);
+        }
+        return false;
+    }
+    if (vSlot.lastQueryId == 0U || vWait) {  // if we wait, the result read will wait the availability
+        return true;
+    }
+    // the timestamps are retired in submission order
+    // so the last query of the frame give the availability of the whole frame
+    return InAppGpuBackend::IsResultAvailable(vSlot.queries, (uint32_t)vSlot.records.size() - 1U, vSlot.lastQueryId);
+}
+
+void InAppGpuGLContext::m_ReadBackFrame(const uint32_t vSlotIdx) {
+    auto& slot = m_FrameSlots[vSlotIdx];
+    // all the results of the frame are read in one time
+    const uint32_t records_count = (uint32_t)slot.records.size();
+    m_ReadBackIds.resize(records_count);
+    m_ReadBackResults.resize(records_count);
+    for (uint32_t idx = 0U; idx < records_count; ++idx) {
+        m_ReadBackIds[idx] = slot.records[idx].queryId;
+    }
+    InAppGpuBackend::GetResults(slot.queries, m_ReadBackIds.data(), records_count, m_ReadBackResults.data());
+    CheckGLErrors;
+
+    // the ui can read the timings in same time
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const int64_t clock_offset = m_GetClockOffset(vSlotIdx, m_ReadBackResults.data());
+    m_CollectedZones.clear();
+    for (uint32_t idx = 0U; idx < records_count; ++idx) {
+        const auto& record = slot.records[idx];
+        m_CollectRecord(record, m_ReadBackResults[idx], vSlotIdx, clock_offset, m_Store.GetCurrentCount(record.zoneIdx, vSlotIdx));
+    }
+    m_OnFrameCollected(slot.frameId);
+}
+
+void InAppGpuGLContext::m_ReleaseFrame(frameSlot& vSlot, const bool vIsRetired) {
+    if (vSlot.fence != nullptr) {
+        if (!vIsRetired) {
+            // the gpu can still write the queries of a frame not collected, and vulkan cant reset them before
+            InAppGpuBackend::WaitFence(vSlot.queries, vSlot.fence, true, IAGP_FENCE_TIMEOUT);
+        }
+        InAppGpuBackend::DeleteFence(vSlot.fence);
+        vSlot.fence = nullptr;
+    }
+    vSlot.lastQueryId = 0U;
+    InAppGpuBackend::ResetQueries(vSlot.queries, (uint32_t)vSlot.records.size());  // vulkan need a reset before the next write
+    CheckGLErrors;
+    vSlot.records.clear();
+    // the used invocation queries are in the records, so they are reset
+    // the queries not used in this frame go back to the pool of the context, so a spike dont keep them
+    const uint32_t keep_count = ImMax(vSlot.invocationQueriesUsed, 32U);
+    if ((uint32_t)vSlot.invocationQueries.size() > keep_count) {
+        m_QueryPool.Release(vSlot.invocationQueries.data() + keep_count, (uint32_t)vSlot.invocationQueries.size() - keep_count);
+        vSlot.invocationQueries.resize(keep_count);
+    }
+    vSlot.invocationQueriesUsed = 0U;
+}
+
+const GLuint* InAppGpuGLContext::m_GetInvocationQueries(frameSlot& vSlot) {
+    // the queries come from the pool of the context, so the driver is called only when the whole context need more
+    if (vSlot.invocationQueriesUsed + 2U > (uint32_t)vSlot.invocationQueries.size()) {
+        const uint32_t offset = (uint32_t)vSlot.invocationQueries.size();
+        const uint32_t count = ImMax(offset, 32U);
+        vSlot.invocationQueries.resize(offset + count);
+        m_QueryPool.Acquire(vSlot.invocationQueries.data() + offset, count);
+    }
+    const GLuint* res = vSlot.invocationQueries.data() + vSlot.invocationQueriesUsed;
+    vSlot.invocationQueriesUsed += 2U;
+    return res;
+}
+
+// the zone go from the start of its first invocation to the end of its last, so its bar is where the gpu was
+// the invocations are summed apart, so a zone called in a loop give its real cost even if the calls are interleaved
+void InAppGpuGLContext::m_CollectRecord(const readbackRecord& vRecord, const GLuint64 vValue, const uint32_t vSlotIdx, const int64_t vClockOffset,
+                                        const GLuint vCount) {
+    const uint32_t zone_idx = vRecord.zoneIdx;
+    auto& collected = m_Store.invocationsCollected[zone_idx];
+    if (!vRecord.isEnd) {
+        if (collected == 0U) {  // first invocation
+            m_Store.SetStartTimeStamp(zone_idx, vValue);
+            m_Store.zones[zone_idx].invocationSumTime = 0U;
+            m_Store.zones[zone_idx].invocationMinTime = UINT64_MAX;
+            m_Store.zones[zone_idx].invocationMaxTime = 0U;
+        }
+        m_Store.invocationStarts[zone_idx] = vValue;
+        return;
+    }
+    const GLuint64 start = m_Store.invocationStarts[zone_idx];
+    const GLuint64 elapsed = (vValue > start) ? vValue - start : 0U;
+    m_Store.zones[zone_idx].invocationSumTime += elapsed;
+    m_Store.zones[zone_idx].invocationMinTime = ImMin(m_Store.zones[zone_idx].invocationMinTime, elapsed);
+    m_Store.zones[zone_idx].invocationMaxTime = ImMax(m_Store.zones[zone_idx].invocationMaxTime, elapsed);
+    if (++collected < vCount) {
+        return;
+    }
+    collected = 0U;  // last invocation
+    m_Store.lastCounts[zone_idx] = vCount;
+    m_Store.SetCpuTimeStamps(zone_idx, vSlotIdx, vClockOffset);
+    m_Store.SetEndTimeStamp(zone_idx, vValue);  // the records are in submission order, so its the end of the last call
+    m_AddCollectedZone(zone_idx);
+}
+
+void InAppGpuGLContext::m_CalibrateClocks() {
+    // the two clocks drift a bit, so the offset is measured again periodically
+    if (m_CurrentFrameId < m_NextCalibrationFrameId) {
+        return;
+    }
+    m_NextCalibrationFrameId = m_CurrentFrameId + IAGP_CLOCK_CALIBRATION_PERIOD;
+    GLuint64 gpu_time = 0U;
+    const int64_t cpu_time = GetCpuTime();
+    m_IsClockCalibrated = InAppGpuBackend::GetTimeStamp(gpu_time);
+    CheckGLErrors;
+    if (m_IsClockCalibrated) {
+        m_ClockOffset = (int64_t)gpu_time - cpu_time;
+    }
+}
+
+int64_t InAppGpuGLContext::m_GetClockOffset(const uint32_t vSlotIdx, const GLuint64* vResults) {
+    const auto& slot = m_FrameSlots[vSlotIdx];
+    if (slot.isClockCalibrated) {
+        return slot.clockOffset;
+    }
+    // the gpu time is unknown, so the cpu start of the frame is aligned on its gpu start
+    // the first record of a frame is always the start of the root zone
+    if (!slot.records.empty() && !slot.records[0].isEnd) {
+        return (int64_t)vResults[0] - m_Store.GetCpuTimeStamps(slot.records[0].zoneIdx, vSlotIdx)[0];
+    }
+    return 0;
+}
+
+void InAppGpuGLContext::m_AddCollectedZone(const uint32_t vZoneIdx) {
+    InAppGpuCollectedZone zone;
+    zone.zoneIdx = vZoneIdx;
+    zone.count = m_Store.lastCounts[vZoneIdx];
+    zone.startTimeStamp = m_Store.startTimeStamps[vZoneIdx];
+    zone.endTimeStamp = m_Store.endTimeStamps[vZoneIdx];
+    zone.cpuStartTimeStamp = m_Store.cpuStartTimeStamps[vZoneIdx];
+    zone.cpuEndTimeStamp = m_Store.cpuEndTimeStamps[vZoneIdx];
+    m_CollectedZones.push_back(zone);
+}
+
+void InAppGpuGLContext::m_OnFrameCollected(const uint64_t vFrameId) {
+    // called under the lock, the zones cant change
+    if (!m_CollectedZones.empty()) {
+        m_UpdateDetailsShownZones(m_CollectedZones);
+        m_UpdateAggregates(m_CollectedZones);
+        m_AddFrameToHistory(vFrameId);
+        InAppGpuProfiler::Instance()->OnFrameCollected(m_Context, m_Generation, vFrameId, m_Store, m_CollectedZones);
+    }
+}
+
+void InAppGpuGLContext::m_AddFrameToHistory(const uint64_t vFrameId) {
+    if (m_FrameHistory.empty()) {
+        m_FrameHistory.resize(IAGP_FRAME_HISTORY_COUNT);
+    }
+    // the vectors of the old frames are reused, so nothing is allocated after the first turn
+    auto& frame = m_FrameHistory[m_FrameHistoryHead];
+    frame.frameId = vFrameId;
+    frame.generation = m_Generation;
+    frame.elapsedTime = 0.0;
+    frame.zones.resize(m_CollectedZones.size());
+    const auto clamp = [](const int64_t vValue) { return (vValue < 0) ? 0U : ((vValue > (int64_t)UINT32_MAX) ? UINT32_MAX : (uint32_t)vValue); };
+    for (size_t idx = 0U; idx < m_CollectedZones.size(); ++idx) {
+        const auto& collected = m_CollectedZones[idx];
+        const uint32_t root_idx = m_Store.roots[collected.zoneIdx];
+        const int64_t root_start = (int64_t)m_Store.startTimeStamps[root_idx];  // of this frame, the whole frame is retrieved
+        const int64_t elapsed = (int64_t)(collected.endTimeStamp - collected.startTimeStamp);
+        auto& zone = frame.zones[idx];
+        zone.zoneIdx = collected.zoneIdx;
+        zone.count = collected.count;
+        zone.startOffset = clamp((int64_t)collected.startTimeStamp - root_start);
+        zone.elapsedTime = clamp(elapsed);
+        zone.cpuStartOffset = 0;
+        zone.cpuElapsedTime = 0U;
+        if (collected.cpuEndTimeStamp > 0U) {
+            const int64_t cpu_offset = (int64_t)collected.cpuStartTimeStamp - root_start;
+            zone.cpuStartOffset = (cpu_offset < INT32_MIN) ? INT32_MIN : ((cpu_offset > INT32_MAX) ? INT32_MAX : (int32_t)cpu_offset);
+            zone.cpuElapsedTime = clamp((int64_t)(collected.cpuEndTimeStamp - collected.cpuStartTimeStamp));
+        }
+        if (root_idx == collected.zoneIdx) {
+            frame.elapsedTime += (double)elapsed * 1e-6;
+        }
+    }
+    m_FrameHistoryHead = (m_FrameHistoryHead + 1U) % IAGP_FRAME_HISTORY_COUNT;
+    if (m_FrameHistoryCount < IAGP_FRAME_HISTORY_COUNT) {
+        ++m_FrameHistoryCount;
+    }
+    m_CheckTriggers(frame);
+}
+
+void InAppGpuGLContext::m_CheckTriggers(const InAppGpuHistoryFrame& vFrame) {
+    auto* profiler_ptr = InAppGpuProfiler::Instance();
+    if (profiler_ptr->GetTriggerRulesVersion() != m_TriggerRulesVersion) {
+        profiler_ptr->GetTriggerRules(m_TriggerRules, m_TriggerRulesVersion);
+        m_HasMedianRules = false;
+        for (const auto& rule : m_TriggerRules) {
+            m_HasMedianRules |= (rule.medianFactor > 0.0);
+        }
+        m_TriggerMasks.clear();  // rebuilt for all the zones
+        m_TriggerMedians.clear();
+    }
+    if (m_IsCapturePending) {
+        m_PendingCapture.frames.push_back(vFrame);
+        if (--m_CaptureFramesLeft == 0U) {
+            m_EndCapture();
+        }
+    }
+    if (m_TriggerRules.empty()) {
+        return;
+    }
+    // the rules of the new zones, the names are only compared one time
+    const uint32_t zones_count = m_Store.size();
+    for (uint32_t idx = (uint32_t)m_TriggerMasks.size(); idx < zones_count; ++idx) {
+        uint32_t mask = 0U;
+        for (uint32_t rule_idx = 0U; rule_idx < (uint32_t)m_TriggerRules.size(); ++rule_idx) {
+            const auto& rule = m_TriggerRules[rule_idx];
+            if (rule.zoneName.empty() ? (m_Store.roots[idx] == idx) : (rule.zoneName == m_Store.zones[idx].name)) {
+                mask |= 1U << rule_idx;
+            }
+        }
+        m_TriggerMasks.push_back(mask);
+    }
+    if (m_HasMedianRules) {
+        m_TriggerMedians.resize(zones_count);
+    }
+    for (const auto& zone : vFrame.zones) {
+        const uint32_t mask = m_TriggerMasks[zone.zoneIdx];
+        if (mask == 0U) {
+            continue;
+        }
+        const double time = zone.elapsedTime * 1e-6;
+        InAppGpuMedianSmoothing* median_ptr = m_HasMedianRules ? &m_TriggerMedians[zone.zoneIdx] : nullptr;
+        const bool is_median_ready = (median_ptr != nullptr && median_ptr->GetCount() >= IAGP_MEDIAN_LEVELS_COUNT);
+        for (uint32_t rule_idx = 0U; rule_idx < (uint32_t)m_TriggerRules.size() && !m_IsCapturePending; ++rule_idx) {
+            if ((mask & (1U << rule_idx)) == 0U) {
+                continue;
+            }
+            const auto& rule = m_TriggerRules[rule_idx];
+            if (rule.thresholdTime > 0.0 && time > rule.thresholdTime) {
+                m_StartCapture(rule_idx, zone, rule.thresholdTime);
+            } else if (rule.medianFactor > 0.0 && is_median_ready && time > rule.medianFactor * median_ptr->GetValue()) {
+                m_StartCapture(rule_idx, zone, rule.medianFactor * median_ptr->GetValue());
+            }
+        }
+        if (median_ptr != nullptr) {
+            median_ptr->AddValue(time);  // after the check, a spike is not in its own median
+        }
+    }
+}
+
+void InAppGpuGLContext::m_StartCapture(const uint32_t vRuleIdx, const InAppGpuHistoryZone& vZone, const double vLimit) {
+    // the last frame of the history is the fired frame
+    const uint32_t frames_before = (m_FrameHistoryCount > IAGP_CAPTURE_FRAMES_AROUND) ? IAGP_CAPTURE_FRAMES_AROUND : m_FrameHistoryCount - 1U;
+    const auto& fired_frame = m_FrameHistory[(m_FrameHistoryHead + IAGP_FRAME_HISTORY_COUNT - 1U) % IAGP_FRAME_HISTORY_COUNT];
+    m_PendingCapture = InAppGpuCapture();
+    m_PendingCapture.context = m_This;
+    m_PendingCapture.generation = m_Generation;
+    m_PendingCapture.ruleIdx = vRuleIdx;
+    m_PendingCapture.frameId = fired_frame.frameId;
+    m_PendingCapture.zoneName = m_Store.zones[vZone.zoneIdx].name;
+    m_PendingCapture.time = vZone.elapsedTime * 1e-6;
+    m_PendingCapture.limit = vLimit;
+    for (uint32_t idx = frames_before + 1U; idx > 0U; --idx) {
+        m_PendingCapture.frames.push_back(m_FrameHistory[(m_FrameHistoryHead + IAGP_FRAME_HISTORY_COUNT - idx) % IAGP_FRAME_HISTORY_COUNT]);
+    }
+    m_PauseAfterCapture = m_TriggerRules[vRuleIdx].pauseProfiler;
+    m_CaptureFramesLeft = IAGP_CAPTURE_FRAMES_AROUND;
+    m_IsCapturePending = true;
+    if (m_CaptureFramesLeft == 0U) {
+        m_EndCapture();
+    }
+}
+
+void InAppGpuGLContext::m_EndCapture() {
+    m_IsCapturePending = false;
+    InAppGpuProfiler::Instance()->AddCapture(m_PendingCapture);
+    if (m_PauseAfterCapture) {
+        InAppGpuProfiler::sIsPaused.store(true, std::memory_order_release);
+    }
+}
+
+void InAppGpuGLContext::m_InspectFrame(const InAppGpuHistoryFrame& vFrame) {
+    if (vFrame.generation != m_Generation) {
+        return;  // the zones was cleared
+    }
+    // the times are copied, so the frame can leave the history during the inspection
+    const size_t zones_count = m_Store.size();
+    m_InspectedTimes.startTimes.assign(zones_count, 0.0);
+    m_InspectedTimes.endTimes.assign(zones_count, 0.0);
+    m_InspectedTimes.elapsedTimes.assign(zones_count, 0.0);
+    m_InspectedTimes.cpuStartTimes.assign(zones_count, 0.0);
+    m_InspectedTimes.cpuEndTimes.assign(zones_count, 0.0);
+    m_InspectedTimes.cpuElapsedTimes.assign(zones_count, 0.0);
+    m_InspectedTimes.counts.assign(zones_count, 0U);
+    for (const auto& zone : vFrame.zones) {
+        if (zone.zoneIdx < zones_count) {
+            const uint32_t idx = zone.zoneIdx;
+            m_InspectedTimes.startTimes[idx] = zone.startOffset * 1e-6;
+            m_InspectedTimes.elapsedTimes[idx] = zone.elapsedTime * 1e-6;
+            m_InspectedTimes.endTimes[idx] = m_InspectedTimes.startTimes[idx] + m_InspectedTimes.elapsedTimes[idx];
+            m_InspectedTimes.cpuStartTimes[idx] = zone.cpuStartOffset * 1e-6;
+            m_InspectedTimes.cpuElapsedTimes[idx] = zone.cpuElapsedTime * 1e-6;
+            m_InspectedTimes.cpuEndTimes[idx] = m_InspectedTimes.cpuStartTimes[idx] + m_InspectedTimes.cpuElapsedTimes[idx];
+            m_InspectedTimes.counts[idx] = zone.count;
+        }
+    }
+    m_InspectedFrameId = vFrame.frameId;
+    m_IsFrameInspected = true;
+}
+
+void InAppGpuGLContext::m_UpdateShownTimes() {
+    if (m_IsFrameInspected) {
+        const size_t zones_count = m_Store.size();
+        if (m_InspectedTimes.counts.size() < zones_count) {
+            // the zones added after the inspected frame are not in it
+            m_InspectedTimes.startTimes.resize(zones_count, 0.0);
+            m_InspectedTimes.endTimes.resize(zones_count, 0.0);
+            m_InspectedTimes.elapsedTimes.resize(zones_count, 0.0);
+            m_InspectedTimes.cpuStartTimes.resize(zones_count, 0.0);
+            m_InspectedTimes.cpuEndTimes.resize(zones_count, 0.0);
+            m_InspectedTimes.cpuElapsedTimes.resize(zones_count, 0.0);
+            m_InspectedTimes.counts.resize(zones_count, 0U);
+        }
+        m_Shown.startTimes = m_InspectedTimes.startTimes.data();
+        m_Shown.endTimes = m_InspectedTimes.endTimes.data();
+        m_Shown.elapsedTimes = m_InspectedTimes.elapsedTimes.data();
+        m_Shown.cpuStartTimes = m_InspectedTimes.cpuStartTimes.data();
+        m_Shown.cpuEndTimes = m_InspectedTimes.cpuEndTimes.data();
+        m_Shown.cpuElapsedTimes = m_InspectedTimes.cpuElapsedTimes.data();
+        m_Shown.counts = m_InspectedTimes.counts.data();
+    } else {
+        m_Shown.startTimes = m_Store.startTimes.data();
+        m_Shown.endTimes = m_Store.endTimes.data();
+        m_Shown.elapsedTimes = m_Store.elapsedTimes.data();
+        m_Shown.cpuStartTimes = m_Store.cpuStartTimes.data();
+        m_Shown.cpuEndTimes = m_Store.cpuEndTimes.data();
+        m_Shown.cpuElapsedTimes = m_Store.cpuElapsedTimes.data();
+        m_Shown.counts = m_Store.lastCounts.data();
+    }
+}
+
+void InAppGpuGLContext::m_DrawFrameHistory() {
+    ImGuiWindow* window = ImGui::GetCurrentWindow();
+    if (window->SkipItems || m_FrameHistoryCount == 0U) {
+        return;
+    }
+
+    if (m_IsFrameInspected && ImGui::BeginMenuBar()) {
+        ImGui::PushID(this);
+        ImGui::Separator();
+        ImGui::Text("Frame [%u]", (uint32_t)m_InspectedFrameId);
+        if (IAGP_IMGUI_BUTTON("Live")) {
+            m_IsFrameInspected = false;
+            m_UpdateShownTimes();
+        }
+        ImGui::PopID();
+        ImGui::EndMenuBar();
+    }
+
+    const ImGuiContext& g = *GImGui;
+    const ImGuiStyle& style = g.Style;
+    const float aw = ImGui::GetContentRegionAvail().x - style.FramePadding.x;
+    const ImVec2 pos = window->DC.CursorPos;
+    const ImVec2 size = ImVec2(aw, ImGui::GetFrameHeight() * 2.0f);
+    const ImRect bb(pos, pos + size);
+    ImGui::ItemSize(size);
+    const ImGuiID id = window->GetID(this);
+    if (!ImGui::ItemAdd(bb, id)) {
+        return;
+    }
+
+    const uint32_t first_idx = (m_FrameHistoryHead + IAGP_FRAME_HISTORY_COUNT - m_FrameHistoryCount) % IAGP_FRAME_HISTORY_COUNT;
+    double max_elapsed_time = 0.0;
+    for (uint32_t idx = 0U; idx < m_FrameHistoryCount; ++idx) {
+        const auto& frame = m_FrameHistory[(first_idx + idx) % IAGP_FRAME_HISTORY_COUNT];
+        max_elapsed_time = (frame.elapsedTime > max_elapsed_time) ? frame.elapsedTime : max_elapsed_time;
+    }
+    if (max_elapsed_time <= 0.0) {
+        return;  // avoid div by zero
+    }
+
+    // the newest frame is on the right, a bar per frame of the history
+    const float bar_width = size.x / (float)IAGP_FRAME_HISTORY_COUNT;
+    const bool is_hovered = ImGui::IsMouseHoveringRect(bb.Min, bb.Max);
+    int32_t hovered_frame = -1;
+    if (is_hovered) {
+        hovered_frame = (int32_t)m_FrameHistoryCount - 1 - (int32_t)((bb.Max.x - ImGui::GetMousePos().x) / bar_width);
+    }
+    ImGui::RenderFrame(bb.Min, bb.Max, ImGui::GetColorU32(ImGuiCol_FrameBg), true, style.FrameRounding);
+    for (uint32_t idx = 0U; idx < m_FrameHistoryCount; ++idx) {
+        const auto& frame = m_FrameHistory[(first_idx + idx) % IAGP_FRAME_HISTORY_COUNT];
+        const float x = bb.Max.x - (float)(m_FrameHistoryCount - idx) * bar_width;
+        const float h = size.y * (float)(frame.elapsedTime / max_elapsed_time);
+        ImGuiCol color = ImGuiCol_PlotHistogram;
+        if ((int32_t)idx == hovered_frame) {
+            color = ImGuiCol_PlotHistogramHovered;
+        } else if (m_IsFrameInspected && frame.frameId == m_InspectedFrameId) {
+            color = ImGuiCol_PlotLinesHovered;
+        }
+        window->DrawList->AddRectFilled(ImVec2(x, bb.Max.y - h), ImVec2(x + ImMax(bar_width - 1.0f, 1.0f), bb.Max.y), ImGui::GetColorU32(color));
+    }
+    if (hovered_frame >= 0) {
+        const auto& frame = m_FrameHistory[(first_idx + (uint32_t)hovered_frame) % IAGP_FRAME_HISTORY_COUNT];
+        ImGui::SetTooltip("Frame [%u] : %.5f ms\nLeft click for inspect the frame\nRight click for go back to the live frames",  //
+                          (uint32_t)frame.frameId, frame.elapsedTime);
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+            m_InspectFrame(frame);
+            m_UpdateShownTimes();
+        }
+    }
+    if (is_hovered && ImGui::IsMouseClicked(ImGuiMouseButton_Right)) {
+        m_IsFrameInspected = false;
+        m_UpdateShownTimes();
+    }
+}
+
+#ifdef IAGP_USE_COLLECTOR_THREAD
+void InAppGpuGLContext::m_PushFrameToCollector(const uint32_t vSlotIdx) {
+    auto& slot = m_FrameSlots[vSlotIdx];
+    const uint32_t records_count = (uint32_t)slot.records.size();
+    if (records_count == 0U) {
+        return;
+    }
+    // the query objects are not shared between contexts, but the buffers are
+    // so the gpu write the results in a buffer, the collector thread will read it
+    if (records_count > slot.resultsCapacity) {
+        slot.resultsCapacity = records_count;
+        InAppGpuBackend::ResizeResultsBuffer(slot.resultsBuffer, slot.resultsCapacity);
+        CheckGLErrors;
+    }
+    for (uint32_t idx = 0U; idx < records_count; ++idx) {
+        auto& record = slot.records[idx];
+        if (record.isEnd) {
+            record.count = m_Store.GetCurrentCount(record.zoneIdx, vSlotIdx);
+        }
+        InAppGpuBackend::ResolveResult(slot.resultsBuffer, record.queryId, idx);
+    }
+    CheckGLErrors;
+    slot.fence = InAppGpuBackend::InsertFence(slot.queries);
+    InAppGpuBackend::Flush();  // the collector thread cant flush the commands of this context, so the fence could be never signaled
+    CheckGLErrors;
 
-        if (pushed) {
-            ImGui::PopStyleColor();
-        }
+    frameToken token;
+    token.frameId = slot.frameId;
+    token.slotIdx = vSlotIdx;
+    token.generation = m_Generation;
+    slot.pending.store(true, std::memory_order_release);
+    if (!m_CollectorQueue.Push(token)) {  // cant happen, there is one token max per slot
+        slot.pending.store(false, std::memory_order_release);
+        m_ReleaseFrame(slot, false);
+    }
+}
 
-        if (ImGui::IsItemHovered()) {
-            m_Highlighted = true;
+bool InAppGpuGLContext::CollectFromThread() {
+    bool res = false;
+    frameToken token;
+    // the frames are retired in submission order, so we stop at the first not finished
+    while (m_CollectorQueue.Front(token)) {
+        auto& slot = m_FrameSlots[token.slotIdx];
+        if (!InAppGpuBackend::WaitFence(slot.queries, slot.fence, false, IAGP_COLLECTOR_WAIT_TIMEOUT)) {
+            break;
         }
-
-#ifdef IAGP_SHOW_COUNT
-        ImGui::TableNextColumn();  // Elapsed time
-        ImGui::Text("%u", last_count);
-#endif
-        ImGui::TableNextColumn();  // Elapsed time
-        ImGui::Text("%.5f ms", m_ElapsedTime);
-        ImGui::TableNextColumn();  // Max fps
-        if (m_ElapsedTime > 0.0f) {
-            ImGui::Text("%.2f f/s", 1000.0f / m_ElapsedTime);
-        } else {
-            ImGui::Text("%s", "Infinite");
-        }
-        ImGui::TableNextColumn();  // start time
-        ImGui::Text("%.5f ms", m_StartTime);
-        ImGui::TableNextColumn();  // end time
-        ImGui::Text("%.5f", m_EndTime);
-
-        if (res) {
-            m_Expanded = true;
-            ImGui::Indent();
-            for (const auto& zone : zonesOrdered) {
-                if (zone != nullptr && zone->m_ElapsedTime > 0.0) {
-                    zone->DrawDetails();
+        const uint32_t records_count = (uint32_t)slot.records.size();
+        m_CollectorResults.resize(records_count);
+        InAppGpuBackend::ReadResults(slot.resultsBuffer, slot.queries, records_count, m_CollectorResults.data());
+        CheckGLErrors;
+        {
+            // the ui can read the timings in same time
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (token.generation == m_Generation) {  // else the zones was cleared
+                const int64_t clock_offset = m_GetClockOffset(token.slotIdx, m_CollectorResults.data());
+                m_CollectedZones.clear();
+                for (uint32_t idx = 0U; idx < records_count; ++idx) {
+                    const auto& record = slot.records[idx];
+                    m_CollectRecord(record, m_CollectorResults[idx], token.slotIdx, clock_offset, record.count);
                 }
+                m_OnFrameCollected(token.frameId);
             }
-            ImGui::Unindent();
-        } else {
-            m_Expanded = false;
         }
+        m_ReleaseFrame(slot, true);
+        slot.pending.store(false, std::memory_order_release);
+        m_CollectorQueue.Pop();
+        res = true;
     }
+    return res;
 }
 
-bool InAppGpuQueryZone::DrawFlamGraph(InAppGpuGraphTypeEnum vGraphType, IAGPQueryZoneWeak& vOutSelectedQuery, IAGPQueryZoneWeak vParent,
-                                      uint32_t vDepth) {
-    ImGuiWindow* window = ImGui::GetCurrentWindow();
-    if (window->SkipItems) {
-        return false;
+void InAppGpuGLContext::ReleaseCollectorFrames() {
+    frameToken token;
+    while (m_CollectorQueue.Front(token)) {
+        auto& slot = m_FrameSlots[token.slotIdx];
+        m_ReleaseFrame(slot, false);
+        slot.pending.store(false, std::memory_order_release);
+        m_CollectorQueue.Pop();
     }
+}
+#endif  // IAGP_USE_COLLECTOR_THREAD
 
-    bool pressed = false;
-    switch (vGraphType) {
-        case InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL:  // horizontal flame graph (standard and legacy)
-            pressed = m_DrawHorizontalFlameGraph(m_This.lock(), vOutSelectedQuery, vParent, vDepth);
-            break;
-        case InAppGpuGraphTypeEnum::IN_APP_GPU_CIRCULAR:  // circular flame graph
-            pressed = m_DrawCircularFlameGraph(m_This.lock(), vOutSelectedQuery, vParent, vDepth);
-            break;
-        case InAppGpuGraphTypeEnum::IN_APP_GPU_Count:
-        default: break;
+void InAppGpuGLContext::m_SetQueryZoneForDepth(const uint32_t vZoneIdx, const uint32_t vDepth) {
+    if (vDepth >= m_DepthToLastZone.size()) {
+        m_DepthToLastZone.resize(vDepth + 1U, InAppGpuZoneStore::sInvalidIndex);
     }
-    return pressed;
+    m_DepthToLastZone[vDepth] = vZoneIdx;
 }
 
-void InAppGpuQueryZone::UpdateBreadCrumbTrail() {
-    if (parentPtr != nullptr) {
-        int32_t _depth = depth;
-        IAGPQueryZonePtr _parent_ptr = m_This.lock();
-        while (_parent_ptr != rootPtr) {
-            _parent_ptr = _parent_ptr->parentPtr;
-            if (_parent_ptr && _parent_ptr->depth == (_depth - 1U)) {
-                _depth = _parent_ptr->depth;
-                if (_depth < (int32_t)m_BreadCrumbTrail.size()) {
-                    m_BreadCrumbTrail[_depth] = _parent_ptr;
-                } else {
-                    DEBUG_BREAK;
-                    // maybe you need to define greater value for RECURSIVE_LEVELS_COUNT
-                    break;
-                }
-            }
-        }
+uint32_t InAppGpuGLContext::m_GetQueryZoneFromDepth(const uint32_t vDepth) {
+    if (vDepth < m_DepthToLastZone.size()) {  // found
+        return m_DepthToLastZone[vDepth];
+    }
+    return InAppGpuZoneStore::sInvalidIndex;
+}
 
-        // update the imgui title
-        imGuiTitle.clear();
-        for (GLuint idx = 0U; idx < depth; ++idx) {
-            if (idx < (GLuint)m_BreadCrumbTrail.size()) {
-                auto ptr = m_BreadCrumbTrail[idx].lock();
-                if (ptr != nullptr) {
-                    if (idx > 0U) {
-                        imGuiTitle += " > ";
-                    }
-                    imGuiTitle += ptr->name;
-                }
+void InAppGpuGLContext::m_UpdateBreadCrumbTrail(const uint32_t vZoneIdx) {
+    const uint32_t depth = m_Store.depths[vZoneIdx];
+    if (depth > 0U) {
+        // the parent count is done by current depth
+        std::array<uint32_t, IAGP_RECURSIVE_LEVELS_COUNT> trail;
+        for (uint32_t parent_idx = m_Store.parents[vZoneIdx]; parent_idx != InAppGpuZoneStore::sInvalidIndex;
+             parent_idx = m_Store.parents[parent_idx]) {
+            if (m_Store.depths[parent_idx] < (uint32_t)trail.size()) {
+                trail[m_Store.depths[parent_idx]] = parent_idx;
             } else {
                 DEBUG_BREAK;
                 // maybe you need to define greater value for RECURSIVE_LEVELS_COUNT
-                break;
             }
         }
+
+        // update the imgui title
+        auto& zone = m_Store.zones[vZoneIdx];
+        zone.imGuiTitle.clear();
+        for (uint32_t idx = 0U; idx < depth && idx < (uint32_t)trail.size(); ++idx) {
+            if (idx > 0U) {
+                zone.imGuiTitle += " > ";
+            }
+            zone.imGuiTitle += m_Store.zones[trail[idx]].name;
+        }
         // add the current
-        imGuiTitle += " > " + name;
+        zone.imGuiTitle += " > " + zone.name;
 
         // add the unicity string
-        imGuiTitle += "##InAppGpuQueryZone_ " + std::to_string((intptr_t)this);
+        zone.imGuiTitle += "##InAppGpuQueryZone_" + std::to_string((intptr_t)this) + "_" + std::to_string(vZoneIdx);
     }
+    auto& zone = m_Store.zones[vZoneIdx];
+    zone.imGuiLabel = zone.name + "##InAppGpuQueryZone_" + std::to_string((intptr_t)this) + "_" + std::to_string(vZoneIdx);
 }
 
-void InAppGpuQueryZone::DrawBreadCrumbTrail(IAGPQueryZoneWeak& vOutSelectedQuery) {
+void InAppGpuGLContext::m_DrawBreadCrumbTrail(const uint32_t vZoneIdx, uint32_t& vOutSelectedZone) {
     if (ImGui::BeginMenuBar()) {
         ImGui::Separator();
         ImGui::PushID("DrawBreadCrumbTrail");
-        for (GLuint idx = 0U; idx < depth; ++idx) {
-            if (idx < m_BreadCrumbTrail.size()) {
-                auto ptr = m_BreadCrumbTrail[idx].lock();
-                if (ptr != nullptr) {
-                    if (idx > 0U) {
-                        ImGui::Text("%s", ">");
-                    }
-                    ImGui::PushID(ptr.get());
-                    if (IAGP_IMGUI_BUTTON(ptr->imGuiLabel.c_str())) {
-                        vOutSelectedQuery = m_BreadCrumbTrail[idx];
-                    }
-                    ImGui::PopID();
+        const uint32_t depth = m_Store.depths[vZoneIdx];
+        std::array<uint32_t, IAGP_RECURSIVE_LEVELS_COUNT> trail;
+        for (uint32_t parent_idx = m_Store.parents[vZoneIdx]; parent_idx != InAppGpuZoneStore::sInvalidIndex;
+             parent_idx = m_Store.parents[parent_idx]) {
+            if (m_Store.depths[parent_idx] < (uint32_t)trail.size()) {
+                trail[m_Store.depths[parent_idx]] = parent_idx;
+            }
+        }
+        for (uint32_t idx = 0U; idx < depth; ++idx) {
+            if (idx < (uint32_t)trail.size()) {
+                if (idx > 0U) {
+                    ImGui::Text("%s", ">");
                 }
+                ImGui::PushID((int)trail[idx]);
+                if (IAGP_IMGUI_BUTTON(m_Store.zones[trail[idx]].imGuiLabel.c_str())) {
+                    vOutSelectedZone = trail[idx];
+                }
+                ImGui::PopID();
             } else {
                 DEBUG_BREAK;
                 // maybe you need to define greater value for RECURSIVE_LEVELS_COUNT
@@ -445,454 +2491,1016 @@ void InAppGpuQueryZone::DrawBreadCrumbTrail(IAGPQueryZoneWeak& vOutSelectedQuery
             }
         }
         if (depth > 0) {
-            ImGui::Text("> %s", name.c_str());
+            ImGui::Text("> %s", m_Store.zones[vZoneIdx].name.c_str());
         }
         ImGui::PopID();
         ImGui::EndMenuBar();
     }
 }
 
-void InAppGpuQueryZone::m_DrawList_DrawBar(const char* vLabel, const ImRect& vRect, const ImVec4& vColor, const bool vHovered) {
+// the rows are rebuilt when the tree, the expanded zones, or the zones with a time to show change.
+// when sorted by a time, they are sorted again when a frame was collected, at most each IAGP_DETAILS_SORT_PERIOD ms
+// the shown zones are updated by Collect, so nothing here depend of the count of zones, except for an inspected frame
+void InAppGpuGLContext::m_UpdateDetailsRows(const InAppGpuDetailsColumnEnum& vSortColumn, const bool vSortDescending) {
+    const uint32_t zones_count = m_Store.size();
+    bool dirty = m_DetailsDirty || vSortColumn != m_DetailsSortColumn || vSortDescending != m_DetailsSortDescending;
+    const double time = ImGui::GetTime();
+    if (vSortColumn != InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_TREE && m_DetailsTimesChanged &&  //
+        (time - m_DetailsSortTime) * 1000.0 >= (double)IAGP_DETAILS_SORT_PERIOD) {
+        dirty = true;
+    }
+    m_DetailsShownZones.resize(zones_count, 0U);  // the new zones are shown when collected
+    if (m_IsFrameInspected || m_DetailsShownInspected) {
+        // the times of an inspected frame are not the ones of Collect, so the shown zones are computed when it change
+        if (m_IsFrameInspected != m_DetailsShownInspected || m_InspectedFrameId != m_DetailsShownFrameId) {
+            m_DetailsShownInspected = m_IsFrameInspected;
+            m_DetailsShownFrameId = m_InspectedFrameId;
+            for (uint32_t idx = 0U; idx < zones_count; ++idx) {
+                m_DetailsShownZones[idx] = m_IsDetailsZoneShown(idx, m_Shown.elapsedTimes);
+            }
+            dirty = true;
+        }
+    }
+    if (dirty) {
+        m_DetailsDirty = false;
+        m_DetailsTimesChanged = false;
+        m_DetailsSortTime = time;
+        m_DetailsSortColumn = vSortColumn;
+        m_DetailsSortDescending = vSortDescending;
+        m_DetailsRows.clear();
+        m_DetailsChilds.clear();
+        if (m_DetailsSortColumn != InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_TREE) {
+            m_DetailsSortValues.resize(zones_count);
+        }
+        if (zones_count > 0U && m_DetailsShownZones[0]) {
+            m_AddDetailsRows(0U, 0U);
+        }
+    }
+}
+
+// called under the lock for each collected or replayed frame, the cost is the count of zones of the frame
+void InAppGpuGLContext::m_UpdateDetailsShownZones(const std::vector<InAppGpuCollectedZone>& vZones) {
+    m_DetailsTimesChanged = true;
+    if (m_DetailsShownInspected) {
+        return;  // the rows show an inspected frame, they will be computed again at the return to live
+    }
+    m_DetailsShownZones.resize(m_Store.size(), 0U);
+    for (const auto& zone : vZones) {
+        const uint32_t idx = zone.zoneIdx;
+        if (idx < m_DetailsShownZones.size()) {
+            const uint8_t shown = m_IsDetailsZoneShown(idx, m_Store.elapsedTimes.data());
+            if (shown != m_DetailsShownZones[idx]) {
+                m_DetailsShownZones[idx] = shown;
+                m_DetailsDirty = true;
+            }
+        }
+    }
+}
+
+// the root is shown as soon as started, the childs only with a time
+uint8_t InAppGpuGLContext::m_IsDetailsZoneShown(const uint32_t vZoneIdx, const double* vElapsedTimes) const {
+    return (m_Store.startFrameIds[vZoneIdx] != 0U && (vZoneIdx == 0U || vElapsedTimes[vZoneIdx] > 0.0)) ? 1U : 0U;
+}
+
+// the childs are added at the end of m_DetailsChilds, and removed when the zone is done
+// so the recursion share the same vector
+void InAppGpuGLContext::m_AddDetailsRows(const uint32_t vZoneIdx, const uint32_t vDepth) {
+    const size_t first_child = m_DetailsChilds.size();
+    for (uint32_t idx = m_Store.firstChilds[vZoneIdx]; idx != InAppGpuZoneStore::sInvalidIndex; idx = m_Store.nextSiblings[idx]) {
+        if (m_DetailsShownZones[idx]) {
+            m_DetailsChilds.push_back(idx);
+        }
+    }
+    const size_t last_child = m_DetailsChilds.size();
+    detailsRow row;
+    row.zoneIdx = vZoneIdx;
+    row.depth = vDepth;
+    row.hasChilds = (last_child > first_child);
+    m_DetailsRows.push_back(row);
+    if (row.hasChilds && m_Store.zones[vZoneIdx].expanded) {
+        if (m_DetailsSortColumn != InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_TREE) {
+            // the siblings are sorted, the tree is kept
+            for (size_t i = first_child; i < last_child; ++i) {
+                m_DetailsSortValues[m_DetailsChilds[i]] = m_GetDetailsValue(m_DetailsChilds[i], m_DetailsSortColumn);
+            }
+            const auto& values = m_DetailsSortValues;
+            const bool descending = m_DetailsSortDescending;
+            std::stable_sort(m_DetailsChilds.begin() + first_child, m_DetailsChilds.begin() + last_child,  //
+                             [&values, descending](const uint32_t vA, const uint32_t vB) {
+                                 return descending ? (values[vA] > values[vB]) : (values[vA] < values[vB]);
+                             });
+        }
+        for (size_t i = first_child; i < last_child; ++i) {
+            m_AddDetailsRows(m_DetailsChilds[i], vDepth + 1U);
+        }
+    }
+    m_DetailsChilds.resize(first_child);
+}
+
+double InAppGpuGLContext::m_GetDetailsValue(const uint32_t vZoneIdx, const InAppGpuDetailsColumnEnum& vColumn) const {
+    const auto& histogram = m_Store.zones[vZoneIdx].histogram;
+    switch (vColumn) {
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_COUNT: return (double)m_Shown.counts[vZoneIdx];
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_GPU_TIME: return m_Shown.elapsedTimes[vZoneIdx];
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_CPU_TIME: return m_Shown.cpuElapsedTimes[vZoneIdx];
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_GPU_MIN: return (double)histogram.GetMin();
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_GPU_P50: return (double)histogram.GetPercentile(0.50);
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_GPU_P95: return (double)histogram.GetPercentile(0.95);
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_GPU_P99: return (double)histogram.GetPercentile(0.99);
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_GPU_MAX: return (double)histogram.GetMax();
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_MAX_FPS:  // the less time, the more fps
+            return (m_Shown.elapsedTimes[vZoneIdx] > 0.0) ? 1000.0 / m_Shown.elapsedTimes[vZoneIdx] : DBL_MAX;
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_START_TIME: return m_Shown.startTimes[vZoneIdx];
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_END_TIME: return m_Shown.endTimes[vZoneIdx];
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_CALLS: return (double)m_Store.lastCounts[vZoneIdx];
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_CALL_MIN: return (double)m_Store.zones[vZoneIdx].invocationMinTime;
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_CALL_MEAN:
+            return (m_Store.lastCounts[vZoneIdx] > 0U) ? (double)m_Store.zones[vZoneIdx].invocationSumTime / m_Store.lastCounts[vZoneIdx] : 0.0;
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_CALL_MAX: return (double)m_Store.zones[vZoneIdx].invocationMaxTime;
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_TREE:
+        case InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_Count:
+        default: break;
+    }
+    return 0.0;
+}
+
+void InAppGpuGLContext::m_DrawDetailsRow(const detailsRow& vRow) {
+    const uint32_t zone_idx = vRow.zoneIdx;
+    auto& zone = m_Store.zones[zone_idx];
+
+    ImGui::TableNextColumn();  // tree
+
+    ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_CollapsingHeader;
+    if (!vRow.hasChilds) {
+        flags |= ImGuiTreeNodeFlags_Leaf;
+    }
+
+    if (zone.highlighted) {
+        flags |= ImGuiTreeNodeFlags_Framed;
+    }
+
+    const auto& cv4 = zone.cv4;
+    const auto colorU32 = ImGui::ColorConvertFloat4ToU32(cv4);
+    const bool pushed = PushStyleColorWithContrast(colorU32, ImGuiCol_Text, ImVec4(0, 0, 0, 1), InAppGpuQueryZone::sContrastRatio);
+
+    ImGui::PushStyleColor(ImGuiCol_Header, cv4);
+    const auto hovered_color = ImVec4(cv4.x * 0.9f, cv4.y * 0.9f, cv4.z * 0.9f, 1.0f);
+    const auto active_color = ImVec4(cv4.x * 0.8f, cv4.y * 0.8f, cv4.z * 0.8f, 1.0f);
+    ImGui::PushStyleColor(ImGuiCol_HeaderHovered, hovered_color);
+    ImGui::PushStyleColor(ImGuiCol_HeaderActive, active_color);
+
+    // the rows are not nested anymore, so the indent is done by row
+    // and the open state is the one of the zone, the rows depend of it
+    const float indent = ImGui::GetStyle().IndentSpacing * (float)vRow.depth;
+    if (indent > 0.0f) {
+        ImGui::Indent(indent);
+    }
+    ImGui::SetNextItemOpen(zone.expanded);
+    bool res = false;
+    const void* tree_id = (const void*)(intptr_t)zone_idx;
+    if (zone.isRoot) {
+        res = ImGui::TreeNodeEx(tree_id, flags, "%s : frame [%u]", zone.name.c_str(), m_Store.startFrameIds[zone_idx] - 1U);
+    } else if (!zone.sectionName.empty()) {
+        res = ImGui::TreeNodeEx(tree_id, flags, "%s : %s", zone.sectionName.c_str(), zone.name.c_str());
+    } else {
+        res = ImGui::TreeNodeEx(tree_id, flags, "%s", zone.name.c_str());
+    }
+    if (indent > 0.0f) {
+        ImGui::Unindent(indent);
+    }
+
+    ImGui::PopStyleColor(3);
+
+    if (pushed) {
+        ImGui::PopStyleColor();
+    }
+
+    if (ImGui::IsItemHovered()) {
+        zone.highlighted = true;
+    }
+
+    if (vRow.hasChilds && res != zone.expanded) {
+        zone.expanded = res;
+        m_DetailsDirty = true;  // the rows will be rebuilt at the next frame
+    }
+
+    const double elapsed_time = m_Shown.elapsedTimes[zone_idx];
+#ifdef IAGP_SHOW_COUNT
+    ImGui::TableNextColumn();  // Elapsed time
+    ImGui::Text("%u", m_Shown.counts[zone_idx]);
+#endif
+    ImGui::TableNextColumn();  // Gpu time
+    ImGui::Text("%.5f ms", elapsed_time);
+    ImGui::TableNextColumn();  // Cpu time
+    ImGui::Text("%.5f ms", m_Shown.cpuElapsedTimes[zone_idx]);
+    const auto& histogram = m_Store.zones[zone_idx].histogram;
+    const auto percentiles = histogram.GetPercentiles();
+    ImGui::TableNextColumn();  // Gpu min
+    ImGui::Text("%.5f ms", histogram.GetMin() * 1e-6);
+    ImGui::TableNextColumn();  // Gpu p50
+    ImGui::Text("%.5f ms", percentiles.p50 * 1e-6);
+    ImGui::TableNextColumn();  // Gpu p95
+    ImGui::Text("%.5f ms", percentiles.p95 * 1e-6);
+    ImGui::TableNextColumn();  // Gpu p99
+    ImGui::Text("%.5f ms", percentiles.p99 * 1e-6);
+    ImGui::TableNextColumn();  // Gpu max
+    ImGui::Text("%.5f ms", histogram.GetMax() * 1e-6);
+    ImGui::TableNextColumn();  // Max fps
+    if (elapsed_time > 0.0f) {
+        ImGui::Text("%.2f f/s", 1000.0f / elapsed_time);
+    } else {
+        ImGui::Text("%s", "Infinite");
+    }
+    ImGui::TableNextColumn();  // start time
+    ImGui::Text("%.5f ms", m_Shown.startTimes[zone_idx]);
+    ImGui::TableNextColumn();  // end time
+    ImGui::Text("%.5f", m_Shown.endTimes[zone_idx]);
+    // the calls of the last frame, the elapsed time go from the first to the last
+    const GLuint calls_count = m_Store.lastCounts[zone_idx];
+    ImGui::TableNextColumn();  // Calls
+    ImGui::Text("%u", calls_count);
+    ImGui::TableNextColumn();  // Call min
+    ImGui::Text("%.5f ms", m_Store.zones[zone_idx].invocationMinTime * 1e-6);
+    ImGui::TableNextColumn();  // Call mean
+    ImGui::Text("%.5f ms", (calls_count > 0U) ? m_Store.zones[zone_idx].invocationSumTime * 1e-6 / calls_count : 0.0);
+    ImGui::TableNextColumn();  // Call max
+    ImGui::Text("%.5f ms", m_Store.zones[zone_idx].invocationMaxTime * 1e-6);
+}
+
+// the label size is given by the caller, who cache it
+// a null label draw only the frame of the bar
+void InAppGpuGLContext::m_DrawList_DrawBar(const char* vLabel, const ImVec2& vLabelSize, const ImRect& vRect, const ImVec4& vColor, const bool vHovered) {
     const ImGuiContext& g = *GImGui;
     ImGuiWindow* window = g.CurrentWindow;
     const ImGuiStyle& style = g.Style;
-    const ImVec2 label_size = ImGui::CalcTextSize(vLabel, nullptr, true);
 
     const auto colorU32 = ImGui::ColorConvertFloat4ToU32(vColor);
     ImGui::PushStyleVar(ImGuiStyleVar_FrameBorderSize, 1.0f);
     ImGui::RenderFrame(vRect.Min, vRect.Max, colorU32, true, 2.0f);
     if (vHovered) {
-        const auto selectU32 = ImGui::ColorConvertFloat4ToU32(ImVec4(1.0f - cv4.x, 1.0f - cv4.y, 1.0f - cv4.z, 1.0f));
+        const auto selectU32 = ImGui::ColorConvertFloat4ToU32(ImVec4(1.0f - vColor.x, 1.0f - vColor.y, 1.0f - vColor.z, 1.0f));
         window->DrawList->AddRect(vRect.Min, vRect.Max, selectU32, true, 0, 2.0f);
     }
     ImGui::PopStyleVar();
 
+    if (vLabel == nullptr) {
+        return;
+    }
     const bool pushed = PushStyleColorWithContrast(colorU32, ImGuiCol_Text, ImVec4(0, 0, 0, 1), InAppGpuQueryZone::sContrastRatio);
     ImGui::RenderTextClipped(vRect.Min + style.FramePadding, vRect.Max - style.FramePadding,  //
-                             vLabel, nullptr, &label_size, ImVec2(0.5f, 0.5f), &vRect);
+                             vLabel, nullptr, &vLabelSize, ImVec2(0.5f, 0.5f), &vRect);
     if (pushed) {
         ImGui::PopStyleColor();
     }
 }
 
-bool InAppGpuQueryZone::m_ComputeRatios(IAGPQueryZonePtr vRoot, IAGPQueryZoneWeak vParent, uint32_t vDepth, float& vOutStartRatio,
+bool InAppGpuGLContext::m_ComputeRatios(const uint32_t vZoneIdx, const uint32_t vRootIdx, const uint32_t vParentIdx, float& vOutStartRatio,
                                         float& vOutSizeRatio) {
-    if (depth > InAppGpuQueryZone::sMaxDepthToOpen) {
+    if (m_Store.depths[vZoneIdx] > InAppGpuQueryZone::sMaxDepthToOpen) {
         return false;
     }
-    if (vRoot == nullptr) {
-        vRoot = m_This.lock();
-    }
-    if (vParent.expired()) {
-        vParent = m_This;
-    }
-    if (vRoot != nullptr && vRoot->m_ElapsedTime > 0.0) {  // avoid div by zero
-        if (vDepth == 0) {
+    auto& zone = m_Store.zones[vZoneIdx];
+    const double root_elapsed_time = m_Shown.elapsedTimes[vRootIdx];
+    if (root_elapsed_time > 0.0) {  // avoid div by zero
+        // the color is relative to the frame (the root of the tree)
+        const double frame_elapsed_time = m_Shown.elapsedTimes[0];
+        if (vZoneIdx == vRootIdx) {
             vOutStartRatio = 0.0f;
             vOutSizeRatio = 1.0f;
-            if (rootPtr == nullptr) {
-                hsv = ImVec4((float)(0.5 - 0.5 * m_ElapsedTime / vRoot->m_ElapsedTime), 0.5f, 1.0f, 1.0f);
-            } else {
-                hsv = ImVec4((float)(0.5 - 0.5 * m_ElapsedTime / rootPtr->m_ElapsedTime), 0.5f, 1.0f, 1.0f);
-            }
-        } else {
-            auto parent_ptr = vParent.lock();
-            if (parent_ptr) {
-                if (parent_ptr->m_ElapsedTime > 0.0) {  // avoid div by zero
-
-                    ////////////////////////////////////////////////////////
-                    // for correct rounding isssue with average values
-                    if (parent_ptr->m_StartTime > m_StartTime) {
-                        m_StartTime = parent_ptr->m_StartTime;
-                    }
-                    if (parent_ptr->m_EndTime < m_EndTime) {
-                        m_EndTime = parent_ptr->m_EndTime;
-                    }
-                    if (m_EndTime < m_StartTime) {
-                        m_EndTime = m_StartTime;
-                    }
-                    m_ElapsedTime = m_EndTime - m_StartTime;
-                    if (m_ElapsedTime < 0.0) {
-                        DEBUG_BREAK;
-                    }
-                    if (m_ElapsedTime > parent_ptr->m_ElapsedTime) {
-                        m_ElapsedTime = parent_ptr->m_ElapsedTime;
-                    }
-                    ////////////////////////////////////////////////////////
-
-                    vOutStartRatio = (float)((m_StartTime - vRoot->m_StartTime) / vRoot->m_ElapsedTime);
-                    vOutSizeRatio = (float)(m_ElapsedTime / vRoot->m_ElapsedTime);
-                    if (rootPtr == nullptr) {
-                        hsv = ImVec4((float)(0.5 - 0.5 * m_ElapsedTime / vRoot->m_ElapsedTime), 0.5f, 1.0f, 1.0f);
-                    } else {
-                        hsv = ImVec4((float)(0.5 - 0.5 * m_ElapsedTime / rootPtr->m_ElapsedTime), 0.5f, 1.0f, 1.0f);
-                    }
-                }
-            }
+            zone.hsv = ImVec4((float)(0.5 - 0.5 * m_Shown.elapsedTimes[vZoneIdx] / frame_elapsed_time), 0.5f, 1.0f, 1.0f);
+        } else if (m_Shown.elapsedTimes[vParentIdx] > 0.0) {  // avoid div by zero
+            // the mean and the ema keep the childs in their parent, not the median
+            // so the bar is only clamped for the drawing
+            const double start_time = ImMax(m_Shown.startTimes[vZoneIdx], m_Shown.startTimes[vParentIdx]);
+            const double end_time = ImMax(ImMin(m_Shown.endTimes[vZoneIdx], m_Shown.endTimes[vParentIdx]), start_time);
+            const double elapsed_time = end_time - start_time;
+            vOutStartRatio = (float)((start_time - m_Shown.startTimes[vRootIdx]) / root_elapsed_time);
+            vOutSizeRatio = (float)(elapsed_time / root_elapsed_time);
+            zone.hsv = ImVec4((float)(0.5 - 0.5 * elapsed_time / frame_elapsed_time), 0.5f, 1.0f, 1.0f);
         }
         return true;
     }
     return false;
 }
 
-bool InAppGpuQueryZone::m_DrawHorizontalFlameGraph(IAGPQueryZonePtr vRoot, IAGPQueryZoneWeak& vOutSelectedQuery, IAGPQueryZoneWeak vParent,
-                                                   uint32_t vDepth) {
+bool InAppGpuGLContext::m_DrawHorizontalFlameGraph(const uint32_t vRootIdx, uint32_t& vOutSelectedZone) {
     bool pressed = false;
     const ImGuiContext& g = *GImGui;
     const ImGuiStyle& style = g.Style;
     const float aw = ImGui::GetContentRegionAvail().x - style.FramePadding.x;
     ImGuiWindow* window = ImGui::GetCurrentWindow();
-    float barStartRatio = 0.0f;
-    float barSizeRatio = 0.0f;
-    if (m_ComputeRatios(vRoot, vParent, vDepth, barStartRatio, barSizeRatio)) {
-        if (barSizeRatio > 0.0f) {
-            if ((zonesOrdered.empty() && InAppGpuQueryZone::sShowLeafMode) || !InAppGpuQueryZone::sShowLeafMode) {
-                ImGui::PushID(this);
-                m_BarLabel = toStr("%s (%.2f ms | %.2f f/s)", name.c_str(), m_ElapsedTime, 1000.0f / m_ElapsedTime);
-                const char* label = m_BarLabel.c_str();
-                const ImGuiID id = window->GetID(label);
+
+    // the cpu and gpu tracks share the same time range, so the submission and the execution are aligned
+    const bool show_cpu_track = InAppGpuQueryZone::sShowCpuTrack && m_Shown.cpuElapsedTimes[vRootIdx] > 0.0;
+    double range_start = m_Shown.startTimes[vRootIdx];
+    double range_end = m_Shown.endTimes[vRootIdx];
+    if (show_cpu_track) {
+        range_start = (m_Shown.cpuStartTimes[vRootIdx] < range_start) ? m_Shown.cpuStartTimes[vRootIdx] : range_start;
+        range_end = (m_Shown.cpuEndTimes[vRootIdx] > range_end) ? m_Shown.cpuEndTimes[vRootIdx] : range_end;
+    }
+    const double range_length = (range_end > range_start) ? (range_end - range_start) : 1.0;  // avoid div by zero
+    // the ratios of the gpu bars are relative to the root zone
+    const float gpu_offset = (float)((m_Shown.startTimes[vRootIdx] - range_start) / range_length);
+    const float gpu_scale = (float)(m_Shown.elapsedTimes[vRootIdx] / range_length);
+    const int32_t cpu_rows_offset = (int32_t)(m_MaxDepth + 1U);  // the cpu track is under the gpu track
+
+    const float height = ImGui::GetTextLineHeight() + style.FramePadding.y * 2.0f;
+    const ImVec2 origin = window->DC.CursorPos;
+
+    // with the lod, the bars smaller than sLodMinBarWidth are merged with their neighbours of the same row in one block,
+    // and the childs of a merged bar are not shown since they are smaller.
+    // the labels are not computed when they can't be shown in the bar
+    const bool use_lod = InAppGpuQueryZone::sUseLod;
+    const float lod_min_width = InAppGpuQueryZone::sLodMinBarWidth;
+    const float label_min_width = ImGui::CalcTextSize("...").x + style.FramePadding.x * 2.0f;
+    const ImVec4 lod_color = ImVec4(0.5f, 0.5f, 0.5f, 1.0f);
+    m_LodBlocks.assign((size_t)cpu_rows_offset * 2U, InAppGpuLodBlock());
+    const auto draw_block = [&](const int32_t vRow) {
+        auto& block = m_LodBlocks[vRow];
+        if (block.count > 0U) {
+            const ImVec2 block_pos = origin + ImVec2(block.start + style.FramePadding.x, vRow * height + style.FramePadding.y);
+            const ImRect block_bb(block_pos, block_pos + ImVec2(ImMax(block.end - block.start, 1.0f), height));
+            if (ImGui::IsRectVisible(block_bb.Min, block_bb.Max)) {
+                const bool block_hovered = ImGui::IsMouseHoveringRect(block_bb.Min, block_bb.Max) && ImGui::IsWindowHovered();
+                if (block_hovered) {
+                    ImGui::SetTooltip("%u zones too small to be shown\nElapsed time : %.5f ms", block.count, block.time);
+                }
+                const bool show_dots = (block_bb.GetWidth() >= label_min_width);
+                m_DrawList_DrawBar(show_dots ? "..." : nullptr, ImGui::CalcTextSize("..."), block_bb, lod_color, block_hovered);
+            }
+            block = InAppGpuLodBlock();
+        }
+    };
+    const auto add_to_block = [&](const int32_t vRow, const float vStart, const float vSize, const double vTime) {
+        // the rows are scanned in the order of the store, not in x
+        if (!m_LodBlocks[vRow].IsContiguous(vStart, vSize)) {
+            draw_block(vRow);
+        }
+        m_LodBlocks[vRow].Add(vStart, vSize, vTime);
+    };
+
+    // a parent is always before its childs in the store
+    // so one scan give the row of each zone from the row of its parent
+    const uint32_t zones_count = m_Store.size();
+    m_DrawRows.assign(zones_count, -1);  // -1 for the zones not shown
+    for (uint32_t idx = vRootIdx; idx < zones_count; ++idx) {
+        int32_t row = 0;
+        uint32_t parent_idx = vRootIdx;
+        if (idx != vRootIdx) {
+            parent_idx = m_Store.parents[idx];
+            if (parent_idx == InAppGpuZoneStore::sInvalidIndex || m_DrawRows[parent_idx] < 0) {
+                continue;  // not in the shown tree
+            }
+            row = m_DrawRows[parent_idx];
+        }
+        float barStartRatio = 0.0f;
+        float barSizeRatio = 0.0f;
+        // we dont show child if this one have elapsed time to 0.0
+        if (!m_ComputeRatios(idx, vRootIdx, parent_idx, barStartRatio, barSizeRatio) || barSizeRatio <= 0.0f) {
+#ifdef IAGP_DEBUG_MODE_LOGGING
+            IAGP_DEBUG_MODE_LOGGING("Bar Ms not displayed : %s", m_Store.zones[idx].name.c_str());
+#endif
+            continue;
+        }
+        const bool is_leaf = (m_Store.firstChilds[idx] == InAppGpuZoneStore::sInvalidIndex);
+        if ((is_leaf && InAppGpuQueryZone::sShowLeafMode) || !InAppGpuQueryZone::sShowLeafMode) {
+            auto& zone = m_Store.zones[idx];
+            const double elapsed_time = m_Shown.elapsedTimes[idx];
+            const double cpu_elapsed_time = m_Shown.cpuElapsedTimes[idx];
+            const bool has_cpu_bar = show_cpu_track && cpu_elapsed_time > 0.0;
+            const float bar_start = aw * (gpu_offset + barStartRatio * gpu_scale);
+            const float bar_size = aw * barSizeRatio * gpu_scale;
+            const float cpu_start = aw * (float)((m_Shown.cpuStartTimes[idx] - range_start) / range_length);
+            const float cpu_size = aw * (float)(cpu_elapsed_time / range_length);
+            if (use_lod && row < cpu_rows_offset && bar_size < lod_min_width) {
+                // the zone and its childs are merged, m_DrawRows[idx] stay to -1
+                add_to_block(row, bar_start, bar_size, elapsed_time);
+                if (has_cpu_bar) {
+                    add_to_block(row + cpu_rows_offset, cpu_start, cpu_size, cpu_elapsed_time);
+                }
+                continue;
+            }
+            const ImVec2 pos = origin + ImVec2(bar_start + style.FramePadding.x, row * height + style.FramePadding.y);
+            const ImRect bb(pos, pos + ImVec2(bar_size, height));
+            bool hovered = false;
+            if (!use_lod || ImGui::IsRectVisible(bb.Min, bb.Max)) {
+                ImGui::PushID((int)idx);
+                const ImGuiID id = window->GetID("gpu");
                 ImGui::PopID();
-                float bar_start = aw * barStartRatio;
-                float bar_size = aw * barSizeRatio;
-                const ImVec2 label_size = ImGui::CalcTextSize(label, nullptr, true);
-                const float height = label_size.y + style.FramePadding.y * 2.0f;
-                const ImVec2 bPos = ImVec2(bar_start + style.FramePadding.x, vDepth * height + style.FramePadding.y);
-                const ImVec2 pos = window->DC.CursorPos + bPos;
-                const ImVec2 size = ImVec2(bar_size, height);
-                const ImRect bb(pos, pos + size);
-                bool hovered, held;
-                pressed =
+                bool held;
+                const bool bar_pressed =
                     ImGui::ButtonBehavior(bb, id, &hovered, &held,  //
                                           ImGuiButtonFlags_PressedOnClick | ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonRight);
-                if (pressed) {
+                if (bar_pressed) {
                     if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
-                        vOutSelectedQuery = m_This;  // open in the main window
-                    } else if (ImGui::IsMouseClicked(ImGuiMouseButton_Right) && rootPtr != nullptr) {
-                        sTabbedQueryZones.push_back(m_This);  // open new window
+                        vOutSelectedZone = idx;  // open in the main window
+                    } else if (ImGui::IsMouseClicked(ImGuiMouseButton_Right) && m_Store.depths[idx] > 0U) {
+                        InAppGpuProfiler::Instance()->OpenTabbedQueryZone(m_This, idx);  // open new window
                     }
                 }
-                m_Highlighted = false;
+                pressed |= bar_pressed;
+                const bool highlighted = zone.highlighted;
+                zone.highlighted = false;
                 if (hovered) {
-                    ImGui::SetTooltip("Section : [%s : %s]\nElapsed time : %.5f ms\nElapsed FPS : %.5f f/s",  //
-                                      m_SectionName.c_str(), name.c_str(), m_ElapsedTime, 1000.0f / m_ElapsedTime);
-                    m_Highlighted = true;  // to highlight label graph by this button
-                } else if (m_Highlighted) {
+                    m_DrawZoneTooltip(idx);
+                    zone.highlighted = true;  // to highlight label graph by this button
+                } else if (highlighted) {
                     hovered = true;  // highlight this button by the label graph
                 }
-                ImGui::ColorConvertHSVtoRGB(hsv.x, hsv.y, hsv.z, cv4.x, cv4.y, cv4.z);
-                cv4.w = 1.0f;
+                ImGui::ColorConvertHSVtoRGB(zone.hsv.x, zone.hsv.y, zone.hsv.z, zone.cv4.x, zone.cv4.y, zone.cv4.z);
+                zone.cv4.w = 1.0f;
                 ImGui::RenderNavHighlight(bb, id);
-                m_DrawList_DrawBar(label, bb, cv4, hovered);
-                ++vDepth;
+                const bool show_label = !use_lod || bar_size >= label_min_width;
+                if (show_label) {
+                    // the label is only rebuilt when the shown time change
+                    const int64_t label_key = (int64_t)std::llround(elapsed_time * 100.0);
+                    if (label_key != zone.barLabelKey) {
+                        const double label_time = (double)label_key * 0.01;
+                        zone.barLabelKey = label_key;
+                        zone.barLabel = toStr("%s (%.2f ms | %.2f f/s)", zone.name.c_str(), label_time, 1000.0 / label_time);
+                        zone.barLabelSize = ImGui::CalcTextSize(zone.barLabel.c_str(), nullptr, true);
+                    }
+                }
+                m_DrawList_DrawBar(show_label ? zone.barLabel.c_str() : nullptr, zone.barLabelSize, bb, zone.cv4, hovered);
             }
-
-            // we dont show child if this one have elapsed time to 0.0
-            for (const auto& zone : zonesOrdered) {
-                if (zone != nullptr) {
-                    pressed |= zone->m_DrawHorizontalFlameGraph(vRoot, vOutSelectedQuery, m_This, vDepth);
+            if (has_cpu_bar) {
+                const int32_t cpu_row = row + cpu_rows_offset;
+                if (use_lod && cpu_size < lod_min_width) {
+                    add_to_block(cpu_row, cpu_start, cpu_size, cpu_elapsed_time);
+                } else {
+                    const ImVec2 cpu_pos = origin + ImVec2(cpu_start + style.FramePadding.x, cpu_row * height + style.FramePadding.y);
+                    const ImRect cpu_bb(cpu_pos, cpu_pos + ImVec2(cpu_size, height));
+                    if (!use_lod || ImGui::IsRectVisible(cpu_bb.Min, cpu_bb.Max)) {
+                        ImGui::PushID((int)idx);
+                        const ImGuiID cpu_id = window->GetID("cpu");
+                        ImGui::PopID();
+                        bool cpu_hovered, cpu_held;
+                        if (ImGui::ButtonBehavior(cpu_bb, cpu_id, &cpu_hovered, &cpu_held, ImGuiButtonFlags_PressedOnClick | ImGuiButtonFlags_MouseButtonLeft)) {
+                            vOutSelectedZone = idx;  // open in the main window
+                            pressed = true;
+                        }
+                        if (cpu_hovered) {
+                            // the latency is the time the gpu wait before executing what the cpu have submitted
+                            ImGui::SetTooltip("Section : [%s : %s]\nCpu time : %.5f ms\nGpu time : %.5f ms\nGpu latency : %.5f ms",  //
+                                              zone.sectionName.c_str(), zone.name.c_str(), cpu_elapsed_time, elapsed_time,
+                                              m_Shown.startTimes[idx] - m_Shown.cpuStartTimes[idx]);
+                            zone.highlighted = true;
+                        }
+                        const bool show_cpu_label = !use_lod || cpu_size >= label_min_width;
+                        if (show_cpu_label) {
+                            const int64_t cpu_label_key = (int64_t)std::llround(cpu_elapsed_time * 100.0);
+                            if (cpu_label_key != zone.cpuBarLabelKey) {
+                                zone.cpuBarLabelKey = cpu_label_key;
+                                zone.cpuBarLabel = toStr("%s (cpu %.2f ms)", zone.name.c_str(), (double)cpu_label_key * 0.01);
+                                zone.cpuBarLabelSize = ImGui::CalcTextSize(zone.cpuBarLabel.c_str(), nullptr, true);
+                            }
+                        }
+                        const ImVec4 cpu_color = ImVec4(zone.cv4.x * 0.7f, zone.cv4.y * 0.7f, zone.cv4.z * 0.7f, 1.0f);
+                        m_DrawList_DrawBar(show_cpu_label ? zone.cpuBarLabel.c_str() : nullptr, zone.cpuBarLabelSize, cpu_bb, cpu_color,
+                                           hovered || cpu_hovered);
+                    }
                 }
             }
-        } else {
-#ifdef IAGP_DEBUG_MODE_LOGGING
-            IAGP_DEBUG_MODE_LOGGING("Bar Ms not displayed", name.c_str());
-#endif
+            ++row;
         }
+        m_DrawRows[idx] = row;
     }
-
-    if (depth == 0 && ((zonesOrdered.empty() && InAppGpuQueryZone::sShowLeafMode) || !InAppGpuQueryZone::sShowLeafMode)) {
-        const ImVec2 pos = window->DC.CursorPos;
-        const ImVec2 size = ImVec2(aw, ImGui::GetFrameHeight() * (InAppGpuScopedZone::sMaxDepth + 1U));
-        ImGui::ItemSize(size);
-        const ImRect bb(pos, pos + size);
-        const ImGuiID id = window->GetID((name + "##canvas").c_str());
-        if (!ImGui::ItemAdd(bb, id)) {
-            return pressed;
-        }
+    for (int32_t row = 0; row < (int32_t)m_LodBlocks.size(); ++row) {
+        draw_block(row);
     }
 
+    const ImVec2 pos = window->DC.CursorPos;
+    const ImVec2 size = ImVec2(aw, ImGui::GetFrameHeight() * (m_MaxDepth + 1U) * (show_cpu_track ? 2U : 1U));
+    ImGui::ItemSize(size);
+    const ImRect bb(pos, pos + size);
+    const ImGuiID id = window->GetID((m_Store.zones[vRootIdx].name + "##canvas").c_str());
+    ImGui::ItemAdd(bb, id);
+
     return pressed;
 }
 
-bool InAppGpuQueryZone::m_DrawCircularFlameGraph(IAGPQueryZonePtr vRoot, IAGPQueryZoneWeak& vOutSelectedQuery, IAGPQueryZoneWeak vParent,
-                                                 uint32_t vDepth) {
+bool InAppGpuGLContext::m_DrawCircularFlameGraph(const uint32_t vRootIdx, uint32_t& vOutSelectedZone) {
     bool pressed = false;
+    auto& settings = InAppGpuQueryZone::sCircularSettings;
 
-    if (vDepth == 0U) {
-        if (ImGui::BeginMenuBar()) {
-            if (ImGui::BeginMenu("Settings")) {
-                ImGui::SliderFloat("count points", &sCircularSettings.count_point, 1.0f, 240.0f);
-                ImGui::SliderFloat("base_radius", &sCircularSettings.base_radius, 0.0f, 240.0f);
-                ImGui::SliderFloat("space", &sCircularSettings.space, 0.0f, 240.0f);
-                ImGui::SliderFloat("thick", &sCircularSettings.thick, 0.0f, 240.0f);
-                ImGui::EndMenu();
-            }
-            ImGui::EndMenuBar();
+    if (ImGui::BeginMenuBar()) {
+        if (ImGui::BeginMenu("Settings")) {
+            ImGui::SliderFloat("count points", &settings.count_point, 12.0f, 360.0f);
+            ImGui::SliderFloat("base_radius", &settings.base_radius, 0.0f, 240.0f);
+            ImGui::SliderFloat("space", &settings.space, 0.0f, 240.0f);
+            ImGui::SliderFloat("thick", &settings.thick, 0.0f, 240.0f);
+            ImGui::EndMenu();
         }
+        ImGui::EndMenuBar();
     }
 
     ImGuiWindow* window = ImGui::GetCurrentWindow();
-    float barStartRatio = 0.0f;
-    float barSizeRatio = 0.0f;
-    if (m_ComputeRatios(vRoot, vParent, vDepth, barStartRatio, barSizeRatio)) {
-        if (barSizeRatio > 0.0f) {
-            if ((zonesOrdered.empty() && InAppGpuQueryZone::sShowLeafMode) || !InAppGpuQueryZone::sShowLeafMode) {
-                ImVec2 center = window->DC.CursorPos + ImGui::GetContentRegionAvail() * 0.5f;
-                ImGui::ColorConvertHSVtoRGB(hsv.x, hsv.y, hsv.z, cv4.x, cv4.y, cv4.z);
-                cv4.w = 1.0f;
-
-                float min_radius = sCircularSettings.base_radius + sCircularSettings.space * vDepth + sCircularSettings.thick * vDepth;
-                float max_radius = sCircularSettings.base_radius + sCircularSettings.space * vDepth + sCircularSettings.thick * (vDepth + 1U);
-
-                auto draw_list_ptr = window->DrawList;
-                auto colU32 = ImGui::GetColorU32(cv4);
-
-                float full_length = _1PI_;
-                float full_offset = _1PI_;
-
-                float base_st = full_length / sCircularSettings.count_point;
-
-                float bar_start = full_length * barStartRatio;
-                float bar_size = full_length * (barStartRatio + barSizeRatio);
-                float st = bar_size / ImMax(floor(bar_size / base_st), 3.0f);  // 2 points mini par barre
-
-                ImVector<ImVec2> path;
-                float co = 0.0f, si = 0.0f, ac = 0.0f, oc = 0.0f;
-                for (ac = bar_start; ac < bar_size; ac += st) {
-                    ac = ImMin(ac, bar_size);
-                    oc = ac + full_offset;
-                    co = std::cos(oc) * sCircularSettings.scaleX;
-                    si = std::sin(oc) * sCircularSettings.scaleY;
-                    m_P0.x = co * min_radius + center.x;
-                    m_P0.y = si * min_radius + center.y;
-                    m_P1.x = co * max_radius + center.x;
-                    m_P1.y = si * max_radius + center.y;
-                    if (ac > bar_start) {
-                        // draw_list_ptr->AddQuadFilled(m_P0, m_P1, m_LP1, m_LP0, colU32);
-                        draw_list_ptr->AddQuad(m_P0, m_P1, m_LP1, m_LP0, colU32, 2.0f);  // m_BlackU32
-
-                        // draw_list_ptr->PathLineTo(m_P0);
-                        // draw_list_ptr->PathLineTo(m_P1);
-                        // draw_list_ptr->PathLineTo(m_LP1);
-                        // draw_list_ptr->PathLineTo(m_LP0);
+    const ImVec2 canvas_pos = window->DC.CursorPos;
+    const ImVec2 canvas_size = ImGui::GetContentRegionAvail();
+    const ImVec2 center = canvas_pos + canvas_size * 0.5f;
+    auto draw_list_ptr = window->DrawList;
+    const int32_t count_point = ImMax((int32_t)settings.count_point, 3);
+    m_UpdateCircularTrig(count_point);
+    const float ring_step = settings.space + settings.thick;
+
+    // a parent is always before its childs in the store
+    // so one scan give the ring of each zone from the ring of its parent
+    const uint32_t zones_count = m_Store.size();
+    m_DrawRows.assign(zones_count, -1);  // -1 for the zones not shown
+    m_CircularSectors.clear();
+    for (uint32_t idx = vRootIdx; idx < zones_count; ++idx) {
+        int32_t ring = 0;
+        uint32_t parent_idx = vRootIdx;
+        if (idx != vRootIdx) {
+            parent_idx = m_Store.parents[idx];
+            if (parent_idx == InAppGpuZoneStore::sInvalidIndex || m_DrawRows[parent_idx] < 0) {
+                continue;  // not in the shown tree
+            }
+            ring = m_DrawRows[parent_idx];
+        }
+        float barStartRatio = 0.0f;
+        float barSizeRatio = 0.0f;
+        // we dont show child if this one have elapsed time to 0.0
+        if (!m_ComputeRatios(idx, vRootIdx, parent_idx, barStartRatio, barSizeRatio) || barSizeRatio <= 0.0f) {
+            continue;
+        }
+        const bool is_leaf = (m_Store.firstChilds[idx] == InAppGpuZoneStore::sInvalidIndex);
+        if ((is_leaf && InAppGpuQueryZone::sShowLeafMode) || !InAppGpuQueryZone::sShowLeafMode) {
+            // with the lod, the sectors with an outer arc too small are not shown, nor their childs
+            const float outer_radius = settings.base_radius + ring_step * ring + settings.thick;
+            if (InAppGpuQueryZone::sUseLod && barSizeRatio * 2.0f * IM_PI * outer_radius < InAppGpuQueryZone::sLodMinBarWidth) {
+                continue;
+            }
+            auto& zone = m_Store.zones[idx];
+            ImGui::ColorConvertHSVtoRGB(zone.hsv.x, zone.hsv.y, zone.hsv.z, zone.cv4.x, zone.cv4.y, zone.cv4.z);
+            zone.cv4.w = 1.0f;
+            circularSector sector;
+            sector.zoneIdx = idx;
+            sector.ring = ring;
+            sector.start = barStartRatio;
+            sector.end = barStartRatio + barSizeRatio;
+            sector.color = ImGui::GetColorU32(zone.cv4);
+            sector.highlighted = zone.highlighted;
+            zone.highlighted = false;
+            m_CircularSectors.push_back(sector);
+            ++ring;
+        }
+        m_DrawRows[idx] = ring;
+    }
+    std::sort(m_CircularSectors.begin(), m_CircularSectors.end(), [](const circularSector& vA, const circularSector& vB) {
+        return (vA.ring < vB.ring) || (vA.ring == vB.ring && vA.start < vB.start);
+    });
+
+    // the points of a sector are its two ends and the points of the table between them
+    const auto get_table_range = [count_point](const circularSector& vSector, int32_t& vOutFirst) {
+        vOutFirst = ImMax((int32_t)std::floor(vSector.start * count_point) + 1, 0);
+        const int32_t last = ImMin((int32_t)std::ceil(vSector.end * count_point) - 1, count_point);
+        return ImMax(last - vOutFirst + 1, 0) + 1;  // the count of segments
+    };
+    const auto get_sector_point = [&](const circularSector& vSector, const int32_t vFirst, const int32_t vSegments, const int32_t vPoint) {
+        if (vPoint == 0) {
+            return m_GetCircularPoint(vSector.start);
+        } else if (vPoint == vSegments) {
+            return m_GetCircularPoint(vSector.end);
+        }
+        return m_CircularTrig[vFirst + vPoint - 1];
+    };
+
+    // the sectors of a ring are written in one batch of triangles,
+    // splitted only when over the 16 bits indices of imgui
+    const ImVec2 uv = ImGui::GetFontTexUvWhitePixel();
+    const int32_t max_batch_vertices = 60000;
+    size_t batch_start = 0U;
+    while (batch_start < m_CircularSectors.size()) {
+        const int32_t ring = m_CircularSectors[batch_start].ring;
+        size_t batch_end = batch_start;
+        int32_t vtx_count = 0;
+        int32_t idx_count = 0;
+        int32_t first = 0;
+        while (batch_end < m_CircularSectors.size() && m_CircularSectors[batch_end].ring == ring) {
+            const int32_t segments = get_table_range(m_CircularSectors[batch_end], first);
+            if (vtx_count > 0 && vtx_count + (segments + 1) * 2 > max_batch_vertices) {
+                break;
+            }
+            vtx_count += (segments + 1) * 2;
+            idx_count += segments * 6;
+            ++batch_end;
+        }
+        const float inner_radius = settings.base_radius + ring_step * ring;
+        const float outer_radius = inner_radius + settings.thick;
+        draw_list_ptr->PrimReserve(idx_count, vtx_count);
+        for (size_t i = batch_start; i < batch_end; ++i) {
+            const auto& sector = m_CircularSectors[i];
+            const int32_t segments = get_table_range(sector, first);
+            const auto base_idx = (ImDrawIdx)draw_list_ptr->_VtxCurrentIdx;
+            for (int32_t p = 0; p <= segments; ++p) {
+                const ImVec2 point = get_sector_point(sector, first, segments, p);
+                const ImVec2 dir = ImVec2(point.x * settings.scaleX, point.y * settings.scaleY);
+                draw_list_ptr->PrimWriteVtx(center + dir * inner_radius, uv, sector.color);
+                draw_list_ptr->PrimWriteVtx(center + dir * outer_radius, uv, sector.color);
+            }
+            for (int32_t seg = 0; seg < segments; ++seg) {
+                const auto a = (ImDrawIdx)(base_idx + seg * 2);  // inner
+                const auto b = (ImDrawIdx)(a + 1);               // outer
+                const auto c = (ImDrawIdx)(a + 2);               // next inner
+                const auto d = (ImDrawIdx)(a + 3);               // next outer
+                draw_list_ptr->PrimWriteIdx(a);
+                draw_list_ptr->PrimWriteIdx(b);
+                draw_list_ptr->PrimWriteIdx(d);
+                draw_list_ptr->PrimWriteIdx(a);
+                draw_list_ptr->PrimWriteIdx(d);
+                draw_list_ptr->PrimWriteIdx(c);
+            }
+        }
+        batch_start = batch_end;
+    }
+
+    // the canvas catch the clicks, the sector is found from the polar coords of the mouse
+    const ImRect canvas_bb(canvas_pos, canvas_pos + canvas_size);
+    const ImGuiID canvas_id = window->GetID("##circular");
+    ImGui::ItemSize(canvas_size);
+    const circularSector* hovered_sector_ptr = nullptr;
+    if (ImGui::ItemAdd(canvas_bb, canvas_id)) {
+        bool canvas_hovered, canvas_held;
+        const bool canvas_pressed =
+            ImGui::ButtonBehavior(canvas_bb, canvas_id, &canvas_hovered, &canvas_held,  //
+                                  ImGuiButtonFlags_PressedOnClick | ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonRight);
+        if (canvas_hovered && ring_step > 0.0f && settings.scaleX > 0.0f && settings.scaleY > 0.0f) {
+            const ImVec2 mouse = ImGui::GetMousePos() - center;
+            const float mx = mouse.x / settings.scaleX;
+            const float my = mouse.y / settings.scaleY;
+            const float radius = std::sqrt(mx * mx + my * my) - settings.base_radius;
+            if (radius >= 0.0f) {
+                const int32_t ring = (int32_t)(radius / ring_step);
+                if (radius - ring_step * ring <= settings.thick) {
+                    float turn = (std::atan2(my, mx) + IM_PI * 0.5f) / (2.0f * IM_PI);
+                    if (turn < 0.0f) {
+                        turn += 1.0f;
+                    }
+                    auto it = std::lower_bound(m_CircularSectors.begin(), m_CircularSectors.end(), ring,  //
+                                               [](const circularSector& vSector, const int32_t vRing) { return vSector.ring < vRing; });
+                    for (; it != m_CircularSectors.end() && it->ring == ring; ++it) {
+                        if (turn >= it->start && turn < it->end) {
+                            hovered_sector_ptr = &(*it);
+                            break;
+                        }
                     }
-                    m_LP0 = m_P0;
-                    m_LP1 = m_P1;
                 }
-                // draw_list_ptr->PathStroke(colU32, ImDrawFlags_Closed, 2.0f);
-
-#ifdef _DEBUG
-                // draw_list_ptr->AddLine(center, center - ImVec2(0, 150.0f), colU32, 2.0f);
-#endif
-
-                ++vDepth;
             }
-
-            // we dont show child if this one have elapsed time to 0.0
-            // childs
-            for (const auto& zone : zonesOrdered) {
-                if (zone != nullptr) {
-                    pressed |= zone->m_DrawCircularFlameGraph(vRoot, vOutSelectedQuery, m_This, vDepth);
+        }
+        if (hovered_sector_ptr != nullptr) {
+            const uint32_t idx = hovered_sector_ptr->zoneIdx;
+            m_DrawZoneTooltip(idx);
+            m_Store.zones[idx].highlighted = true;  // to highlight label graph by this sector
+            if (canvas_pressed) {
+                if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+                    vOutSelectedZone = idx;  // open in the main window
+                } else if (ImGui::IsMouseClicked(ImGuiMouseButton_Right) && m_Store.depths[idx] > 0U) {
+                    InAppGpuProfiler::Instance()->OpenTabbedQueryZone(m_This, idx);  // open new window
                 }
+                pressed = true;
             }
         }
     }
 
+    // the outline of the hovered sector, and of the sectors highlighted by the label graph
+    for (const auto& sector : m_CircularSectors) {
+        if (&sector != hovered_sector_ptr && !sector.highlighted) {
+            continue;
+        }
+        const ImVec4 color = m_Store.zones[sector.zoneIdx].cv4;
+        const auto selectU32 = ImGui::ColorConvertFloat4ToU32(ImVec4(1.0f - color.x, 1.0f - color.y, 1.0f - color.z, 1.0f));
+        const float inner_radius = settings.base_radius + ring_step * sector.ring;
+        const float outer_radius = inner_radius + settings.thick;
+        int32_t first = 0;
+        const int32_t segments = get_table_range(sector, first);
+        m_CircularOutline.clear();
+        for (int32_t p = 0; p <= segments; ++p) {
+            const ImVec2 point = get_sector_point(sector, first, segments, p);
+            m_CircularOutline.push_back(center + ImVec2(point.x * settings.scaleX, point.y * settings.scaleY) * inner_radius);
+        }
+        for (int32_t p = segments; p >= 0; --p) {
+            const ImVec2 point = get_sector_point(sector, first, segments, p);
+            m_CircularOutline.push_back(center + ImVec2(point.x * settings.scaleX, point.y * settings.scaleY) * outer_radius);
+        }
+        draw_list_ptr->AddPolyline(m_CircularOutline.data(), (int)m_CircularOutline.size(), selectU32, ImDrawFlags_Closed, 2.0f);
+    }
+
     return pressed;
 }
 
-////////////////////////////////////////////////////////////
-/////////////////////// GL CONTEXT /////////////////////////
-////////////////////////////////////////////////////////////
-
-IAGPContextPtr InAppGpuGLContext::create(IAGP_GPU_CONTEXT vContext) {
-    auto res = std::make_shared<InAppGpuGLContext>(vContext);
-    res->m_This = res;
-    return res;
+void InAppGpuGLContext::m_DrawZoneTooltip(const uint32_t vZoneIdx) {
+    const auto& zone = m_Store.zones[vZoneIdx];
+    const double elapsed_time = m_Shown.elapsedTimes[vZoneIdx];
+    const auto& histogram = m_Store.zones[vZoneIdx].histogram;
+    const auto percentiles = histogram.GetPercentiles();
+    // the zone called several times in the last frame, its elapsed time go from the first call to the last
+    char invocations[160] = "";
+    const GLuint count = m_Store.lastCounts[vZoneIdx];
+    if (!m_IsFrameInspected && count > 1U) {
+        snprintf(invocations, sizeof(invocations), "\nCalls : %u, Sum : %.5f ms, Min / Mean / Max : %.5f / %.5f / %.5f ms", count,
+                 m_Store.zones[vZoneIdx].invocationSumTime * 1e-6, m_Store.zones[vZoneIdx].invocationMinTime * 1e-6,
+                 m_Store.zones[vZoneIdx].invocationSumTime * 1e-6 / count, m_Store.zones[vZoneIdx].invocationMaxTime * 1e-6);
+    }
+    ImGui::SetTooltip(
+        "Section : [%s : %s]\nElapsed time : %.5f ms\nElapsed FPS : %.5f f/s\n"
+        "Samples : %llu\nMin / Max : %.5f / %.5f ms\nP50 / P95 / P99 : %.5f / %.5f / %.5f ms%s",  //
+        zone.sectionName.c_str(), zone.name.c_str(), elapsed_time, 1000.0f / elapsed_time,  //
+        (unsigned long long)histogram.GetCount(), histogram.GetMin() * 1e-6, histogram.GetMax() * 1e-6, percentiles.p50 * 1e-6, percentiles.p95 * 1e-6, percentiles.p99 * 1e-6,
+        invocations);
 }
 
-InAppGpuGLContext::InAppGpuGLContext(IAGP_GPU_CONTEXT vContext) : m_Context(vContext) {
+// the first point is at the top of the circle, and the turns go clockwise
+void InAppGpuGLContext::m_UpdateCircularTrig(const int32_t vCount) {
+    if (vCount != m_CircularTrigCount) {
+        m_CircularTrigCount = vCount;
+        m_CircularTrig.resize((size_t)vCount + 1U);
+        for (int32_t i = 0; i <= vCount; ++i) {
+            const double angle = 2.0 * (double)IM_PI * i / vCount - (double)IM_PI * 0.5;
+            m_CircularTrig[i] = ImVec2((float)std::cos(angle), (float)std::sin(angle));
+        }
+    }
 }
 
-void InAppGpuGLContext::Clear() {
-    m_RootZone.reset();
-    m_PendingUpdate.clear();
-    m_QueryIDToZone.clear();
-    m_DepthToLastZone.clear();
+// the point at vTurn on the polygon of the table, so the sectors fit their neighbours
+ImVec2 InAppGpuGLContext::m_GetCircularPoint(const float vTurn) const {
+    const float pos = ImClamp(vTurn, 0.0f, 1.0f) * (float)m_CircularTrigCount;
+    const int32_t i = ImMin((int32_t)pos, m_CircularTrigCount - 1);
+    const float t = pos - (float)i;
+    const ImVec2& a = m_CircularTrig[i];
+    const ImVec2& b = m_CircularTrig[i + 1];
+    return ImVec2(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
 }
 
-void InAppGpuGLContext::Init() {
-}
+////////////////////////////////////////////////////////////
+/////////////////////// AGGREGATION ////////////////////////
+////////////////////////////////////////////////////////////
 
-void InAppGpuGLContext::Unit() {
-    Clear();
+const InAppGpuAggregateTree* InAppGpuGLContext::GetAggregateTree(const InAppGpuViewEnum& vView) const {
+    switch (vView) {
+        case InAppGpuViewEnum::IN_APP_GPU_VIEW_BOTTOM_UP: return &m_BottomUpTree;
+        case InAppGpuViewEnum::IN_APP_GPU_VIEW_MERGED: return &m_MergedTree;
+        case InAppGpuViewEnum::IN_APP_GPU_VIEW_SECTIONS: return &m_SectionsTree;
+        case InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE:
+        case InAppGpuViewEnum::IN_APP_GPU_VIEW_Count:
+        default: break;
+    }
+    return nullptr;
 }
 
-void InAppGpuGLContext::Collect() {
-#ifdef IAGP_DEBUG_MODE_LOGGING
-    IAGP_DEBUG_MODE_LOGGING("------ Collect Trhead (%i) -----", (intptr_t)m_Context);
-#endif
-
-    auto it = m_PendingUpdate.begin();
-    while (!m_PendingUpdate.empty() && it != m_PendingUpdate.end()) {
-        GLuint id = *it;
-        GLuint value = 0;
-        glGetQueryObjectuiv(id, GL_QUERY_RESULT_AVAILABLE, &value);
-        const auto it_to_erase_eventually = it;
-        ++it;
-        if (value == GL_TRUE /* || id == m_RootZone->ids[0] || id == m_RootZone->ids[1]*/) {
-            GLuint64 value64 = 0;
-            glGetQueryObjectui64v(id, GL_QUERY_RESULT, &value64);
-            if (m_QueryIDToZone.find(id) != m_QueryIDToZone.end()) {
-                auto ptr = m_QueryIDToZone[id];
-                if (ptr != nullptr) {
-                    if (id == ptr->ids[0]) {
-                        ptr->SetStartTimeStamp(value64);
-                    } else if (id == ptr->ids[1]) {
-                        ptr->last_count = ptr->current_count;
-                        ptr->current_count = 0U;
-                        ptr->SetEndTimeStamp(value64);
-                    } else {
-                        DEBUG_BREAK;
-                    }
-                }
-            }
-            m_PendingUpdate.erase(it_to_erase_eventually);
-        } else {
-            auto ptr = m_QueryIDToZone[id];
-            if (ptr != nullptr) {
-                IAGP_LOG_ERROR_MESSAGE("%*s id not retrieved : %u", ptr->depth, "", id);
-            }
-        }
-    }
+InAppGpuAggregateTree* InAppGpuGLContext::m_GetAggregateTree(const InAppGpuViewEnum& vView) {
+    return const_cast<InAppGpuAggregateTree*>(GetAggregateTree(vView));
+}
 
-#ifdef IAGP_DEBUG_MODE_LOGGING
-    IAGP_DEBUG_MODE_LOGGING("------ End Frame -----");
-#endif
+void InAppGpuGLContext::m_ClearAggregates() {
+    m_BottomUpTree.Clear("Bottom up");
+    m_MergedTree.Clear("Merged by name");
+    m_SectionsTree.Clear("Sections");
+    m_AggregateLinks.clear();
+    m_BottomUpNodes.clear();
+    m_AggregateLabels.clear();
 }
 
-void InAppGpuGLContext::DrawFlamGraph(const InAppGpuGraphTypeEnum& vGraphType) {
-    if (m_RootZone != nullptr) {
-        if (!m_SelectedQuery.expired()) {
-            auto ptr = m_SelectedQuery.lock();
-            if (ptr) {
-                ptr->DrawBreadCrumbTrail(m_SelectedQuery);
-                ptr->DrawFlamGraph(vGraphType, m_SelectedQuery);
-            }
-        } else {
-            m_RootZone->DrawFlamGraph(vGraphType, m_SelectedQuery);
-        }
+// called once per zone, when the zone is seen in a collected frame for the first time
+// a parent is always mapped before its childs
+void InAppGpuGLContext::m_MapZoneOnAggregates(const uint32_t vZoneIdx) {
+    const auto& zone = m_Store.zones[vZoneIdx];
+    m_AggregateLabels.push_back(zone.sectionName.empty() ? zone.name : zone.sectionName + " : " + zone.name);
+    const std::string& label = m_AggregateLabels.back();
+    const uint32_t parent_idx = m_Store.parents[vZoneIdx];
+    aggregateLinks links;
+
+    // bottom up : the zone by name, then its callers up to the root
+    links.bottomUpOffset = (uint32_t)m_BottomUpNodes.size();
+    uint32_t node_idx = 0U;
+    for (uint32_t idx = vZoneIdx; idx != InAppGpuZoneStore::sInvalidIndex; idx = m_Store.parents[idx]) {
+        node_idx = m_BottomUpTree.GetNode(node_idx, m_AggregateLabels[idx]);
+        m_BottomUpNodes.push_back(node_idx);
     }
-}
 
-void InAppGpuGLContext::DrawDetails() {
-    if (m_RootZone != nullptr) {
-        m_RootZone->DrawDetails();
+    // merged : the zone by name, and under its parent by name
+    for (uint32_t idx = parent_idx; idx != InAppGpuZoneStore::sInvalidIndex && !links.isNested; idx = m_Store.parents[idx]) {
+        links.isNested = (m_AggregateLabels[idx] == label);
+    }
+    links.mergedNode = m_MergedTree.GetNode(0U, label);
+    if (parent_idx != InAppGpuZoneStore::sInvalidIndex) {
+        links.mergedChildNode = m_MergedTree.GetNode(m_AggregateLinks[parent_idx].mergedNode, label);
     }
-}
 
-IAGPQueryZonePtr InAppGpuGLContext::GetQueryZoneForName(const void* vPtr, const std::string& vName, const std::string& vSection,
-                                                        const bool vIsRoot) {
-    IAGPQueryZonePtr res = nullptr;
+    // sections : the section, then the zone by name
+    links.sectionNode = m_SectionsTree.GetNode(m_SectionsTree.GetNode(0U, zone.sectionName), zone.name);
 
-    /////////////////////////////////////////////
-    //////////////// CREATION ///////////////////
-    /////////////////////////////////////////////
+    m_AggregateLinks.push_back(links);
+}
 
-    // there is many link issues with 'max' in cross compilation so we dont using it
-    if (InAppGpuScopedZone::sCurrentDepth > InAppGpuScopedZone::sMaxDepth) {
-        InAppGpuScopedZone::sMaxDepth = InAppGpuScopedZone::sCurrentDepth;
+// the nodes of the new zones are added, and the times of the frame are summed in the nodes.
+// nothing is rebuilt, the cost is the count of zones of the frame, and the depth for the bottom up view
+void InAppGpuGLContext::m_UpdateAggregates(const std::vector<InAppGpuCollectedZone>& vZones) {
+    const uint32_t zones_count = m_Store.size();
+    for (uint32_t idx = (uint32_t)m_AggregateLinks.size(); idx < zones_count; ++idx) {
+        m_MapZoneOnAggregates(idx);
     }
 
-    if (InAppGpuScopedZone::sCurrentDepth == 0) {  // root zone
-#ifdef IAGP_DEBUG_MODE_LOGGING
-        IAGP_DEBUG_MODE_LOGGING("------ Start Frame -----");
-#endif
-        m_DepthToLastZone.clear();
-        if (m_RootZone == nullptr) {
-            res = InAppGpuQueryZone::create(m_Context, vName, vSection, vIsRoot);
-            if (res != nullptr) {
-                res->depth = InAppGpuScopedZone::sCurrentDepth;
-                res->UpdateBreadCrumbTrail();
-                m_QueryIDToZone[res->ids[0]] = res;
-                m_QueryIDToZone[res->ids[1]] = res;
-                m_RootZone = res;
-#ifdef IAGP_DEBUG_MODE_LOGGING
-                // IAGP_DEBUG_MODE_LOGGING("Profile : add zone %s at puDepth %u", vName.c_str(), InAppGpuScopedZone::sCurrentDepth);
-#endif
-            }
-        } else {
-            res = m_RootZone;
+    // the self times, the times of the childs are removed from their parent
+    m_AggregateTimes.resize(zones_count, 0.0);
+    m_AggregateSelfTimes.resize(zones_count, 0.0);
+    for (const auto& collected : vZones) {
+        if (collected.zoneIdx < zones_count) {
+            const double time = (collected.endTimeStamp > collected.startTimeStamp) ? (double)(collected.endTimeStamp - collected.startTimeStamp) * 1e-6 : 0.0;
+            m_AggregateTimes[collected.zoneIdx] = time;
+            m_AggregateSelfTimes[collected.zoneIdx] = time;
         }
-    } else {  // else child zone
-        auto root = m_GetQueryZoneFromDepth(InAppGpuScopedZone::sCurrentDepth - 1U);
-        if (root != nullptr) {
-            bool found = false;
-            const auto& key_str = vSection + vName;
-            const auto& ptr_iter = root->zonesDico.find(vPtr);
-            if (ptr_iter == root->zonesDico.end()) {  // not found
-                found = false;
-            } else {  // found
-                found = (ptr_iter->second.find(key_str) != ptr_iter->second.end());  // not found
-            }
-            if (!found) {  // not found
-                res = InAppGpuQueryZone::create(m_Context, vName, vSection, vIsRoot);
-                if (res != nullptr) {
-                    res->parentPtr = root;
-                    res->rootPtr = m_RootZone;
-                    res->depth = InAppGpuScopedZone::sCurrentDepth;
-                    res->UpdateBreadCrumbTrail();
-                    m_QueryIDToZone[res->ids[0]] = res;
-                    m_QueryIDToZone[res->ids[1]] = res;
-                    root->zonesDico[vPtr][key_str] = res;
-                    root->zonesOrdered.push_back(res);
-#ifdef IAGP_DEBUG_MODE_LOGGING
-                    // IAGP_DEBUG_MODE_LOGGING("Profile : add zone %s at puDepth %u", vName.c_str(), InAppGpuScopedZone::sCurrentDepth);
-#endif
-                } else {
-                    DEBUG_BREAK;
-                }
-            } else {
-                res = root->zonesDico[vPtr][key_str];
+    }
+    for (const auto& collected : vZones) {
+        if (collected.zoneIdx < zones_count) {
+            const uint32_t parent_idx = m_Store.parents[collected.zoneIdx];
+            if (parent_idx != InAppGpuZoneStore::sInvalidIndex) {
+                m_AggregateSelfTimes[parent_idx] -= m_AggregateTimes[collected.zoneIdx];
             }
-        } else {
-            return res;  // happen when profiling is activated inside a profiling zone
         }
     }
 
-    /////////////////////////////////////////////
-    //////////////// UTILISATION ////////////////
-    /////////////////////////////////////////////
+    m_BottomUpTree.BeginFrame();
+    m_MergedTree.BeginFrame();
+    m_SectionsTree.BeginFrame();
+    for (const auto& collected : vZones) {
+        if (collected.zoneIdx >= zones_count) {
+            continue;
+        }
+        const uint32_t zone_idx = collected.zoneIdx;
+        const uint32_t parent_idx = m_Store.parents[zone_idx];
+        const auto& links = m_AggregateLinks[zone_idx];
+        const double time = m_AggregateTimes[zone_idx];
+        const double self_time = ImMax(m_AggregateSelfTimes[zone_idx], 0.0);  // the childs can overlap
+        const GLuint count = collected.count;
+
+        m_BottomUpTree.AddTime(0U, self_time, 0U);
+        const uint32_t path_size = m_Store.depths[zone_idx] + 1U;
+        for (uint32_t idx = 0U; idx < path_size; ++idx) {
+            m_BottomUpTree.AddTime(m_BottomUpNodes[links.bottomUpOffset + idx], self_time, count);
+        }
+
+        // the time of a zone in a zone of the same name is already in the time of this one
+        m_MergedTree.AddTime(links.mergedNode, links.isNested ? 0.0 : time, count);
+        if (parent_idx == InAppGpuZoneStore::sInvalidIndex) {
+            m_MergedTree.AddTime(0U, time, 0U);
+        } else if (!m_AggregateLinks[parent_idx].isNested) {
+            m_MergedTree.AddTime(links.mergedChildNode, time, count);
+        }
 
-    if (res != nullptr) {
-        m_SetQueryZoneForDepth(res, InAppGpuScopedZone::sCurrentDepth);
+        m_SectionsTree.AddTime(0U, self_time, 0U);
+        m_SectionsTree.AddTime(m_SectionsTree.parents[links.sectionNode], self_time, count);
+        m_SectionsTree.AddTime(links.sectionNode, self_time, count);
+    }
+    m_BottomUpTree.EndFrame();
+    m_MergedTree.EndFrame();
+    m_SectionsTree.EndFrame();
+}
+
+// an icicle graph, the childs are packed from the start of their parent in their order of creation, so the bars dont move
+void InAppGpuGLContext::DrawAggregateFlamGraph(const InAppGpuViewEnum& vView) {
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_DRAW_FLAME_GRAPH);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto* tree_ptr = m_GetAggregateTree(vView);
+    if (tree_ptr == nullptr || tree_ptr->size() == 0U) {
+        return;
+    }
+    auto& tree = *tree_ptr;
+    const ImGuiContext& g = *GImGui;
+    const ImGuiStyle& style = g.Style;
+    const float aw = ImGui::GetContentRegionAvail().x - style.FramePadding.x;
+    const float height = ImGui::GetTextLineHeight() + style.FramePadding.y * 2.0f;
+    const float label_min_width = ImGui::CalcTextSize("...").x + style.FramePadding.x * 2.0f;
+    ImGuiWindow* window = ImGui::GetCurrentWindow();
+    const ImVec2 origin = window->DC.CursorPos;
 
-        if (res->name != vName) {
-            // at depth 0 there is only one frame
-            IAGP_LOG_DEBUG_ERROR_MESSAGE("was registerd at depth %u %s. but we got %s\nwe clear the profiler",  //
-                                    InAppGpuScopedZone::sCurrentDepth, res->name.c_str(), vName.c_str());
-            // maybe the scoped frame is taken outside of the main frame
-            Clear();
+    // the names of the merged view overlap, so the scale is the greater of the root and of the sum of its childs
+    double range_time = tree.elapsedTimes[0];
+    double childs_time = 0.0;
+    for (uint32_t idx = tree.firstChilds[0]; idx != InAppGpuAggregateTree::sInvalidIndex; idx = tree.nextSiblings[idx]) {
+        childs_time += tree.elapsedTimes[idx];
+    }
+    range_time = ImMax(range_time, childs_time);
+
+    uint32_t max_depth = 0U;
+    m_AggregateCursors.assign(tree.size(), -1.0f);  // -1 for the nodes not shown
+    for (uint32_t idx = 0U; idx < tree.size() && range_time > 0.0; ++idx) {
+        float bar_start = 0.0f;
+        const uint32_t parent_idx = tree.parents[idx];
+        if (parent_idx != InAppGpuAggregateTree::sInvalidIndex) {
+            if (m_AggregateCursors[parent_idx] < 0.0f) {
+                continue;  // not in the shown tree
+            }
+            bar_start = m_AggregateCursors[parent_idx];
         }
-
-        m_PendingUpdate.emplace(res->ids[0]);
-        m_PendingUpdate.emplace(res->ids[1]);
+        const double elapsed_time = tree.elapsedTimes[idx];
+        const float bar_size = aw * (float)(elapsed_time / range_time);
+        if (elapsed_time <= 0.0 || (InAppGpuQueryZone::sUseLod && bar_size < InAppGpuQueryZone::sLodMinBarWidth)) {
+            continue;
+        }
+        if (parent_idx != InAppGpuAggregateTree::sInvalidIndex) {
+            m_AggregateCursors[parent_idx] += bar_size;
+        }
+        m_AggregateCursors[idx] = bar_start;
+        const uint32_t depth = tree.depths[idx];
+        max_depth = ImMax(max_depth, depth);
+        const ImVec2 pos = origin + ImVec2(bar_start + style.FramePadding.x, depth * height + style.FramePadding.y);
+        const ImRect bb(pos, pos + ImVec2(bar_size, height));
+        if (!ImGui::IsRectVisible(bb.Min, bb.Max)) {
+            continue;
+        }
+        const bool hovered = ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(bb.Min, bb.Max);
+        if (hovered) {
+            ImGui::SetTooltip("%s\nElapsed time : %.5f ms\nCount : %u", tree.names[idx].c_str(), elapsed_time, tree.counts[idx]);
+        }
+        ImVec4 color(0.0f, 0.0f, 0.0f, 1.0f);
+        ImGui::ColorConvertHSVtoRGB((float)(0.5 - 0.5 * elapsed_time / range_time), 0.5f, 1.0f, color.x, color.y, color.z);
+        const bool show_label = (bar_size >= label_min_width);
+        if (show_label) {
+            const int64_t label_key = (int64_t)std::llround(elapsed_time * 100.0);
+            if (label_key != tree.barLabelKeys[idx]) {
+                tree.barLabelKeys[idx] = label_key;
+                tree.barLabels[idx] = toStr("%s (%.2f ms)", tree.names[idx].c_str(), (double)label_key * 0.01);
+                tree.barLabelSizes[idx] = ImGui::CalcTextSize(tree.barLabels[idx].c_str(), nullptr, true);
+            }
+        }
+        m_DrawList_DrawBar(show_label ? tree.barLabels[idx].c_str() : nullptr, tree.barLabelSizes[idx], bb, color, hovered);
     }
 
-    return res;
+    const ImVec2 size = ImVec2(aw, height * (max_depth + 1U));
+    ImGui::ItemSize(size);
+    const ImRect bb(origin, origin + size);
+    ImGui::ItemAdd(bb, window->GetID("##aggregate"));
 }
 
-void InAppGpuGLContext::m_SetQueryZoneForDepth(IAGPQueryZonePtr vInAppGpuQueryZone, GLuint vDepth) {
-    m_DepthToLastZone[vDepth] = vInAppGpuQueryZone;
+void InAppGpuGLContext::DrawAggregateDetails(const InAppGpuViewEnum& vView, const InAppGpuDetailsColumnEnum& vSortColumn, const bool vSortDescending) {
+    IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_DRAW_DETAILS);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto* tree_ptr = m_GetAggregateTree(vView);
+    if (tree_ptr != nullptr && tree_ptr->size() > 0U) {
+        ImGui::PushID(this);
+        ImGui::PushID((int)vView);
+        m_DetailsChilds.clear();
+        m_DrawAggregateDetailsRow(*tree_ptr, 0U, vSortColumn, vSortDescending);
+        ImGui::PopID();
+        ImGui::PopID();
+    }
 }
 
-IAGPQueryZonePtr InAppGpuGLContext::m_GetQueryZoneFromDepth(GLuint vDepth) {
-    IAGPQueryZonePtr res = nullptr;
-
-    if (m_DepthToLastZone.find(vDepth) != m_DepthToLastZone.end()) {  // found
-        res = m_DepthToLastZone[vDepth];
+// the nodes are few and closed by default, so they are drawn recursively
+// only the count and the gpu time columns are filled
+void InAppGpuGLContext::m_DrawAggregateDetailsRow(InAppGpuAggregateTree& vTree, const uint32_t vNodeIdx, const InAppGpuDetailsColumnEnum& vSortColumn,
+                                                  const bool vSortDescending) {
+    const size_t first_child = m_DetailsChilds.size();
+    for (uint32_t idx = vTree.firstChilds[vNodeIdx]; idx != InAppGpuAggregateTree::sInvalidIndex; idx = vTree.nextSiblings[idx]) {
+        if (vTree.elapsedTimes[idx] > 0.0) {
+            m_DetailsChilds.push_back(idx);
+        }
     }
-
-    return res;
+    const size_t last_child = m_DetailsChilds.size();
+    const bool has_childs = (last_child > first_child);
+
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();  // tree
+    ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_CollapsingHeader;
+    if (!has_childs) {
+        flags |= ImGuiTreeNodeFlags_Leaf;
+    }
+    const float indent = ImGui::GetStyle().IndentSpacing * (float)vTree.depths[vNodeIdx];
+    if (indent > 0.0f) {
+        ImGui::Indent(indent);
+    }
+    ImGui::SetNextItemOpen(vTree.expanded[vNodeIdx] != 0U);
+    const bool res = ImGui::TreeNodeEx((const void*)(intptr_t)vNodeIdx, flags, "%s", vTree.names[vNodeIdx].c_str());
+    if (indent > 0.0f) {
+        ImGui::Unindent(indent);
+    }
+    if (has_childs) {
+        vTree.expanded[vNodeIdx] = res ? 1U : 0U;
+    }
+#ifdef IAGP_SHOW_COUNT
+    ImGui::TableNextColumn();  // Count
+    ImGui::Text("%u", vTree.counts[vNodeIdx]);
+#endif
+    ImGui::TableNextColumn();  // Gpu time
+    ImGui::Text("%.5f ms", vTree.elapsedTimes[vNodeIdx]);
+
+    if (has_childs && res) {
+        // sorted by the count or by the time, the only columns of the views
+        if (vSortColumn != InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_TREE) {
+            const bool by_count = (vSortColumn == InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_COUNT);
+            std::stable_sort(m_DetailsChilds.begin() + first_child, m_DetailsChilds.begin() + last_child,  //
+                             [&vTree, by_count, vSortDescending](const uint32_t vA, const uint32_t vB) {
+                                 const double a = by_count ? (double)vTree.counts[vA] : vTree.elapsedTimes[vA];
+                                 const double b = by_count ? (double)vTree.counts[vB] : vTree.elapsedTimes[vB];
+                                 return vSortDescending ? (a > b) : (a < b);
+                             });
+        }
+        for (size_t i = first_child; i < last_child; ++i) {
+            m_DrawAggregateDetailsRow(vTree, m_DetailsChilds[i], vSortColumn, vSortDescending);
+        }
+    }
+    m_DetailsChilds.resize(first_child);
 }
 
 ////////////////////////////////////////////////////////////
@@ -900,34 +3508,53 @@ IAGPQueryZonePtr InAppGpuGLContext::m_GetQueryZoneFromDepth(GLuint vDepth) {
 ////////////////////////////////////////////////////////////
 
 bool InAppGpuProfiler::sIsActive = false;
-bool InAppGpuProfiler::sIsPaused = false;
+std::atomic<bool> InAppGpuProfiler::sIsPaused{false};
+InAppGpuSamplingEnum InAppGpuProfiler::sSamplingMode = InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ALL;
+int32_t InAppGpuProfiler::sSamplingPeriod = IAGP_SAMPLING_PERIOD;
+float InAppGpuProfiler::sSamplingBudget = IAGP_SAMPLING_BUDGET;
 
 InAppGpuProfiler::InAppGpuProfiler() = default;
-InAppGpuProfiler::InAppGpuProfiler(const InAppGpuProfiler&) = default;
+InAppGpuProfiler::InAppGpuProfiler(const InAppGpuProfiler&) {
+}  // the mutex cant be copied, and the singleton is never copied
 
 InAppGpuProfiler& InAppGpuProfiler::operator=(const InAppGpuProfiler&) {
     return *this;
 };
 
 InAppGpuProfiler::~InAppGpuProfiler() {
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    StopCollectorThread();
+#endif  // IAGP_USE_COLLECTOR_THREAD
     Clear();
 };
 
 void InAppGpuProfiler::Clear() {
+    m_TabbedQueryZones.clear();
+    m_ContextsToDraw.clear();
+    std::lock_guard<std::mutex> lock(m_ContextsMutex);
+    // the queries of a context can only be deleted where the context is current
+    // so the contexts are kept until their thread use the profiler again
+    for (auto& con : m_Contexts) {
+        if (con.second != nullptr) {
+            m_ContextsToRelease.emplace_back(con.first, std::move(con.second));
+        }
+    }
     m_Contexts.clear();
+    m_ContextsToReleaseCount.store((uint32_t)m_ContextsToRelease.size(), std::memory_order_release);
+    ++m_ContextsGeneration;
 }
 
 void InAppGpuProfiler::Collect() {
-    if (!sIsActive || sIsPaused) {
+    if (!sIsActive || sIsPaused.load(std::memory_order_acquire)) {
         return;
     }
 
-    glFinish();
-
-    for (const auto& con : m_Contexts) {
-        if (con.second != nullptr) {
-            con.second->Collect();
-        }
+    // the queries of a context can only be read by the thread where the context is current
+    // so each thread collect its own context, and destroy its cleared contexts
+    m_ReleaseContexts(IAGP_GET_CURRENT_CONTEXT());
+    auto context_ptr = GetContextPtr(IAGP_GET_CURRENT_CONTEXT());
+    if (context_ptr != nullptr) {
+        context_ptr->Collect();
     }
 }
 
@@ -942,43 +3569,70 @@ void InAppGpuProfiler::DrawFlamGraph(const char* vLabel, bool* pOpen, ImGuiWindo
     DrawFlamGraphChilds(vFlags);
 
     DrawDetails(vFlags);
+
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+    DrawOverhead(vFlags);
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
 }
 
 void InAppGpuProfiler::DrawFlamGraphNoWin() {
     if (sIsActive) {
         m_DrawMenuBar();
-        for (const auto& con : m_Contexts) {
+        for (const auto& con : m_GetContextsToDraw()) {
             if (con.second != nullptr) {
-                con.second->DrawFlamGraph(m_GraphType);
+                if (m_View == InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE) {
+                    con.second->DrawFlamGraph(m_GraphType);
+                } else {
+                    con.second->DrawAggregateFlamGraph(m_View);
+                }
             }
         }
     }
 }
 
 void InAppGpuProfiler::DrawFlamGraphChilds(ImGuiWindowFlags vFlags) {
-    m_SelectedQuery.reset();
+    m_SelectedZone = InAppGpuZoneStore::sInvalidIndex;
     m_QueryZoneToClose = -1;
-    for (size_t idx = 0U; idx < iagp::InAppGpuQueryZone::sTabbedQueryZones.size(); ++idx) {
-        auto ptr = iagp::InAppGpuQueryZone::sTabbedQueryZones[idx].lock();
-        if (ptr != nullptr) {
-            bool opened = true;
-            ImGui::SetNextWindowSizeConstraints(IAGP_SUB_WINDOW_MIN_SIZE, ImGui::GetIO().DisplaySize);
-            if (m_ImGuiBeginFunctor != nullptr && m_ImGuiBeginFunctor(ptr->imGuiTitle.c_str(), &opened, vFlags)) {
-                if (sIsActive) {
-                    ptr->DrawFlamGraph(iagp::InAppGpuProfiler::Instance()->GetGraphTypeRef(), m_SelectedQuery);
-                }
-            }
-            if (m_ImGuiEndFunctor != nullptr) {
-                m_ImGuiEndFunctor();
-            }
-            if (!opened) {
-                m_QueryZoneToClose = (int32_t)idx;
+    for (size_t idx = 0U; idx < m_TabbedQueryZones.size(); ++idx) {
+        const auto& tabbed = m_TabbedQueryZones[idx];
+        auto context_ptr = tabbed.context.lock();
+        const auto& title = (context_ptr != nullptr) ? context_ptr->GetZoneTitle(tabbed.zoneIdx, tabbed.generation) : std::string();
+        if (title.empty()) {
+            m_QueryZoneToClose = (int32_t)idx;  // the zone was cleared
+            continue;
+        }
+        bool opened = true;
+        ImGui::SetNextWindowSizeConstraints(IAGP_SUB_WINDOW_MIN_SIZE, ImGui::GetIO().DisplaySize);
+        if (m_ImGuiBeginFunctor != nullptr && m_ImGuiBeginFunctor(title.c_str(), &opened, vFlags)) {
+            if (sIsActive) {
+                context_ptr->DrawFlamGraph(m_GraphType, tabbed.zoneIdx, tabbed.generation, m_SelectedZone);
             }
         }
+        if (m_ImGuiEndFunctor != nullptr) {
+            m_ImGuiEndFunctor();
+        }
+        if (!opened) {
+            m_QueryZoneToClose = (int32_t)idx;
+        }
     }
     if (m_QueryZoneToClose > -1) {
-        iagp::InAppGpuQueryZone::sTabbedQueryZones.erase(  //
-            iagp::InAppGpuQueryZone::sTabbedQueryZones.begin() + m_QueryZoneToClose);
+        m_TabbedQueryZones.erase(m_TabbedQueryZones.begin() + m_QueryZoneToClose);
+    }
+}
+
+void InAppGpuProfiler::OpenTabbedQueryZone(const IAGPContextWeak& vContext, const uint32_t vZoneIdx) {
+    auto context_ptr = vContext.lock();
+    if (context_ptr != nullptr) {
+        for (const auto& tabbed : m_TabbedQueryZones) {
+            if (tabbed.context.lock() == context_ptr && tabbed.zoneIdx == vZoneIdx) {
+                return;  // already opened
+            }
+        }
+        tabbedQueryZone tabbed;
+        tabbed.context = vContext;
+        tabbed.zoneIdx = vZoneIdx;
+        tabbed.generation = context_ptr->GetGeneration();  // called while the context is drawn, so under its lock
+        m_TabbedQueryZones.push_back(tabbed);
     }
 }
 
@@ -992,18 +3646,137 @@ void InAppGpuProfiler::SetImGuiEndFunctor(const ImGuiEndFunctor& vImGuiEndFuncto
 
 void InAppGpuProfiler::m_DrawMenuBar() {
     if (ImGui::BeginMenuBar()) {
-        if (InAppGpuScopedZone::sMaxDepth) {
-            InAppGpuQueryZone::sMaxDepthToOpen = InAppGpuScopedZone::sMaxDepth;
+        uint32_t max_depth = 0U;
+        for (const auto& con : m_GetContextsToDraw()) {
+            if (con.second != nullptr && con.second->GetMaxDepth() > max_depth) {
+                max_depth = con.second->GetMaxDepth();
+            }
+        }
+        if (max_depth) {
+            InAppGpuQueryZone::sMaxDepthToOpen = max_depth;
         }
 
-        IAGP_IMGUI_PLAY_PAUSE_BUTTON(sIsPaused);
+        // the button work on a copy, and only a click is written, so a pause of a trigger is never lost
+        bool is_paused = sIsPaused.load(std::memory_order_acquire);
+        if (IAGP_IMGUI_PLAY_PAUSE_BUTTON(is_paused)) {
+            sIsPaused.store(is_paused, std::memory_order_release);
+        }
 
         if (IAGP_IMGUI_BUTTON("Details")) {
             m_ShowDetails = !m_ShowDetails;
         }
 
-#ifdef IAGP_DEV_MODE
-        ImGui::Checkbox("Logging", &InAppGpuQueryZone::sActivateLogger);
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+        if (IAGP_IMGUI_BUTTON("Overhead")) {
+            m_ShowOverhead = !m_ShowOverhead;
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Show the cpu time and the memory of the profiler");
+        }
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
+        constexpr bool is_runtime_smoothing = std::is_same<InAppGpuSmoothing, InAppGpuRuntimeSmoothing>::value;
+        if ((is_runtime_smoothing || std::is_same<InAppGpuSmoothing, InAppGpuEmaSmoothing>::value) && ImGui::BeginMenu("Smoothing")) {
+            if (is_runtime_smoothing) {
+                auto& smoothing = InAppGpuRuntimeSmoothing::sSmoothing;
+                if (ImGui::MenuItem("Ema", nullptr, smoothing == InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_EMA)) {
+                    smoothing = InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_EMA;
+                }
+                if (ImGui::MenuItem("Mean", nullptr, smoothing == InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_MEAN)) {
+                    smoothing = InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_MEAN;
+                }
+                if (ImGui::MenuItem("Median", nullptr, smoothing == InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_MEDIAN)) {
+                    smoothing = InAppGpuSmoothingEnum::IN_APP_GPU_SMOOTHING_MEDIAN;
+                }
+            }
+            ImGui::SliderFloat("Ema factor", &InAppGpuEmaSmoothing::sFactor, 0.001f, 1.0f);
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Sampling")) {
+            auto& mode = sSamplingMode;
+            if (ImGui::MenuItem("All frames", nullptr, mode == InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ALL)) {
+                mode = InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ALL;
+            }
+            if (ImGui::MenuItem("Nth frame", nullptr, mode == InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_FRAMES)) {
+                mode = InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_FRAMES;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Record only one frame on the period");
+            }
+            if (ImGui::MenuItem("Subtrees", nullptr, mode == InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_SUBTREES)) {
+                mode = InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_SUBTREES;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Record each frame one of the subtrees of the root, in rotation on the period");
+            }
+            if (ImGui::MenuItem("Adaptive", nullptr, mode == InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ADAPTIVE)) {
+                mode = InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ADAPTIVE;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Adapt the period of frames for keep the cpu time of the profiler under the budget");
+            }
+            ImGui::SliderInt("Period", &sSamplingPeriod, 1, (int)IAGP_SAMPLING_MAX_PERIOD);
+            ImGui::SliderFloat("Budget (us)", &sSamplingBudget, 1.0f, 1000.0f);
+            if (mode == InAppGpuSamplingEnum::IN_APP_GPU_SAMPLING_ADAPTIVE) {
+                for (const auto& con : m_GetContextsToDraw()) {
+                    if (con.second != nullptr) {
+                        ImGui::Text("Context %p : period %u, %.1f us / frame", (void*)con.first, con.second->GetSamplingPeriod(),
+                                    con.second->GetSamplingCost());
+                    }
+                }
+            }
+            ImGui::EndMenu();
+        }
+
+        if (IAGP_IMGUI_BUTTON("Reset stats")) {
+            ResetStatistics();
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Reset the min, max and percentiles of the zones");
+        }
+
+        ImGui::Checkbox("Cpu", &InAppGpuQueryZone::sShowCpuTrack);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Show the cpu time of the zones under the gpu time");
+        }
+
+        ImGui::Checkbox("Lod", &InAppGpuQueryZone::sUseLod);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Merge the bars too small in the flame graph, and skip the labels who can't be shown");
+        }
+
+        ImGui::Checkbox("History", &InAppGpuQueryZone::sShowFrameHistory);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Show the times of the last frames, a click on a frame show its exact times");
+        }
+
+        m_DrawCapturesMenu();
+
+        if (ImGui::BeginMenu("Views")) {
+            if (ImGui::MenuItem("Timeline", nullptr, m_View == InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE)) {
+                m_View = InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE;
+            }
+            if (ImGui::MenuItem("Bottom up", nullptr, m_View == InAppGpuViewEnum::IN_APP_GPU_VIEW_BOTTOM_UP)) {
+                m_View = InAppGpuViewEnum::IN_APP_GPU_VIEW_BOTTOM_UP;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("The self times of the zones by name, then by callers");
+            }
+            if (ImGui::MenuItem("Merged by name", nullptr, m_View == InAppGpuViewEnum::IN_APP_GPU_VIEW_MERGED)) {
+                m_View = InAppGpuViewEnum::IN_APP_GPU_VIEW_MERGED;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("The times of the zones by name over all their parents, then by childs");
+            }
+            if (ImGui::MenuItem("Sections", nullptr, m_View == InAppGpuViewEnum::IN_APP_GPU_VIEW_SECTIONS)) {
+                m_View = InAppGpuViewEnum::IN_APP_GPU_VIEW_SECTIONS;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("The self times of the zones by section, then by name");
+            }
+            ImGui::EndMenu();
+        }
 
         if (ImGui::BeginMenu("Graph Types")) {
             if (ImGui::MenuItem("Horizontal", nullptr, m_GraphType == iagp::InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL)) {
@@ -1014,6 +3787,20 @@ void InAppGpuProfiler::m_DrawMenuBar() {
             }
             ImGui::EndMenu();
         }
+
+#ifdef IAGP_DEV_MODE
+        ImGui::Checkbox("Logging", &InAppGpuQueryZone::sActivateLogger);
+
+        if (ImGui::BeginMenu("Query Pools")) {
+            for (const auto& con : m_ContextsToDraw) {
+                if (con.second != nullptr) {
+                    const auto& stats = con.second->GetQueryPoolStats();
+                    ImGui::Text("Context %p : capacity %u | in use %u | high water %u | chunks %u",  //
+                                (void*)con.first, stats.capacity, stats.inUse, stats.highWater, stats.chunksCount);
+                }
+            }
+            ImGui::EndMenu();
+        }
 #endif
 
         ImGui::EndMenuBar();
@@ -1031,12 +3818,71 @@ void InAppGpuProfiler::DrawDetails(ImGuiWindowFlags vFlags) {
     }
 }
 
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+void InAppGpuProfiler::DrawOverhead(ImGuiWindowFlags vFlags) {
+    if (m_ShowOverhead) {
+        if (m_ImGuiBeginFunctor != nullptr && m_ImGuiBeginFunctor(IAGP_OVERHEAD_TITLE, &m_ShowOverhead, vFlags)) {
+            DrawOverheadNoWin();
+        }
+        if (m_ImGuiEndFunctor != nullptr) {
+            m_ImGuiEndFunctor();
+        }
+    }
+}
+
+void InAppGpuProfiler::DrawOverheadNoWin() {
+    m_Overhead.Update(ImGui::GetFrameCount());
+    static ImGuiTableFlags flags =        //
+        ImGuiTableFlags_SizingFixedFit |  //
+        ImGuiTableFlags_RowBg |           //
+        ImGuiTableFlags_NoHostExtendY;
+    if (ImGui::BeginTable("##InAppGpuProfiler_DrawOverhead", 4, flags)) {
+        ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Calls / frame");
+        ImGui::TableSetupColumn("Time / frame");
+        ImGui::TableSetupColumn("Time / call");
+        ImGui::TableHeadersRow();
+        double total_time = 0.0;
+        for (int32_t idx = 0; idx < (int32_t)IN_APP_GPU_OVERHEAD_Count; ++idx) {
+            const auto counter = (InAppGpuOverheadEnum)idx;
+            const double calls = m_Overhead.GetFrameCalls(counter);
+            const double time = m_Overhead.GetFrameTime(counter);
+            if (counter != InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_GET_QUERY_ZONE) {  // already in the scope begin
+                total_time += time;
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", InAppGpuOverhead::GetName(counter));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f us", time);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f ns", (calls > 0.0) ? time * 1e3 / calls : 0.0);
+        }
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("Total");
+        ImGui::TableNextColumn();
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f us", total_time);
+        ImGui::EndTable();
+    }
+    for (const auto& con : m_GetContextsToDraw()) {
+        if (con.second != nullptr) {
+            ImGui::Text("Context %p : %u zones, %.1f KB held by the zone tree, %u queries", (void*)con.first, con.second->GetZoneStore().size(),
+                        (double)con.second->GetZoneTreeBytes() / 1024.0, con.second->GetQueryPoolStats().capacity);
+        }
+    }
+}
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
 void InAppGpuProfiler::DrawDetailsNoWin() {
     if (!sIsActive) {
         return;
     }
 
-    int32_t count_tables = 5;
+    int32_t count_tables = 15;
 #ifdef IAGP_SHOW_COUNT
     ++count_tables;
 #endif
@@ -1046,39 +3892,101 @@ void InAppGpuProfiler::DrawDetailsNoWin() {
         ImGuiTableFlags_RowBg |           //
         ImGuiTableFlags_Hideable |        //
         ImGuiTableFlags_ScrollY |         //
+        ImGuiTableFlags_Sortable |        //
+        ImGuiTableFlags_SortTristate |    //
         ImGuiTableFlags_NoHostExtendY;
     const auto& size = ImGui::GetContentRegionAvail();
     auto listViewID = ImGui::GetID("##InAppGpuProfiler_DrawDetails");
     if (ImGui::BeginTableEx("##InAppGpuProfiler_DrawDetails", listViewID, count_tables, flags, size, 0.0f)) {
-        ImGui::TableSetupColumn("Tree", ImGuiTableColumnFlags_WidthStretch);
+        // the user id of the columns is their InAppGpuDetailsColumnEnum
+        const ImGuiTableColumnFlags time_flags = ImGuiTableColumnFlags_PreferSortDescending;
+        ImGui::TableSetupColumn("Tree", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort, 0.0f, IN_APP_GPU_DETAILS_TREE);
 #ifdef IAGP_SHOW_COUNT
-        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("Count", time_flags, 0.0f, IN_APP_GPU_DETAILS_COUNT);
 #endif
-        ImGui::TableSetupColumn("Elapsed time");
-        ImGui::TableSetupColumn("Max fps");
-        ImGui::TableSetupColumn("Start time", ImGuiTableColumnFlags_DefaultHide);
-        ImGui::TableSetupColumn("End time", ImGuiTableColumnFlags_DefaultHide);
+        ImGui::TableSetupColumn("Gpu time", time_flags, 0.0f, IN_APP_GPU_DETAILS_GPU_TIME);
+        ImGui::TableSetupColumn("Cpu time", time_flags, 0.0f, IN_APP_GPU_DETAILS_CPU_TIME);
+        ImGui::TableSetupColumn("Gpu min", time_flags | ImGuiTableColumnFlags_DefaultHide, 0.0f, IN_APP_GPU_DETAILS_GPU_MIN);
+        ImGui::TableSetupColumn("Gpu p50", time_flags, 0.0f, IN_APP_GPU_DETAILS_GPU_P50);
+        ImGui::TableSetupColumn("Gpu p95", time_flags, 0.0f, IN_APP_GPU_DETAILS_GPU_P95);
+        ImGui::TableSetupColumn("Gpu p99", time_flags, 0.0f, IN_APP_GPU_DETAILS_GPU_P99);
+        ImGui::TableSetupColumn("Gpu max", time_flags | ImGuiTableColumnFlags_DefaultHide, 0.0f, IN_APP_GPU_DETAILS_GPU_MAX);
+        ImGui::TableSetupColumn("Max fps", time_flags, 0.0f, IN_APP_GPU_DETAILS_MAX_FPS);
+        ImGui::TableSetupColumn("Start time", ImGuiTableColumnFlags_DefaultHide, 0.0f, IN_APP_GPU_DETAILS_START_TIME);
+        ImGui::TableSetupColumn("End time", ImGuiTableColumnFlags_DefaultHide, 0.0f, IN_APP_GPU_DETAILS_END_TIME);
+        ImGui::TableSetupColumn("Calls", time_flags, 0.0f, IN_APP_GPU_DETAILS_CALLS);
+        ImGui::TableSetupColumn("Call min", time_flags | ImGuiTableColumnFlags_DefaultHide, 0.0f, IN_APP_GPU_DETAILS_CALL_MIN);
+        ImGui::TableSetupColumn("Call mean", time_flags, 0.0f, IN_APP_GPU_DETAILS_CALL_MEAN);
+        ImGui::TableSetupColumn("Call max", time_flags | ImGuiTableColumnFlags_DefaultHide, 0.0f, IN_APP_GPU_DETAILS_CALL_MAX);
+        ImGui::TableSetupScrollFreeze(0, 1);  // the headers stay visible
         ImGui::TableHeadersRow();
-        for (const auto& con : m_Contexts) {
+        auto sort_column = InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_TREE;
+        bool sort_descending = false;
+        const ImGuiTableSortSpecs* sort_specs_ptr = ImGui::TableGetSortSpecs();
+        if (sort_specs_ptr != nullptr && sort_specs_ptr->SpecsCount > 0) {
+            const auto& spec = sort_specs_ptr->Specs[0];
+            if (spec.ColumnUserID < (ImGuiID)IN_APP_GPU_DETAILS_Count) {
+                sort_column = (InAppGpuDetailsColumnEnum)spec.ColumnUserID;
+                sort_descending = (spec.SortDirection == ImGuiSortDirection_Descending);
+            }
+        }
+        for (const auto& con : m_GetContextsToDraw()) {
             if (con.second != nullptr) {
-                con.second->DrawDetails();
+                if (m_View == InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE) {
+                    con.second->DrawDetails(sort_column, sort_descending);
+                } else {
+                    con.second->DrawAggregateDetails(m_View, sort_column, sort_descending);
+                }
             }
         }
         ImGui::EndTable();
     }
 }
 
+void InAppGpuProfiler::ResetStatistics() {
+    for (const auto& con : m_GetContextsToDraw()) {
+        if (con.second != nullptr) {
+            con.second->ResetStatistics();
+        }
+    }
+}
+
 IAGPContextPtr InAppGpuProfiler::GetContextPtr(IAGP_GPU_CONTEXT vThreadPtr) {
     if (!sIsActive) {
         return nullptr;
     }
 
     if (vThreadPtr != nullptr) {
-        if (m_Contexts.find((intptr_t)vThreadPtr) == m_Contexts.end()) {
-            m_Contexts[(intptr_t)vThreadPtr] = InAppGpuGLContext::create(vThreadPtr);
+        // each thread keep the last context it used, so the scopes dont lock the contexts map
+        // the ref is weak, so a thread never destroy a context it dont own (at its exit for instance)
+        struct threadContext {
+            IAGP_GPU_CONTEXT context = nullptr;
+            IAGPContextWeak contextPtr;
+            uint32_t generation = 0U;
+        };
+        static thread_local threadContext sThreadContext;
+        const uint32_t generation = m_ContextsGeneration.load(std::memory_order_acquire);
+        if (sThreadContext.context == vThreadPtr && sThreadContext.generation == generation) {
+            auto res = sThreadContext.contextPtr.lock();
+            if (res != nullptr) {
+                return res;
+            }
         }
 
-        return m_Contexts[(intptr_t)vThreadPtr];
+        m_ReleaseContexts(vThreadPtr);
+        IAGPContextPtr res = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_ContextsMutex);
+            auto& context_ptr = m_Contexts[(intptr_t)vThreadPtr];
+            if (context_ptr == nullptr) {
+                context_ptr = InAppGpuGLContext::create(vThreadPtr);
+            }
+            res = context_ptr;
+        }
+        sThreadContext.context = vThreadPtr;
+        sThreadContext.contextPtr = res;
+        sThreadContext.generation = generation;
+        return res;
     }
 
     IAGP_LOG_ERROR_MESSAGE("GPU_CONTEXT vThreadPtr is NULL");
@@ -1086,57 +3994,346 @@ IAGPContextPtr InAppGpuProfiler::GetContextPtr(IAGP_GPU_CONTEXT vThreadPtr) {
     return nullptr;
 }
 
+void InAppGpuProfiler::m_ReleaseContexts(IAGP_GPU_CONTEXT vThreadPtr) {
+    if (m_ContextsToReleaseCount.load(std::memory_order_acquire) == 0U) {
+        return;
+    }
+    std::vector<IAGPContextPtr> contexts_to_release;  // destroyed after the unlock, here where the context is current
+    std::lock_guard<std::mutex> lock(m_ContextsMutex);
+    for (auto it = m_ContextsToRelease.begin(); it != m_ContextsToRelease.end();) {
+        // a context still used elsewhere (ui, collector thread) is released at a next call
+        if (it->first == (intptr_t)vThreadPtr && it->second.use_count() == 1) {
+            contexts_to_release.push_back(std::move(it->second));
+            it = m_ContextsToRelease.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_ContextsToReleaseCount.store((uint32_t)m_ContextsToRelease.size(), std::memory_order_release);
+}
+
+void InAppGpuProfiler::OnFrameCollected(IAGP_GPU_CONTEXT vContext, const uint32_t vGeneration, const uint64_t vFrameId, InAppGpuZoneStore& vStore,
+                                        const std::vector<InAppGpuCollectedZone>& vZones) {
+    // called by the thread collecting the context, under the lock of the context
+#ifdef IAGP_USE_FLIGHT_RECORDER
+    m_FlightRecorder.RecordFrame((uint64_t)(intptr_t)vContext, vGeneration, vFrameId, vStore, vZones);
+#else
+    (void)vGeneration;  // only used by the flight recorder
+#endif  // IAGP_USE_FLIGHT_RECORDER
+    if (m_IsTraceExporting.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(m_TraceExporterMutex);
+        if (vFrameId >= m_TraceFirstFrameId && vFrameId <= m_TraceLastFrameId) {
+            m_TraceExporter.AddFrame(vZones);
+            for (const auto& zone : vZones) {
+                const auto& query_zone = vStore.zones[zone.zoneIdx];
+                m_TraceExporter.AddZone((uint64_t)(intptr_t)vContext, vFrameId, query_zone.sectionName, query_zone.name, zone);
+            }
+        }
+    }
+}
+
+bool InAppGpuProfiler::StartTraceExport(const std::string& vFilePathName, const uint64_t vFirstFrameId, const uint64_t vLastFrameId) {
+    std::lock_guard<std::mutex> lock(m_TraceExporterMutex);
+    if (!m_TraceExporter.Open(vFilePathName)) {
+        return false;
+    }
+    m_TraceFirstFrameId = vFirstFrameId;
+    m_TraceLastFrameId = vLastFrameId;
+    m_IsTraceExporting.store(true, std::memory_order_release);
+    return true;
+}
+
+void InAppGpuProfiler::StopTraceExport() {
+    m_IsTraceExporting.store(false, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(m_TraceExporterMutex);
+    m_TraceExporter.Close();
+}
+
+bool InAppGpuProfiler::IsTraceExporting() const {
+    return m_IsTraceExporting.load(std::memory_order_acquire);
+}
+
+uint32_t InAppGpuProfiler::AddTriggerRule(const InAppGpuTriggerRule& vRule) {
+    std::lock_guard<std::mutex> lock(m_TriggersMutex);
+    if (m_TriggerRules.size() >= 32U) {
+        IAGP_LOG_ERROR_MESSAGE("%s", "the trigger rules are limited to 32");
+        return InAppGpuZoneStore::sInvalidIndex;
+    }
+    m_TriggerRules.push_back(vRule);
+    ++m_TriggerRulesVersion;
+    return (uint32_t)m_TriggerRules.size() - 1U;
+}
+
+void InAppGpuProfiler::ClearTriggerRules() {
+    std::lock_guard<std::mutex> lock(m_TriggersMutex);
+    m_TriggerRules.clear();
+    ++m_TriggerRulesVersion;
+}
+
+uint32_t InAppGpuProfiler::GetTriggerRulesVersion() const {
+    return m_TriggerRulesVersion.load(std::memory_order_acquire);
+}
+
+void InAppGpuProfiler::GetTriggerRules(std::vector<InAppGpuTriggerRule>& vOutRules, uint32_t& vOutVersion) {
+    std::lock_guard<std::mutex> lock(m_TriggersMutex);
+    vOutRules = m_TriggerRules;
+    vOutVersion = m_TriggerRulesVersion.load(std::memory_order_acquire);
+}
+
+void InAppGpuProfiler::AddCapture(InAppGpuCapture& vCapture) {
+    // called by the thread collecting the context, under the lock of the context
+    std::lock_guard<std::mutex> lock(m_TriggersMutex);
+    if (m_Captures.size() >= IAGP_CAPTURES_COUNT) {
+        m_Captures.erase(m_Captures.begin());
+    }
+    m_Captures.push_back(std::move(vCapture));
+}
+
+std::vector<InAppGpuCapture> InAppGpuProfiler::GetCaptures() {
+    std::lock_guard<std::mutex> lock(m_TriggersMutex);
+    return m_Captures;
+}
+
+void InAppGpuProfiler::ClearCaptures() {
+    std::lock_guard<std::mutex> lock(m_TriggersMutex);
+    m_Captures.clear();
+}
+
+void InAppGpuProfiler::m_DrawCapturesMenu() {
+    // the context is locked after the captures, because the collecting threads lock the context then the captures
+    IAGPContextPtr context_ptr = nullptr;
+    InAppGpuHistoryFrame frame_to_inspect;
+    {
+        std::lock_guard<std::mutex> lock(m_TriggersMutex);
+        if (!ImGui::BeginMenu(toStr("Captures (%u)###Captures", (uint32_t)m_Captures.size()).c_str())) {
+            return;
+        }
+        for (size_t capture_idx = 0U; capture_idx < m_Captures.size(); ++capture_idx) {
+            const auto& capture = m_Captures[capture_idx];
+            ImGui::PushID((int)capture_idx);
+            const auto label = toStr("Frame [%u] : %s %.5f ms > %.5f ms", (uint32_t)capture.frameId, capture.zoneName.c_str(), capture.time, capture.limit);
+            if (ImGui::BeginMenu(label.c_str())) {
+                for (const auto& frame : capture.frames) {
+                    if (ImGui::MenuItem(toStr("Frame [%u] : %.5f ms", (uint32_t)frame.frameId, frame.elapsedTime).c_str(), nullptr,
+                                        frame.frameId == capture.frameId)) {
+                        context_ptr = capture.context.lock();
+                        frame_to_inspect = frame;
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            ImGui::PopID();
+        }
+        ImGui::Separator();
+        if (ImGui::MenuItem("Clear")) {
+            m_Captures.clear();
+        }
+        ImGui::EndMenu();
+    }
+    if (context_ptr != nullptr) {
+        if (!context_ptr->InspectFrame(frame_to_inspect)) {
+            IAGP_LOG_ERROR_MESSAGE("%s", "the zones of the capture was cleared");
+        }
+    }
+}
+
+#ifdef IAGP_USE_FLIGHT_RECORDER
+bool InAppGpuProfiler::StartFlightRecorder(const std::string& vFilePathName, const size_t vSize) {
+    return m_FlightRecorder.Open(vFilePathName, vSize);
+}
+
+void InAppGpuProfiler::StopFlightRecorder() {
+    m_FlightRecorder.Close();
+}
+
+InAppGpuFlightRecorder& InAppGpuProfiler::GetFlightRecorderRef() {
+    return m_FlightRecorder;
+}
+
+bool InAppGpuProfiler::ExportFlightRecorderToTrace(const std::string& vRecorderFilePathName, const std::string& vTraceFilePathName,
+                                                   const uint64_t vFirstFrameId, const uint64_t vLastFrameId) {
+    InAppGpuTraceExporter exporter;
+    if (!exporter.Open(vTraceFilePathName)) {
+        return false;
+    }
+    // the names are given before the frames, the frames are written one by one
+    std::unordered_map<uint64_t, InAppGpuFlightRecorder::recordedName> names;
+    const auto get_key = [](const uint64_t vContext, const uint32_t vGeneration, const uint32_t vZoneIdx) {
+        return vContext * 1099511628211ULL ^ ((uint64_t)vGeneration << 32U) ^ (uint64_t)vZoneIdx;
+    };
+    const auto name_functor = [&names, &get_key](const InAppGpuFlightRecorder::recordedName& vName) {
+        names[get_key(vName.context, vName.generation, vName.zoneIdx)] = vName;
+    };
+    const std::string unknown = "?";
+    const auto frame_functor = [&](const InAppGpuFlightRecorder::recordedFrame& vFrame) {
+        if (vFrame.frameId < vFirstFrameId || vFrame.frameId > vLastFrameId) {
+            return;
+        }
+        exporter.AddFrame(vFrame.zones);
+        for (const auto& zone : vFrame.zones) {
+            const auto it = names.find(get_key(vFrame.context, vFrame.generation, zone.zoneIdx));
+            if (it != names.end()) {
+                exporter.AddZone(vFrame.context, vFrame.frameId, it->second.section, it->second.name, zone);
+            } else {  // the string table was full
+                exporter.AddZone(vFrame.context, vFrame.frameId, unknown, unknown, zone);
+            }
+        }
+    };
+    const bool res = InAppGpuFlightRecorder::Load(vRecorderFilePathName, name_functor, frame_functor);
+    exporter.Close();
+    return res;
+}
+#endif  // IAGP_USE_FLIGHT_RECORDER
+
+#ifdef IAGP_USE_COLLECTOR_THREAD
+bool InAppGpuProfiler::StartCollectorThread(IAGP_GPU_CONTEXT vSharedContext) {
+    if (vSharedContext == nullptr) {
+        IAGP_LOG_ERROR_MESSAGE("the collector thread need a context shared with the profiled contexts");
+        return false;
+    }
+    if (m_CollectorThread.joinable()) {
+        return false;  // already started
+    }
+    m_CollectorStopped = false;
+    m_CollectorRunning = true;
+    m_CollectorThread = std::thread(&InAppGpuProfiler::m_CollectorLoop, this, vSharedContext);
+    return true;
+}
+
+void InAppGpuProfiler::StopCollectorThread() {
+    if (m_CollectorThread.joinable()) {
+        m_CollectorRunning = false;
+        m_CollectorThread.join();
+    }
+}
+
+bool InAppGpuProfiler::IsCollectorThreadRunning() const {
+    return m_CollectorRunning.load(std::memory_order_acquire);
+}
+
+bool InAppGpuProfiler::IsCollectorThreadStopped() const {
+    return m_CollectorStopped.load(std::memory_order_acquire);
+}
+
+void InAppGpuProfiler::m_CollectorLoop(IAGP_GPU_CONTEXT vSharedContext) {
+    // the fences and the buffers are shared, so this context can wait and read them
+    IAGP_SET_CURRENT_CONTEXT(vSharedContext);
+    std::vector<IAGPContextPtr> contexts;
+    const auto get_contexts = [this, &contexts]() {
+        std::lock_guard<std::mutex> lock(m_ContextsMutex);
+        contexts.clear();
+        for (const auto& con : m_Contexts) {
+            if (con.second != nullptr) {
+                contexts.push_back(con.second);
+            }
+        }
+    };
+    while (m_CollectorRunning.load(std::memory_order_acquire)) {
+        get_contexts();
+        bool collected = false;
+        for (const auto& context_ptr : contexts) {
+            collected |= context_ptr->CollectFromThread();
+        }
+        if (!collected) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(IAGP_COLLECTOR_WAIT_TIMEOUT));
+        }
+    }
+    // the frames not collected are released, so the contexts can record in their slots again
+    get_contexts();
+    for (const auto& context_ptr : contexts) {
+        context_ptr->ReleaseCollectorFrames();
+    }
+    contexts.clear();
+    IAGP_SET_CURRENT_CONTEXT(nullptr);
+    m_CollectorStopped.store(true, std::memory_order_release);
+}
+#endif  // IAGP_USE_COLLECTOR_THREAD
+
+const std::vector<std::pair<intptr_t, IAGPContextPtr>>& InAppGpuProfiler::m_GetContextsToDraw() {
+    // the ui draw a copy, so the recording threads can register a context in same time
+    std::lock_guard<std::mutex> lock(m_ContextsMutex);
+    if (m_ContextsToDraw.size() != m_Contexts.size()) {
+        m_ContextsToDraw.assign(m_Contexts.begin(), m_Contexts.end());
+    }
+    return m_ContextsToDraw;
+}
+
 ////////////////////////////////////////////////////////////
 /////////////////////// SCOPED ZONE ////////////////////////
 ////////////////////////////////////////////////////////////
 
-// STATIC
-uint32_t InAppGpuScopedZone::sCurrentDepth = 0U;
-uint32_t InAppGpuScopedZone::sMaxDepth = 0U;
-
 // SCOPED ZONE
 InAppGpuScopedZone::InAppGpuScopedZone(const bool vIsRoot, const void* vPtr, const std::string& vSection, const char* fmt, ...) {
     if (InAppGpuProfiler::sIsActive) {
+        IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_SCOPE_BEGIN);
         va_list args;
         va_start(args, fmt);
-        static char TempBuffer[256];
+        static thread_local char TempBuffer[256];
         const int w = vsnprintf(TempBuffer, 256, fmt, args);
         va_end(args);
-        if (w) {
+        if (w > 0) {
             auto context_ptr = InAppGpuProfiler::Instance()->GetContextPtr(IAGP_GET_CURRENT_CONTEXT());
             if (context_ptr != nullptr) {
-                const auto& label = std::string(TempBuffer, (size_t)w);
-                queryPtr = context_ptr->GetQueryZoneForName(vPtr, label, vSection, vIsRoot);
-                if (queryPtr != nullptr) {
-                    glQueryCounter(queryPtr->ids[0], GL_TIMESTAMP);
-#ifdef IAGP_DEBUG_MODE_LOGGING
-                    IAGP_DEBUG_MODE_LOGGING("%*s begin : [%u:%u] (depth:%u) (%s)",  //
-                                       queryPtr->depth, "", queryPtr->ids[0], queryPtr->ids[1], queryPtr->depth, label.c_str());
-#endif
-                    sCurrentDepth++;
-                }
+                const auto& label = std::string(TempBuffer, (size_t)ImMin(w, 255));  // vsnprintf return the untruncated size
+                zoneIdx = context_ptr->GetQueryZoneForName(vPtr, label, vSection, vIsRoot);
+                m_Start(context_ptr);
             }
         }
     }
 }
 
-InAppGpuScopedZone::~InAppGpuScopedZone() {
+InAppGpuScopedZone::InAppGpuScopedZone(const bool vIsRoot, const void* vPtr, InAppGpuCallSite* vCallSite, ...) {
     if (InAppGpuProfiler::sIsActive) {
-        if (queryPtr != nullptr) {
-#ifdef IAGP_DEBUG_MODE_LOGGING
-            if (queryPtr->depth > 0) {
-                IAGP_DEBUG_MODE_LOGGING("%*s end : [%u:%u] (depth:%u)",  //
-                                        (queryPtr->depth - 1U), "", queryPtr->ids[0], queryPtr->ids[1], queryPtr->depth);
+        IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_SCOPE_BEGIN);
+        auto context_ptr = InAppGpuProfiler::Instance()->GetContextPtr(IAGP_GET_CURRENT_CONTEXT());
+        if (context_ptr != nullptr) {
+            if (vCallSite->hasArgs) {
+                // the label change with the args, so we need to format it and hash it
+                va_list args;
+                va_start(args, vCallSite);
+                static thread_local char TempBuffer[256];
+                const int w = vsnprintf(TempBuffer, 256, vCallSite->fmt, args);
+                va_end(args);
+                if (w > 0) {
+                    const auto& label = std::string(TempBuffer, (size_t)ImMin(w, 255));  // vsnprintf return the untruncated size
+                    zoneIdx = context_ptr->GetQueryZoneForName(vPtr, label, vCallSite->section, vIsRoot);
+                }
             } else {
-                IAGP_DEBUG_MODE_LOGGING("end : [%u:%u] (depth:%u)",  //
-                                        queryPtr->ids[0], queryPtr->ids[1], 0);
+                zoneIdx = context_ptr->GetQueryZoneForCallSite(vPtr, *vCallSite, vIsRoot);
             }
+            m_Start(context_ptr);
+        }
+    }
+}
+
+InAppGpuScopedZone::~InAppGpuScopedZone() {
+    if (contextPtr != nullptr) {
+        IAGP_OVERHEAD_TIMER(IN_APP_GPU_OVERHEAD_SCOPE_END);
+        // the depth is the one of the context, even if the thread have changed of context in the scope
+        auto& depth = contextPtr->GetCurrentDepthRef();
+        --depth;
+#ifdef IAGP_DEBUG_MODE_LOGGING
+        IAGP_DEBUG_MODE_LOGGING("%*s end : [zone:%u] (depth:%u)",  //
+                                depth, "", zoneIdx, depth);
 #endif
-            glQueryCounter(queryPtr->ids[1], GL_TIMESTAMP);
-            ++queryPtr->current_count;
-            --sCurrentDepth;
+        if (InAppGpuProfiler::sIsActive) {
+            contextPtr->WriteEndTimeStamp(zoneIdx, generation);
         }
     }
 }
 
+void InAppGpuScopedZone::m_Start(const IAGPContextPtr& vContextPtr) {
+    if (zoneIdx != InAppGpuZoneStore::sInvalidIndex) {
+        contextPtr = vContextPtr;
+        generation = contextPtr->GetGeneration();
+        contextPtr->WriteStartTimeStamp(zoneIdx, generation);
+        auto& depth = contextPtr->GetCurrentDepthRef();
+#ifdef IAGP_DEBUG_MODE_LOGGING
+        IAGP_DEBUG_MODE_LOGGING("%*s begin : [zone:%u] (depth:%u) (%s)",  //
+                                depth, "", zoneIdx, depth, contextPtr->GetZoneStore().zones[zoneIdx].name.c_str());
+#endif
+        ++depth;
+    }
+}
+
 }  // namespace iagp
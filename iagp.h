@@ -48,30 +48,57 @@ SOFTWARE.
 #include CUSTOM_IN_APP_GPU_PROFILER_CONFIG
 #endif // CUSTOM_IN_APP_GPU_PROFILER_CONFIG
 
-#include <set>
 #include <cmath>
 #include <array>
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <string>
 #include <functional>
 #include <unordered_map>
 
+#if defined(IAGP_USE_COLLECTOR_THREAD) || defined(IAGP_USE_VULKAN)
+#include <chrono>
+#include <thread>
+#endif  // IAGP_USE_COLLECTOR_THREAD || IAGP_USE_VULKAN
+
+#ifdef IAGP_NO_OPENGL
+// the opengl types used by the profiler, when there is no opengl header
+typedef unsigned int GLuint;
+typedef int GLsizei;
+typedef uint64_t GLuint64;
+typedef struct __GLsync* GLsync;
+#endif  // IAGP_NO_OPENGL
+
 #ifndef IMGUI_DEFINE_MATH_OPERATORS
 #define IMGUI_DEFINE_MATH_OPERATORS
 #endif // IMGUI_DEFINE_MATH_OPERATORS
 
+// the static data of the call site, the section and the format must be string literals
+// the hash of the label is computed at compile time
+// the cached zones are per thread, since two threads can record the same call site in two contexts
+#define IAGP_CALL_SITE(name, section, fmt)                                            \
+    static constexpr uint64_t name##Hash = iagp::HashZoneLabel(section, fmt); \
+    static thread_local iagp::InAppGpuCallSite name(section, fmt, name##Hash, iagp::HasFormatArgs(fmt))
+
 // a main zone for the frame must always been defined for the frame
-#define IAGPNewFrame(section, fmt, ...)  \
-    auto __IAGP__ScopedMainZone = iagp::InAppGpuScopedZone(true, nullptr, section, fmt, ##__VA_ARGS__); \
+// its call site have its own name, so a IAGPScoped can be in the same scope
+#define IAGPNewFrame(section, fmt, ...)                                                                           \
+    IAGP_CALL_SITE(__IAGP__MainCallSite, section, fmt);                                                           \
+    auto __IAGP__ScopedMainZone = iagp::InAppGpuScopedZone(true, nullptr, &__IAGP__MainCallSite, ##__VA_ARGS__); \
     (void)__IAGP__ScopedMainZone
 
-#define IAGPScoped(section, fmt, ...)                                                          \
-    auto __IAGP__ScopedSubZone = iagp::InAppGpuScopedZone(false, nullptr, section, fmt, ##__VA_ARGS__); \
+#define IAGPScoped(section, fmt, ...)                                                                          \
+    IAGP_CALL_SITE(__IAGP__SubCallSite, section, fmt);                                                         \
+    auto __IAGP__ScopedSubZone = iagp::InAppGpuScopedZone(false, nullptr, &__IAGP__SubCallSite, ##__VA_ARGS__); \
     (void)__IAGP__ScopedSubZone
 
-#define IAGPScopedPtr(ptr, section, fmt, ...)                                                                   \
-    auto __IAGP__ScopedSubZone = iagp::InAppGpuScopedZone(false, ptr, section, fmt, ##__VA_ARGS__); \
+#define IAGPScopedPtr(ptr, section, fmt, ...)                                                              \
+    IAGP_CALL_SITE(__IAGP__SubCallSite, section, fmt);                                                     \
+    auto __IAGP__ScopedSubZone = iagp::InAppGpuScopedZone(false, ptr, &__IAGP__SubCallSite, ##__VA_ARGS__); \
     (void)__IAGP__ScopedSubZone
 
 #define IAGPCollect iagp::InAppGpuProfiler::Instance()->Collect()
@@ -84,74 +111,761 @@ SOFTWARE.
 #define IAGP_MEAN_AVERAGE_LEVELS_COUNT 60U
 #endif  // MEAN_AVERAGE_LEVELS_COUNT
 
+#ifndef IAGP_MEDIAN_LEVELS_COUNT
+#define IAGP_MEDIAN_LEVELS_COUNT 15U
+#endif  // IAGP_MEDIAN_LEVELS_COUNT
+
+#ifndef IAGP_SMOOTHING_POLICY
+#define IAGP_SMOOTHING_POLICY InAppGpuEmaSmoothing
+#endif  // IAGP_SMOOTHING_POLICY
+
+#ifndef IAGP_CALL_SITE_PARENTS_COUNT
+#define IAGP_CALL_SITE_PARENTS_COUNT 4U
+#endif  // IAGP_CALL_SITE_PARENTS_COUNT
+
+#ifndef IAGP_FRAMES_IN_FLIGHT
+#define IAGP_FRAMES_IN_FLIGHT 3U
+#endif  // IAGP_FRAMES_IN_FLIGHT
+
+#ifndef IAGP_QUERY_POOL_CHUNK_SIZE
+#define IAGP_QUERY_POOL_CHUNK_SIZE 1024U
+#endif  // IAGP_QUERY_POOL_CHUNK_SIZE
+
+#ifndef IAGP_FENCE_TIMEOUT
+#define IAGP_FENCE_TIMEOUT 1000000000U  // 1s in ns
+#endif  // IAGP_FENCE_TIMEOUT
+
+#ifndef IAGP_COLLECTOR_WAIT_TIMEOUT
+#define IAGP_COLLECTOR_WAIT_TIMEOUT 1000000U  // 1ms in ns
+#endif  // IAGP_COLLECTOR_WAIT_TIMEOUT
+
+#ifndef IAGP_CLOCK_CALIBRATION_PERIOD
+#define IAGP_CLOCK_CALIBRATION_PERIOD 60U  // in frames
+#endif  // IAGP_CLOCK_CALIBRATION_PERIOD
+
+#ifndef IAGP_FRAME_HISTORY_COUNT
+#define IAGP_FRAME_HISTORY_COUNT 600U  // 10s at 60 fps
+#endif  // IAGP_FRAME_HISTORY_COUNT
+
+#ifndef IAGP_CAPTURES_COUNT
+#define IAGP_CAPTURES_COUNT 16U  // the oldest captures are removed
+#endif  // IAGP_CAPTURES_COUNT
+
+#ifndef IAGP_CAPTURE_FRAMES_AROUND
+#define IAGP_CAPTURE_FRAMES_AROUND 5U  // the frames before and after the frame of a capture
+#endif  // IAGP_CAPTURE_FRAMES_AROUND
+
+#ifndef IAGP_LOD_MIN_BAR_WIDTH
+#define IAGP_LOD_MIN_BAR_WIDTH 2.0f  // in pixels, the smaller bars of the flame graph are merged
+#endif  // IAGP_LOD_MIN_BAR_WIDTH
+
+#ifndef IAGP_DETAILS_SORT_PERIOD
+#define IAGP_DETAILS_SORT_PERIOD 250U  // in ms, the details sorted by a time are sorted again at most at this period
+#endif  // IAGP_DETAILS_SORT_PERIOD
+
+#ifndef IAGP_SAMPLING_PERIOD
+#define IAGP_SAMPLING_PERIOD 4  // the nth frame recorded, or the count of subtrees in rotation
+#endif  // IAGP_SAMPLING_PERIOD
+
+#ifndef IAGP_SAMPLING_BUDGET
+#define IAGP_SAMPLING_BUDGET 50.0f  // in us per frame, the cpu time of the profiler with the adaptive sampling
+#endif  // IAGP_SAMPLING_BUDGET
+
+#ifndef IAGP_SAMPLING_MAX_PERIOD
+#define IAGP_SAMPLING_MAX_PERIOD 64U  // the adaptive sampling record at least one frame on this count
+#endif  // IAGP_SAMPLING_MAX_PERIOD
+
+#ifndef IAGP_HISTOGRAM_SUB_BUCKETS_BITS
+#define IAGP_HISTOGRAM_SUB_BUCKETS_BITS 3U  // 8 buckets per power of two
+#endif  // IAGP_HISTOGRAM_SUB_BUCKETS_BITS
+
+#ifndef IAGP_FLIGHT_RECORDER_SIZE
+#define IAGP_FLIGHT_RECORDER_SIZE 16777216U  // 16 MB of frames
+#endif  // IAGP_FLIGHT_RECORDER_SIZE
+
+#ifndef IAGP_FLIGHT_RECORDER_STRINGS_SIZE
+#define IAGP_FLIGHT_RECORDER_STRINGS_SIZE 1048576U  // 1 MB of zone names
+#endif  // IAGP_FLIGHT_RECORDER_STRINGS_SIZE
+
+#ifndef IAGP_BACKEND
+#define IAGP_BACKEND InAppGpuGLBackend
+#endif  // IAGP_BACKEND
+
 #ifndef IAGP_GPU_CONTEXT
 #define IAGP_GPU_CONTEXT void*
 #endif // GPU_CONTEXT
 
 namespace iagp {
 
-class InAppGpuQueryZone;
-typedef std::shared_ptr<InAppGpuQueryZone> IAGPQueryZonePtr;
-typedef std::weak_ptr<InAppGpuQueryZone> IAGPQueryZoneWeak;
+////////////////////////////////////////////////////////////
+/////////////////////// BACKENDS ///////////////////////////
+////////////////////////////////////////////////////////////
+
+// the gpu calls of the profiler are done by the backend selected with IAGP_BACKEND
+// the backend is a class of static inline functions, so there is no dispatch cost
+//  - frameQueries : the gpu objects of a frame slot, if the backend need them
+//  - GenQueries / DeleteQueries : allocation of the ids of the timestamp queries
+//  - WriteTimeStamp : write the gpu time in a query, vIdx is the index of the query in the frame
+//  - IsResultAvailable : availability of a query of a frame
+//  - GetResults / ResetQueries : readback of all the queries of a frame, and reset of them after, in one call
+//  - DeleteFrameQueries : release of the objects of a frame slot, the frame is retired
+//  - GetTimeStamp : the current gpu time, for calibrate the cpu clock on it. return false if not supported
+//  - InsertFence / WaitFence / DeleteFence / Flush : sync of the frames
+//  - ResizeResultsBuffer / ResolveResult / ReadResults / DeleteResultsBuffer : readback by the collector thread
+//  - CheckErrors : called after the gpu calls
+
+#ifndef IAGP_NO_OPENGL
+// the opengl backend, the default one
+class InAppGpuGLBackend {
+public:
+    struct frameQueries {};  // the queries are objects by zone, nothing by frame
+
+public:
+    static void GenQueries(const GLsizei vCount, GLuint* vOutIds) {
+        glGenQueries(vCount, vOutIds);
+    }
+    static void DeleteQueries(const GLsizei vCount, const GLuint* vIds) {
+        glDeleteQueries(vCount, vIds);
+    }
+    static void WriteTimeStamp(frameQueries& /*vFrame*/, const uint32_t /*vIdx*/, const GLuint vId) {
+        glQueryCounter(vId, GL_TIMESTAMP);
+    }
+    static bool IsResultAvailable(const frameQueries& /*vFrame*/, const uint32_t /*vIdx*/, const GLuint vId) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(vId, GL_QUERY_RESULT_AVAILABLE, &available);
+        return (available == GL_TRUE);
+    }
+    static void GetResults(const frameQueries& /*vFrame*/, const GLuint* vIds, const uint32_t vCount, GLuint64* vOutResults) {
+        // opengl have no batched readback of queries, even GL_QUERY_BUFFER need one call per query,
+        // but without the sync, so its the collector thread path (ResolveResult)
+        // the frame is retired, so each call return without wait
+        for (uint32_t idx = 0U; idx < vCount; ++idx) {
+            glGetQueryObjectui64v(vIds[idx], GL_QUERY_RESULT, &vOutResults[idx]);
+        }
+    }
+    static void ResetQueries(frameQueries& /*vFrame*/, const uint32_t /*vCount*/) {
+        // opengl can overwrite a query without reset
+    }
+    static void DeleteFrameQueries(frameQueries& /*vFrame*/) {
+    }
+    static bool GetTimeStamp(GLuint64& vOutTime) {
+        GLint64 value64 = 0;
+        glGetInteger64v(GL_TIMESTAMP, &value64);
+        vOutTime = (GLuint64)value64;
+        return true;
+    }
+    static GLsync InsertFence(frameQueries& /*vFrame*/) {
+        return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    static bool WaitFence(const frameQueries& /*vFrame*/, const GLsync vFence, const bool vFlush, const GLuint64 vTimeOut) {
+        const GLenum res = glClientWaitSync(vFence, vFlush ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, vTimeOut);
+        return (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED);
+    }
+    static void DeleteFence(const GLsync vFence) {
+        glDeleteSync(vFence);
+    }
+    static void Flush() {
+        glFlush();
+    }
+    static void ResizeResultsBuffer(GLuint& vBuffer, const uint32_t vCount) {
+        if (vBuffer == 0U) {
+            glGenBuffers(1, &vBuffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(vCount * sizeof(GLuint64)), nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0U);
+    }
+    static void ResolveResult(const GLuint vBuffer, const GLuint vId, const uint32_t vIdx) {
+        // with a query buffer bound, the result is written by the gpu when available, without stall
+        glBindBuffer(GL_QUERY_BUFFER, vBuffer);
+        glGetQueryObjectui64v(vId, GL_QUERY_RESULT, (GLuint64*)(intptr_t)(vIdx * sizeof(GLuint64)));
+        glBindBuffer(GL_QUERY_BUFFER, 0U);
+    }
+    static void ReadResults(const GLuint vBuffer, const frameQueries& /*vFrame*/, const uint32_t vCount, GLuint64* vOutResults) {
+        glBindBuffer(GL_COPY_READ_BUFFER, vBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)(vCount * sizeof(GLuint64)), vOutResults);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0U);
+    }
+    static void DeleteResultsBuffer(GLuint& vBuffer) {
+        glDeleteBuffers(1, &vBuffer);
+        vBuffer = 0U;
+    }
+    static void CheckErrors(const char* vFile, const char* vFunc, const int vLine) {
+#ifdef _DEBUG
+        const GLenum err(glGetError());
+        if (err != GL_NO_ERROR) {
+            const char* error = "";
+            switch (err) {
+                case GL_INVALID_OPERATION: error = "INVALID_OPERATION"; break;
+                case GL_INVALID_ENUM: error = "INVALID_ENUM"; break;
+                case GL_INVALID_VALUE: error = "INVALID_VALUE"; break;
+                case GL_OUT_OF_MEMORY: error = "OUT_OF_MEMORY"; break;
+                case GL_INVALID_FRAMEBUFFER_OPERATION: error = "INVALID_FRAMEBUFFER_OPERATION"; break;
+                case GL_STACK_UNDERFLOW: error = "GL_STACK_UNDERFLOW"; break;
+                case GL_STACK_OVERFLOW: error = "GL_STACK_OVERFLOW"; break;
+            }
+            printf("[%s][%s][%i] GL Errors : %s\n", vFile, vFunc, vLine, error);
+        }
+#endif
+    }
+};
+
+#endif  // IAGP_NO_OPENGL
+
+// a fake gpu, for test or bench the profiler without gpu
+// the gpu clock only move with AdvanceClock, so the timings are deterministic
+// a command is retired by the fake gpu when the clock reach its time + the latency
+class InAppGpuMockBackend {
+public:
+    struct mockState {
+        std::mutex mutex;
+        GLuint64 clock = 0U;                        // the fake gpu time in ns
+        GLuint64 latency = 0U;                      // the time in ns the fake gpu need for retire a command
+        std::vector<GLuint64> timeStamps;           // by query id - 1
+        std::vector<GLuint64> fences;               // the time of the fence by fence id - 1
+        std::vector<std::vector<GLuint64>> buffers; // by buffer id - 1
+    };
+    struct frameQueries {};  // the queries are by zone, like in opengl
+
+public:
+    static mockState& GetState() {
+        // never destroyed, the profiler singleton can release its queries after the end of main
+        static mockState* _state_ptr = new mockState();
+        return *_state_ptr;
+    }
+    static void Reset() {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.clock = 0U;
+        state.latency = 0U;
+        state.timeStamps.clear();
+        state.fences.clear();
+        state.buffers.clear();
+    }
+    static void AdvanceClock(const GLuint64 vNanoSeconds) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.clock += vNanoSeconds;
+    }
+    static void SetLatency(const GLuint64 vNanoSeconds) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.latency = vNanoSeconds;
+    }
+    static GLuint64 GetClock() {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.clock;
+    }
+    static void GenQueries(const GLsizei vCount, GLuint* vOutIds) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (GLsizei idx = 0; idx < vCount; ++idx) {
+            state.timeStamps.push_back(0U);
+            vOutIds[idx] = (GLuint)state.timeStamps.size();
+        }
+    }
+    static void DeleteQueries(const GLsizei /*vCount*/, const GLuint* /*vIds*/) {
+        // the ids are never reused, so the fake gpu stay deterministic
+    }
+    static void WriteTimeStamp(frameQueries& /*vFrame*/, const uint32_t /*vIdx*/, const GLuint vId) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.timeStamps[vId - 1U] = state.clock;
+    }
+    static bool IsResultAvailable(const frameQueries& /*vFrame*/, const uint32_t /*vIdx*/, const GLuint vId) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return (state.clock >= state.timeStamps[vId - 1U] + state.latency);
+    }
+    static void GetResults(const frameQueries& /*vFrame*/, const GLuint* vIds, const uint32_t vCount, GLuint64* vOutResults) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (uint32_t idx = 0U; idx < vCount; ++idx) {
+            vOutResults[idx] = state.timeStamps[vIds[idx] - 1U];
+        }
+    }
+    static void ResetQueries(frameQueries& /*vFrame*/, const uint32_t /*vCount*/) {
+    }
+    static void DeleteFrameQueries(frameQueries& /*vFrame*/) {
+    }
+    static bool GetTimeStamp(GLuint64& vOutTime) {
+        vOutTime = GetClock();
+        return true;
+    }
+    static GLsync InsertFence(frameQueries& /*vFrame*/) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.fences.push_back(state.clock);
+        return (GLsync)(intptr_t)state.fences.size();
+    }
+    static bool WaitFence(const frameQueries& /*vFrame*/, const GLsync vFence, const bool /*vFlush*/, const GLuint64 vTimeOut) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        const GLuint64 retire_time = state.fences[(size_t)(intptr_t)vFence - 1U] + state.latency;
+        if (state.clock < retire_time && vTimeOut > 0U && retire_time - state.clock <= vTimeOut) {
+            state.clock = retire_time;  // the cpu have waited the fake gpu
+        }
+        return (state.clock >= retire_time);
+    }
+    static void DeleteFence(const GLsync /*vFence*/) {
+    }
+    static void Flush() {
+    }
+    static void ResizeResultsBuffer(GLuint& vBuffer, const uint32_t vCount) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (vBuffer == 0U) {
+            state.buffers.emplace_back();
+            vBuffer = (GLuint)state.buffers.size();
+        }
+        state.buffers[vBuffer - 1U].resize(vCount);
+    }
+    static void ResolveResult(const GLuint vBuffer, const GLuint vId, const uint32_t vIdx) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.buffers[vBuffer - 1U][vIdx] = state.timeStamps[vId - 1U];
+    }
+    static void ReadResults(const GLuint vBuffer, const frameQueries& /*vFrame*/, const uint32_t vCount, GLuint64* vOutResults) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        const auto& buffer = state.buffers[vBuffer - 1U];
+        for (uint32_t idx = 0U; idx < vCount; ++idx) {
+            vOutResults[idx] = buffer[idx];
+        }
+    }
+    static void DeleteResultsBuffer(GLuint& vBuffer) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.buffers[vBuffer - 1U].clear();
+        vBuffer = 0U;
+    }
+    static void CheckErrors(const char* /*vFile*/, const char* /*vFunc*/, const int /*vLine*/) {
+    }
+};
+
+#ifdef IAGP_USE_VULKAN
+// the vulkan backend
+// each frame slot have its own VkQueryPool, the query i of the frame is the query i of the pool
+// so a frame is read back with one vkGetQueryPoolResults and reset with one vkResetQueryPool
+// the pool is sized on the queries of the last frame of the slot. a frame needing more take chunks of IAGP_QUERY_POOL_CHUNK_SIZE queries,
+// merged in one pool when the frame is retired
+// the queries are reset on the host, so the device must be created with hostQueryReset enabled
+// (VkPhysicalDeviceVulkan12Features or VkPhysicalDeviceHostQueryResetFeatures, vulkan 1.2)
+// the fences are emulated by the availability of the last timestamp written in the frame
+// you need to call Init with your device before the first frame, and SetCommandBuffer in each thread before its scopes
+class InAppGpuVulkanBackend {
+public:
+    // only written by Init, so the scopes read it without lock
+    struct vulkanState {
+        VkDevice device = VK_NULL_HANDLE;
+        double timestampPeriod = 1.0;          // ns per tick, VkPhysicalDeviceLimits::timestampPeriod
+        uint64_t timestampMask = UINT64_MAX;   // the valid bits of the timestamps, VkQueueFamilyProperties::timestampValidBits
+        PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps = nullptr;  // if VK_EXT_calibrated_timestamps is enabled on the device
+        std::atomic<GLuint> lastId{0U};        // the ids only mark the queries of the zones
+    };
+    struct frameQueries {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        uint32_t capacity = 0U;
+        std::vector<VkQueryPool> chunks;  // the queries after the capacity of the pool
+        uint32_t writtenEnd = 0U;         // the index + 1 of the last query written, 0 if none
+    };
+
+public:
+    static vulkanState& GetState() {
+        // never destroyed, the profiler singleton can release its queries after the end of main
+        static vulkanState* _state_ptr = new vulkanState();
+        return *_state_ptr;
+    }
+    static void LogError(const char* vMessage);  // in iagp.cpp, for use IAGP_LOG_ERROR_MESSAGE
+    // vQueueFamilyIndex is the family of the queue executing the command buffers of the scopes
+    static void Init(VkDevice vDevice, VkPhysicalDevice vPhysicalDevice, const uint32_t vQueueFamilyIndex) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(vPhysicalDevice, &props);
+        uint32_t families_count = 0U;
+        vkGetPhysicalDeviceQueueFamilyProperties(vPhysicalDevice, &families_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(families_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(vPhysicalDevice, &families_count, families.data());
+        const uint32_t valid_bits = (vQueueFamilyIndex < families_count) ? families[vQueueFamilyIndex].timestampValidBits : 0U;
+        if (valid_bits == 0U) {
+            LogError("the queue family of the scopes have no timestamps (timestampValidBits is 0)");
+        }
+        auto& state = GetState();
+        state.device = vDevice;
+        state.timestampPeriod = (double)props.limits.timestampPeriod;
+        state.timestampMask = (valid_bits >= 64U) ? UINT64_MAX : ((1ULL << valid_bits) - 1U);
+        state.getCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(vDevice, "vkGetCalibratedTimestampsEXT");
+    }
+    static VkCommandBuffer& GetCommandBufferRef() {  // the command buffer recording the scopes of the thread
+        static thread_local VkCommandBuffer _command_buffer = VK_NULL_HANDLE;
+        return _command_buffer;
+    }
+    static void SetCommandBuffer(VkCommandBuffer vCommandBuffer) {
+        GetCommandBufferRef() = vCommandBuffer;
+    }
+    static GLuint64 ToTime(const uint64_t vTicks) {
+        const auto& state = GetState();
+        return (GLuint64)((double)(vTicks & state.timestampMask) * state.timestampPeriod);
+    }
+    static VkQueryPool CreatePool(const uint32_t vCount) {
+        auto& state = GetState();
+        VkQueryPoolCreateInfo infos = {};
+        infos.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        infos.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        infos.queryCount = vCount;
+        VkQueryPool pool = VK_NULL_HANDLE;
+        if (vkCreateQueryPool(state.device, &infos, nullptr, &pool) != VK_SUCCESS) {
+            LogError("cant create a timestamp query pool");
+            return VK_NULL_HANDLE;
+        }
+        vkResetQueryPool(state.device, pool, 0U, vCount);  // a query must be reset before its first write
+        return pool;
+    }
+    // the pool of the query vIdx of the frame, and its index in this pool
+    static VkQueryPool GetPool(const frameQueries& vFrame, const uint32_t vIdx, uint32_t& vOutQueryIdx) {
+        if (vIdx < vFrame.capacity) {
+            vOutQueryIdx = vIdx;
+            return vFrame.pool;
+        }
+        const uint32_t chunk_idx = (vIdx - vFrame.capacity) / IAGP_QUERY_POOL_CHUNK_SIZE;
+        vOutQueryIdx = (vIdx - vFrame.capacity) % IAGP_QUERY_POOL_CHUNK_SIZE;
+        return (chunk_idx < (uint32_t)vFrame.chunks.size()) ? vFrame.chunks[chunk_idx] : VK_NULL_HANDLE;
+    }
+    static void GenQueries(const GLsizei vCount, GLuint* vOutIds) {
+        const GLuint base_id = GetState().lastId.fetch_add((GLuint)vCount) + 1U;
+        for (GLsizei idx = 0; idx < vCount; ++idx) {
+            vOutIds[idx] = base_id + (GLuint)idx;
+        }
+    }
+    static void DeleteQueries(const GLsizei /*vCount*/, const GLuint* /*vIds*/) {
+        // the ids have no gpu objects, the pools are owned by the frames and destroyed when they are retired
+    }
+    static void WriteTimeStamp(frameQueries& vFrame, const uint32_t vIdx, const GLuint /*vId*/) {
+        VkCommandBuffer command_buffer = GetCommandBufferRef();
+        if (command_buffer == VK_NULL_HANDLE) {
+            static thread_local bool _is_logged = false;
+            if (!_is_logged) {
+                _is_logged = true;
+                LogError("no command buffer for the scopes of this thread, see InAppGpuVulkanBackend::SetCommandBuffer");
+            }
+            return;  // the query stay not available, its time will be 0
+        }
+        while (vIdx >= vFrame.capacity + (uint32_t)vFrame.chunks.size() * IAGP_QUERY_POOL_CHUNK_SIZE) {
+            // the frame need more queries than the last one of the slot
+            const VkQueryPool pool = CreatePool(IAGP_QUERY_POOL_CHUNK_SIZE);
+            if (pool == VK_NULL_HANDLE) {
+                return;
+            }
+            vFrame.chunks.push_back(pool);
+        }
+        uint32_t query_idx = 0U;
+        const VkQueryPool pool = GetPool(vFrame, vIdx, query_idx);  // before the call, query_idx is an argument
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, query_idx);
+        vFrame.writtenEnd = vIdx + 1U;
+    }
+    static bool IsResultAvailable(const frameQueries& vFrame, const uint32_t vIdx, const GLuint /*vId*/) {
+        if (vFrame.writtenEnd == 0U) {
+            return true;  // nothing to wait
+        }
+        // a query not written will never be available, and the timestamps are retired in order, so the last written is checked
+        uint32_t query_idx = 0U;
+        const VkQueryPool pool = GetPool(vFrame, (vIdx < vFrame.writtenEnd) ? vIdx : vFrame.writtenEnd - 1U, query_idx);
+        uint64_t datas[2] = {0U, 0U};  // value and availability
+        vkGetQueryPoolResults(GetState().device, pool, query_idx, 1U, sizeof(datas), datas, sizeof(datas),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        return (datas[1] != 0U);
+    }
+    static void GetResults(const frameQueries& vFrame, const GLuint* /*vIds*/, const uint32_t vCount, GLuint64* vOutResults) {
+        // one vkGetQueryPoolResults by pool, so one for the frame when it have not needed more queries than its pool
+        static thread_local std::vector<uint64_t> _datas;  // value and availability by query
+        uint32_t start = 0U;
+        while (start < vCount) {
+            uint32_t query_idx = 0U;
+            const VkQueryPool pool = GetPool(vFrame, start, query_idx);
+            const uint32_t pool_end = (start < vFrame.capacity) ? vFrame.capacity : start - query_idx + IAGP_QUERY_POOL_CHUNK_SIZE;
+            const uint32_t end = (vCount < pool_end) ? vCount : pool_end;
+            const uint32_t count = end - start;
+            _datas.assign(count * 2U, 0U);
+            if (pool != VK_NULL_HANDLE) {
+                // the frame is retired, so the queries are available, except the ones not written
+                vkGetQueryPoolResults(GetState().device, pool, query_idx, count, _datas.size() * sizeof(uint64_t), _datas.data(),
+                                      2U * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            }
+            for (uint32_t idx = 0U; idx < count; ++idx) {
+                vOutResults[start + idx] = (_datas[idx * 2U + 1U] != 0U) ? ToTime(_datas[idx * 2U]) : 0U;
+            }
+            start = end;
+        }
+    }
+    static void ResetQueries(frameQueries& vFrame, const uint32_t vCount) {
+        // the frame is retired, so its queries can be reset on the host
+        if (!vFrame.chunks.empty()) {
+            // the pool is recreated for all the queries of the frame, so the next frames of the slot need one pool
+            const uint32_t capacity = ((vCount + IAGP_QUERY_POOL_CHUNK_SIZE - 1U) / IAGP_QUERY_POOL_CHUNK_SIZE) * IAGP_QUERY_POOL_CHUNK_SIZE;
+            DeleteFrameQueries(vFrame);
+            if (capacity > 0U) {
+                vFrame.pool = CreatePool(capacity);
+                vFrame.capacity = (vFrame.pool != VK_NULL_HANDLE) ? capacity : 0U;
+            }
+        } else if (vFrame.pool != VK_NULL_HANDLE && vCount > 0U) {
+            vkResetQueryPool(GetState().device, vFrame.pool, 0U, (vCount < vFrame.capacity) ? vCount : vFrame.capacity);
+        }
+        vFrame.writtenEnd = 0U;
+    }
+    static void DeleteFrameQueries(frameQueries& vFrame) {
+        auto& state = GetState();
+        if (vFrame.pool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(state.device, vFrame.pool, nullptr);
+        }
+        for (const auto& pool : vFrame.chunks) {
+            vkDestroyQueryPool(state.device, pool, nullptr);
+        }
+        vFrame = frameQueries();
+    }
+    static bool GetTimeStamp(GLuint64& vOutTime) {
+        // the gpu time now, like GL_TIMESTAMP. need VK_EXT_calibrated_timestamps
+        // else the cpu frame is aligned on the start of the gpu frame
+        const auto& state = GetState();
+        if (state.getCalibratedTimestamps == nullptr) {
+            return false;
+        }
+        VkCalibratedTimestampInfoEXT infos = {};
+        infos.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        infos.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+        uint64_t ticks = 0U;
+        uint64_t max_deviation = 0U;
+        if (state.getCalibratedTimestamps(state.device, 1U, &infos, &ticks, &max_deviation) != VK_SUCCESS) {
+            return false;
+        }
+        vOutTime = ToTime(ticks);
+        return true;
+    }
+    static GLsync InsertFence(frameQueries& vFrame) {
+        return (GLsync)&vFrame;  // only not null, the fence is the last query written in the frame
+    }
+    static bool WaitFence(const frameQueries& vFrame, const GLsync /*vFence*/, const bool /*vFlush*/, const GLuint64 vTimeOut) {
+        // the queries are retired in submission order, so the last one give the retirement of the frame
+        const auto start = std::chrono::steady_clock::now();
+        while (!IsResultAvailable(vFrame, vFrame.writtenEnd, 0U)) {
+            if ((GLuint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() >= vTimeOut) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+    static void DeleteFence(const GLsync /*vFence*/) {
+    }
+    static void Flush() {
+        // the command buffers are submitted by the application
+    }
+    static void ResizeResultsBuffer(GLuint& vBuffer, const uint32_t /*vCount*/) {
+        vBuffer = 1U;  // the query pools can be read from any thread, so no buffer is needed
+    }
+    static void ResolveResult(const GLuint /*vBuffer*/, const GLuint /*vId*/, const uint32_t /*vIdx*/) {
+    }
+    static void ReadResults(const GLuint /*vBuffer*/, const frameQueries& vFrame, const uint32_t vCount, GLuint64* vOutResults) {
+        GetResults(vFrame, nullptr, vCount, vOutResults);
+    }
+    static void DeleteResultsBuffer(GLuint& vBuffer) {
+        vBuffer = 0U;
+    }
+    static void CheckErrors(const char* /*vFile*/, const char* /*vFunc*/, const int /*vLine*/) {
+        // the vulkan errors are given by the validation layers
+    }
+};
+#endif  // IAGP_USE_VULKAN
+
+typedef IAGP_BACKEND InAppGpuBackend;
 
 class InAppGpuGLContext;
 typedef std::shared_ptr<InAppGpuGLContext> IAGPContextPtr;
 typedef std::weak_ptr<InAppGpuGLContext> IAGPContextWeak;
 
+// fnv-1a, usable at compile time for the labels of the call sites
+constexpr uint64_t HashLabel(const char* vStr, const uint64_t vHash = 14695981039346656037ULL) {
+    return (*vStr == '\0') ? vHash : HashLabel(vStr + 1, (vHash ^ (uint64_t)(uint8_t)(*vStr)) * 1099511628211ULL);
+}
+
+// the hash of section + '\0' + name
+constexpr uint64_t HashZoneLabel(const char* vSection, const char* vName) {
+    return HashLabel(vName, HashLabel(vSection) * 1099511628211ULL);
+}
+
+// a format without '%' is the label itself, no need to format it
+constexpr bool HasFormatArgs(const char* vFmt) {
+    return (*vFmt == '\0') ? false : ((*vFmt == '%') ? true : HasFormatArgs(vFmt + 1));
+}
+
+// one per IAGPScoped call site and per thread, keep the last zones resolved, one per parent
+// so a scope already known is found without formatting or hashing
+struct InAppGpuCallSite {
+    struct entry {
+        const void* context = nullptr;     // the context of the cached zone
+        const void* ptr = nullptr;         // the ptr of IAGPScopedPtr
+        uint32_t generation = 0U;          // the generation of the context
+        uint32_t parentIdx = 0xFFFFFFFFU;  // the parent of the cached zone
+        uint32_t zoneIdx = 0xFFFFFFFFU;    // the cached zone
+    };
+    const char* section = nullptr;
+    const char* fmt = nullptr;
+    uint64_t hash = 0U;                  // HashZoneLabel(section, fmt)
+    bool hasArgs = false;                // the label need to be formatted
+    entry entries[IAGP_CALL_SITE_PARENTS_COUNT] = {};
+    uint32_t nextEntry = 0U;             // the entry replaced by the next miss
+    constexpr InAppGpuCallSite(const char* vSection, const char* vFmt, const uint64_t vHash, const bool vHasArgs)
+        : section(vSection), fmt(vFmt), hash(vHash), hasArgs(vHasArgs) {}
+};
+
 enum InAppGpuGraphTypeEnum {
     IN_APP_GPU_HORIZONTAL = 0,
     IN_APP_GPU_CIRCULAR,
     IN_APP_GPU_Count
 };
 
-template <typename T>
-class InAppGpuAverageValue {
+// the columns of the details table, the tree column is the order of the tree (no sort)
+enum InAppGpuDetailsColumnEnum {
+    IN_APP_GPU_DETAILS_TREE = 0,
+    IN_APP_GPU_DETAILS_COUNT,
+    IN_APP_GPU_DETAILS_GPU_TIME,
+    IN_APP_GPU_DETAILS_CPU_TIME,
+    IN_APP_GPU_DETAILS_GPU_MIN,
+    IN_APP_GPU_DETAILS_GPU_P50,
+    IN_APP_GPU_DETAILS_GPU_P95,
+    IN_APP_GPU_DETAILS_GPU_P99,
+    IN_APP_GPU_DETAILS_GPU_MAX,
+    IN_APP_GPU_DETAILS_MAX_FPS,
+    IN_APP_GPU_DETAILS_START_TIME,
+    IN_APP_GPU_DETAILS_END_TIME,
+    IN_APP_GPU_DETAILS_CALLS,      // the calls of the zone in the last frame
+    IN_APP_GPU_DETAILS_CALL_MIN,
+    IN_APP_GPU_DETAILS_CALL_MEAN,
+    IN_APP_GPU_DETAILS_CALL_MAX,
+    IN_APP_GPU_DETAILS_Count
+};
+
+////////////////////////////////////////////////////////////
+/////////////////////// SMOOTHING //////////////////////////
+////////////////////////////////////////////////////////////
+
+// the times of the zones are smoothed by the policy selected with IAGP_SMOOTHING_POLICY
+// the values are durations or offsets from the start of the root zone, in ms
+// so they never grow with the time, and nothing need to be reset
+//  - AddValue : add the value of the last frame
+//  - GetValue : the smoothed value
+
+// exponential moving average, O(1)
+class IN_APP_GPU_PROFILER_API InAppGpuEmaSmoothing {
+public:
+    static float sFactor;  // the weight of the last value
+
+private:
+    double m_Value = 0.0;
+    bool m_IsEmpty = true;
+
+public:
+    void AddValue(const double vValue);
+    double GetValue() const;
+};
+
+// mean on the last IAGP_MEAN_AVERAGE_LEVELS_COUNT values, O(1)
+class IN_APP_GPU_PROFILER_API InAppGpuMeanSmoothing {
 private:
-    static constexpr uint32_t sCountAverageValues = IAGP_MEAN_AVERAGE_LEVELS_COUNT;
-    T m_PerFrame[sCountAverageValues] = {};
-    int m_PerFrameIdx = (T)0;
-    T m_PerFrameAccum = (T)0;
-    T m_AverageValue = (T)0;
+    static constexpr uint32_t sCountValues = IAGP_MEAN_AVERAGE_LEVELS_COUNT;
+    double m_Values[sCountValues] = {};
+    uint32_t m_Index = 0U;
+    uint32_t m_Count = 0U;
+    double m_Accum = 0.0;
 
 public:
-    InAppGpuAverageValue();
-    void AddValue(T vValue);
-    T GetAverage();
+    void AddValue(const double vValue);
+    double GetValue() const;
 };
 
-template <typename T>
-InAppGpuAverageValue<T>::InAppGpuAverageValue() {
-    memset(m_PerFrame, 0, sizeof(T) * sCountAverageValues);
-    m_PerFrameIdx = (T)0;
-    m_PerFrameAccum = (T)0;
-    m_AverageValue = (T)0;
-}
+// median of the last IAGP_MEDIAN_LEVELS_COUNT values, ignore the spikes
+class IN_APP_GPU_PROFILER_API InAppGpuMedianSmoothing {
+private:
+    static constexpr uint32_t sCountValues = IAGP_MEDIAN_LEVELS_COUNT;
+    double m_Values[sCountValues] = {};
+    uint32_t m_Index = 0U;
+    uint32_t m_Count = 0U;
+    double m_Median = 0.0;
 
-template <typename T>
-void InAppGpuAverageValue<T>::AddValue(T vValue) {
-    if (vValue < m_PerFrame[m_PerFrameIdx]) {
-        memset(m_PerFrame, 0, sizeof(T) * sCountAverageValues);
-        m_PerFrameIdx = (T)0;
-        m_PerFrameAccum = (T)0;
-        m_AverageValue = (T)0;
-    }
-    m_PerFrameAccum += vValue - m_PerFrame[m_PerFrameIdx];
-    m_PerFrame[m_PerFrameIdx] = vValue;
-    m_PerFrameIdx = (m_PerFrameIdx + (T)1) % sCountAverageValues;
-    if (m_PerFrameAccum > (T)0) {
-        m_AverageValue = m_PerFrameAccum / (T)sCountAverageValues;
-    }
-}
+public:
+    void AddValue(const double vValue);
+    double GetValue() const;
+    uint32_t GetCount() const;
+};
 
-template <typename T>
-T InAppGpuAverageValue<T>::GetAverage() {
-    return m_AverageValue;
-}
+enum InAppGpuSmoothingEnum {
+    IN_APP_GPU_SMOOTHING_EMA = 0,
+    IN_APP_GPU_SMOOTHING_MEAN,
+    IN_APP_GPU_SMOOTHING_MEDIAN,
+    IN_APP_GPU_SMOOTHING_Count
+};
+
+// all the policies are fed, so the smoothing can be changed at runtime without reset
+// opt-in : its about 650 bytes and a nth_element per value, so 2.6 KB per zone
+class IN_APP_GPU_PROFILER_API InAppGpuRuntimeSmoothing {
+public:
+    static InAppGpuSmoothingEnum sSmoothing;
 
+private:
+    InAppGpuEmaSmoothing m_Ema;
+    InAppGpuMeanSmoothing m_Mean;
+    InAppGpuMedianSmoothing m_Median;
+
+public:
+    void AddValue(const double vValue);
+    double GetValue() const;
+};
+
+typedef IAGP_SMOOTHING_POLICY InAppGpuSmoothing;
+
+// log bucket histogram of the elapsed times of a zone, since the start or the last reset
+// each power of two of ns is cut in 2^IAGP_HISTOGRAM_SUB_BUCKETS_BITS buckets, so the memory is fixed
+// and the error of a percentile is less than the half of a bucket (6% with 3 bits)
+// the buckets are 16 bits, when one is full all are halved, so the old frames weight less (about 500 bytes with 3 bits)
+class IN_APP_GPU_PROFILER_API InAppGpuHistogram {
+public:
+    static constexpr uint32_t sSubBucketsBits = IAGP_HISTOGRAM_SUB_BUCKETS_BITS;
+    static constexpr uint32_t sSubBucketsCount = 1U << sSubBucketsBits;
+    static constexpr uint32_t sMaxBits = 32U;  // 2^32 ns, 4.3 s, the greater times are in the last bucket
+    static constexpr uint32_t sBucketsCount = (sMaxBits - sSubBucketsBits + 1U) * sSubBucketsCount;
+    struct percentiles {
+        GLuint64 p50 = 0U;
+        GLuint64 p95 = 0U;
+        GLuint64 p99 = 0U;
+    };
+
+private:
+    uint16_t m_Buckets[sBucketsCount] = {};
+    uint32_t m_Weight = 0U;  // the sum of the buckets, for the ranks of the percentiles
+    uint64_t m_Count = 0U;   // the count of values, not halved
+    GLuint64 m_Min = 0U;
+    GLuint64 m_Max = 0U;
+
+public:
+    void AddValue(const GLuint64 vValue);  // in ns
+    void Reset();
+    uint64_t GetCount() const;
+    GLuint64 GetMin() const;
+    GLuint64 GetMax() const;
+    GLuint64 GetPercentile(const double vRatio) const;
+    percentiles GetPercentiles() const;  // p50, p95 and p99 in one pass
+
+private:
+    static uint32_t m_GetBucketIndex(const GLuint64 vValue);
+    void m_HalveBuckets();
+    GLuint64 m_GetBucketValue(const uint32_t vIdx) const;
+};
+
+// the ui state of a zone
+// the tree and the timings are in the InAppGpuZoneStore of the context
 class IN_APP_GPU_PROFILER_API InAppGpuQueryZone {
 public:
     struct circularSettings {
-        float count_point = 20.0f;  // 60 for 2pi
+        float count_point = 120.0f;  // the segments of the full circle
         float scaleX = 1.0f;
         float scaleY = 1.0f;
         float base_radius = 50.0f;
@@ -164,118 +878,747 @@ public:
     static bool sShowLeafMode;
     static float sContrastRatio;
     static bool sActivateLogger;
-    static std::vector<IAGPQueryZoneWeak> sTabbedQueryZones;
-    static IAGPQueryZonePtr create(IAGP_GPU_CONTEXT vContext, const std::string& vName, const std::string& vSectionName,
-                                   const bool vIsRoot = false);
+    static bool sShowCpuTrack;
+    static bool sShowFrameHistory;
+    static bool sUseLod;           // the bars too small are merged, and the labels too long are not computed
+    static float sLodMinBarWidth;  // in pixels
     static circularSettings sCircularSettings;
 
-private:
-    IAGPQueryZoneWeak m_This;
-    IAGP_GPU_CONTEXT m_Context;
-    bool m_IsRoot = false;
-    double m_ElapsedTime = 0.0;
-    double m_StartTime = 0.0;
-    double m_EndTime = 0.0;
-    GLuint m_StartFrameId = 0;
-    GLuint m_EndFrameId = 0;
-    GLuint64 m_StartTimeStamp = 0;
-    GLuint64 m_EndTimeStamp = 0;
-    bool m_Expanded = false;
-    bool m_Highlighted = false;
-    InAppGpuAverageValue<GLuint64> m_AverageStartValue;
-    InAppGpuAverageValue<GLuint64> m_AverageEndValue;
-    std::string m_BarLabel;
-    std::string m_SectionName;
+public:
+    // statistics, written one time per collected frame
+    InAppGpuSmoothing smoothedStartOffset;  // from the start of the root
+    InAppGpuSmoothing smoothedElapsedTime;
+    InAppGpuSmoothing smoothedCpuStartOffset;  // from the gpu start of the root
+    InAppGpuSmoothing smoothedCpuElapsedTime;
+    InAppGpuHistogram histogram;  // elapsed gpu times, since the creation of the zone or the last reset
+    GLuint64 invocationSumTime = 0U;  // in ns, of the calls of the last collected frame
+    GLuint64 invocationMinTime = 0U;
+    GLuint64 invocationMaxTime = 0U;
+    uint32_t recorderSession = 0U;  // the flight recorder session where the name of the zone was written
+
+    // ui
+    bool isRoot = false;
+    bool expanded = true;  // in the details table
+    bool highlighted = false;
     ImVec4 cv4;
     ImVec4 hsv;
+    std::string name;
+    std::string sectionName;
+    std::string barLabel;  // rebuilt only when the shown time change
+    ImVec2 barLabelSize;
+    int64_t barLabelKey = -1;  // the time of the label, in 1/100 ms
+    std::string cpuBarLabel;
+    ImVec2 cpuBarLabelSize;
+    int64_t cpuBarLabelKey = -1;
+    std::string imGuiLabel;
+    std::string imGuiTitle;  // the breadcrumb trail (fil d'ariane) of the zone
+};
 
-    // fil d'ariane
-    std::array<IAGPQueryZoneWeak, IAGP_RECURSIVE_LEVELS_COUNT> m_BreadCrumbTrail;  // the parent cound is done by current depth
-
-    // circular
-    const float _1PI_ = 3.141592653589793238462643383279f;
-    //const float _2PI_ = 6.283185307179586476925286766559f;
-    const ImU32 m_BlackU32 = ImGui::GetColorU32(ImVec4(0, 0, 0, 1));
-    ImVec2 m_P0, m_P1, m_LP0, m_LP1;
+// the zones of a context, stored by arrays and linked by indexs
+// a parent is always created before its childs, so its index is always lower
+class IN_APP_GPU_PROFILER_API InAppGpuZoneStore {
+public:
+    static constexpr uint32_t sInvalidIndex = 0xFFFFFFFFU;
 
 public:
-    GLuint depth = 0U;  // the depth of the QueryZone
-    GLuint ids[2] = {0U, 0U};
-    std::vector<IAGPQueryZonePtr> zonesOrdered;
-    std::unordered_map<const void*, std::unordered_map<std::string, IAGPQueryZonePtr>> zonesDico;  // main container
-    std::string name;
-    std::string imGuiLabel;
-    std::string imGuiTitle;
-    IAGPQueryZonePtr parentPtr = nullptr;
-    IAGPQueryZonePtr rootPtr = nullptr;
-    GLuint current_count = 0U;
-    GLuint last_count = 0U;
+    // tree, hot : used by all the traversals
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> firstChilds;
+    std::vector<uint32_t> lastChilds;
+    std::vector<uint32_t> nextSiblings;
+    std::vector<uint32_t> depths;
+    std::vector<uint32_t> roots;
+    std::vector<uint32_t> subtreeRanks;  // rank of the child of the root containing the zone, for the sampling by subtrees
+
+    // timings, hot : written by the scopes and Collect
+    std::vector<GLuint> queryIds;           // start/end query pair per frame in flight
+    std::vector<uint64_t> queryFrames;      // the frame where each query pair was issued
+    std::vector<GLuint> currentCounts;      // count of calls per frame in flight
+    std::vector<GLuint> lastCounts;
+    std::vector<GLuint> startFrameIds;
+    std::vector<GLuint> endFrameIds;
+    std::vector<GLuint64> startTimeStamps;
+    std::vector<GLuint64> endTimeStamps;
+    std::vector<double> startTimes;  // smoothed, in ms from the start of the root
+    std::vector<double> endTimes;
+    std::vector<double> elapsedTimes;
+
+    // invocations, when a zone is called several times in a frame
+    std::vector<GLuint> invocationEndIds;      // the end query of the invocation in recording
+    std::vector<GLuint> invocationsCollected;  // count of invocations collected in the frame in collection
+    std::vector<GLuint64> invocationStarts;    // start of the invocation in collection
+
+    // cpu timings, on the gpu timeline
+    std::vector<int64_t> cpuTimeStamps;     // start/end steady clock time per frame in flight, in ns
+    std::vector<GLuint64> cpuStartTimeStamps;
+    std::vector<GLuint64> cpuEndTimeStamps;
+    std::vector<double> cpuStartTimes;
+    std::vector<double> cpuEndTimes;
+    std::vector<double> cpuElapsedTimes;
+
+    // cold : the statistics and the ui caches, by zone, written one time per collected frame and read by the drawing
+    std::vector<InAppGpuQueryZone> zones;
+
+private:
+    std::vector<const void*> m_Ptrs;                       // the ptr given by IAGPScopedPtr
+    std::unordered_map<uint64_t, uint32_t> m_KeyToZone;  // hash of parent + ptr + section + name
 
 public:
-    InAppGpuQueryZone() = default;
-    InAppGpuQueryZone(IAGP_GPU_CONTEXT vContext, const std::string& vName, const std::string& vSectionName,
-                      const bool vIsRoot = false);
-    ~InAppGpuQueryZone();
     void Clear();
-    void SetStartTimeStamp(const GLuint64& vValue);
-    void SetEndTimeStamp(const GLuint64& vValue);
-    void ComputeElapsedTime();
-    void DrawDetails();
-    bool DrawFlamGraph(InAppGpuGraphTypeEnum vGraphType,      //
-                       IAGPQueryZoneWeak& vOutSelectedQuery,  //
-                       IAGPQueryZoneWeak vParent = {},        //
-                       uint32_t vDepth = 0);
-    void UpdateBreadCrumbTrail();
-    void DrawBreadCrumbTrail(IAGPQueryZoneWeak& vOutSelectedQuery);
+    uint32_t size() const;
+    uint32_t FindChild(const uint32_t vParentIdx, const void* vPtr, const char* vName, const char* vSection, const uint64_t vLabelHash) const;
+    uint32_t AddZone(const uint32_t vParentIdx, const void* vPtr, const char* vName, const char* vSection, const uint64_t vLabelHash, const bool vIsRoot);
+    GLuint* GetQueryIds(const uint32_t vIdx, const uint32_t vSlotIdx);
+    uint64_t& GetQueryFrame(const uint32_t vIdx, const uint32_t vSlotIdx);
+    GLuint& GetCurrentCount(const uint32_t vIdx, const uint32_t vSlotIdx);
+    int64_t* GetCpuTimeStamps(const uint32_t vIdx, const uint32_t vSlotIdx);
+    void SetCpuTimeStamps(const uint32_t vIdx, const uint32_t vSlotIdx, const int64_t vClockOffset);
+    void SetStartTimeStamp(const uint32_t vIdx, const GLuint64& vValue);
+    void SetEndTimeStamp(const uint32_t vIdx, const GLuint64& vValue);
+    void ComputeElapsedTime(const uint32_t vIdx);
+    void ResetStatistics();
+    size_t GetHotBytes() const;  // the size of the hot arrays, without the capacity, checked by the tests
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+    size_t GetHeapBytes() const;  // the memory held by the zone tree
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
+private:
+    static uint64_t m_GetKey(const uint32_t vParentIdx, const void* vPtr, const uint64_t vLabelHash);
+    template <typename T>
+    void m_ForEachHotArray(T vFunctor) const {
+        vFunctor(parents);
+        vFunctor(firstChilds);
+        vFunctor(lastChilds);
+        vFunctor(nextSiblings);
+        vFunctor(depths);
+        vFunctor(roots);
+        vFunctor(subtreeRanks);
+        vFunctor(queryIds);
+        vFunctor(queryFrames);
+        vFunctor(currentCounts);
+        vFunctor(lastCounts);
+        vFunctor(startFrameIds);
+        vFunctor(endFrameIds);
+        vFunctor(startTimeStamps);
+        vFunctor(endTimeStamps);
+        vFunctor(startTimes);
+        vFunctor(endTimes);
+        vFunctor(elapsedTimes);
+        vFunctor(invocationEndIds);
+        vFunctor(invocationsCollected);
+        vFunctor(invocationStarts);
+        vFunctor(cpuTimeStamps);
+        vFunctor(cpuStartTimeStamps);
+        vFunctor(cpuEndTimeStamps);
+        vFunctor(cpuStartTimes);
+        vFunctor(cpuEndTimes);
+        vFunctor(cpuElapsedTimes);
+        vFunctor(m_Ptrs);
+    }
+};
+
+// the timings of a zone in a collected frame, given to the profiler after each readback
+struct InAppGpuCollectedZone {
+    uint32_t zoneIdx = 0U;
+    GLuint count = 0U;
+    GLuint64 startTimeStamp = 0U;
+    GLuint64 endTimeStamp = 0U;
+    GLuint64 cpuStartTimeStamp = 0U;  // on the gpu timeline
+    GLuint64 cpuEndTimeStamp = 0U;
+};
+
+// a zone of a frame of the history, 24 bytes
+struct InAppGpuHistoryZone {
+    uint32_t zoneIdx = 0U;
+    GLuint count = 0U;
+    uint32_t startOffset = 0U;   // ns from the start of the root
+    uint32_t elapsedTime = 0U;   // ns
+    int32_t cpuStartOffset = 0;  // ns from the gpu start of the root, the cpu is before
+    uint32_t cpuElapsedTime = 0U;
+};
+
+struct InAppGpuHistoryFrame {
+    uint64_t frameId = 0U;
+    uint32_t generation = 0U;
+    double elapsedTime = 0.0;  // of the roots, in ms
+    std::vector<InAppGpuHistoryZone> zones;
+};
+
+// a rule of automatic capture, fired when the gpu time of a zone in a collected frame is greater than :
+//  - thresholdTime, if > 0
+//  - medianFactor * the median of the zone on the last IAGP_MEDIAN_LEVELS_COUNT frames, if > 0
+// the zones are selected by name, or the roots if the name is empty
+struct InAppGpuTriggerRule {
+    std::string zoneName;
+    double thresholdTime = 0.0;  // in ms
+    double medianFactor = 0.0;
+    bool pauseProfiler = false;  // pause the profiler when the capture is done
+};
+
+// the frames around a frame where a trigger rule was fired
+struct InAppGpuCapture {
+    IAGPContextWeak context;
+    uint32_t generation = 0U;  // the frames can be inspected while the zones of the context are not cleared
+    uint32_t ruleIdx = 0U;
+    uint64_t frameId = 0U;  // the frame where the rule was fired
+    std::string zoneName;   // the zone who fired the rule
+    double time = 0.0;      // the time of the zone, in ms
+    double limit = 0.0;     // the limit exceeded, in ms
+    std::vector<InAppGpuHistoryFrame> frames;
+};
+
+////////////////////////////////////////////////////////////
+/////////////////////// AGGREGATION ////////////////////////
+////////////////////////////////////////////////////////////
+
+// the views of the flame graph and of the details
+enum InAppGpuViewEnum {
+    IN_APP_GPU_VIEW_TIMELINE = 0,  // the zones as recorded
+    IN_APP_GPU_VIEW_BOTTOM_UP,     // the self times by name, then by callers
+    IN_APP_GPU_VIEW_MERGED,        // the times by name over all the parents, then by childs
+    IN_APP_GPU_VIEW_SECTIONS,      // the self times by section, then by name
+    IN_APP_GPU_VIEW_Count
+};
+
+// the frames recorded by the profiler, the zones of the frames not recorded are only searched
+enum InAppGpuSamplingEnum {
+    IN_APP_GPU_SAMPLING_ALL = 0,   // each frame
+    IN_APP_GPU_SAMPLING_FRAMES,    // each nth frame
+    IN_APP_GPU_SAMPLING_SUBTREES,  // each frame, but only one of the n subtrees of the root, in rotation
+    IN_APP_GPU_SAMPLING_ADAPTIVE,  // the period of frames is adapted for keep the cpu time of the profiler under a budget
+    IN_APP_GPU_SAMPLING_Count
+};
+
+// a tree of nodes summing the times of the zones mapped on them
+// the nodes are only added when new zones are mapped, the times are summed after each collected frame
+// a parent is always created before its childs, so its index is always lower
+class IN_APP_GPU_PROFILER_API InAppGpuAggregateTree {
+public:
+    static constexpr uint32_t sInvalidIndex = 0xFFFFFFFFU;
+
+public:
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> firstChilds;
+    std::vector<uint32_t> lastChilds;
+    std::vector<uint32_t> nextSiblings;
+    std::vector<uint32_t> depths;
+    std::vector<std::string> names;
+    std::vector<double> frameTimes;  // summed in the current frame, in ms
+    std::vector<GLuint> frameCounts;
+    std::vector<InAppGpuSmoothing> smoothedTimes;
+    std::vector<double> elapsedTimes;  // smoothed, in ms
+    std::vector<GLuint> counts;        // of the last frame
+    std::vector<std::string> barLabels;  // rebuilt only when the shown time change
+    std::vector<int64_t> barLabelKeys;
+    std::vector<ImVec2> barLabelSizes;
+    std::vector<uint8_t> expanded;       // in the details table
+
+private:
+    std::unordered_map<uint64_t, uint32_t> m_KeyToNode;  // hash of parent + name
+
+public:
+    void Clear(const char* vRootName);
+    uint32_t size() const;
+    uint32_t GetNode(const uint32_t vParentIdx, const std::string& vName);
+    void BeginFrame();
+    void AddTime(const uint32_t vNodeIdx, const double vTime, const GLuint vCount);
+    void EndFrame();
+};
+
+class IN_APP_GPU_PROFILER_API InAppGpuQueryPool {
+public:
+    struct poolStats {
+        uint32_t capacity = 0U;    // count of queries allocated in the driver
+        uint32_t inUse = 0U;       // count of queries given to the zones
+        uint32_t highWater = 0U;   // max count of queries used in same time
+        uint32_t chunksCount = 0U; // count of driver allocations
+    };
+
+private:
+    IAGP_GPU_CONTEXT m_Context;
+    std::vector<GLuint> m_Queries;      // all the queries allocated, by chunks
+    std::vector<GLuint> m_FreeQueries;  // the queries ready to be given
+    poolStats m_Stats;
+
+public:
+    InAppGpuQueryPool(IAGP_GPU_CONTEXT vContext);
+    void Init();
+    void Unit();
+    void Acquire(GLuint* vOutIds, const uint32_t vCount);
+    void Release(const GLuint* vIds, const uint32_t vCount);
+    const poolStats& GetStats() const;
+
+private:
+    void m_AddChunk();
+};
+
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+// the hot paths of the profiler measured by the self instrumentation
+enum InAppGpuOverheadEnum {
+    IN_APP_GPU_OVERHEAD_SCOPE_BEGIN = 0,   // the constructor of InAppGpuScopedZone
+    IN_APP_GPU_OVERHEAD_SCOPE_END,         // the destructor of InAppGpuScopedZone
+    IN_APP_GPU_OVERHEAD_GET_QUERY_ZONE,    // the search of the zone of a scope, included in the scope begin
+    IN_APP_GPU_OVERHEAD_COLLECT,
+    IN_APP_GPU_OVERHEAD_DRAW_FLAME_GRAPH,
+    IN_APP_GPU_OVERHEAD_DRAW_DETAILS,
+    IN_APP_GPU_OVERHEAD_Count
+};
+
+// the cpu time and the calls of the hot paths, summed over all the threads
+// the counters are never reset, the ui compute the values per frame from their differences between two frames
+class IN_APP_GPU_PROFILER_API InAppGpuOverhead {
+public:
+    struct counter {
+        uint64_t time = 0U;  // in ns
+        uint64_t calls = 0U;
+    };
 
 private:
-    void m_DrawList_DrawBar(const char* vLabel, const ImRect& vRect, const ImVec4& vColor, const bool vHovered);
-    bool m_ComputeRatios(IAGPQueryZonePtr vRoot, IAGPQueryZoneWeak vParent, uint32_t vDepth, float& vOutStartRatio, float& vOutSizeRatio);
-    bool m_DrawHorizontalFlameGraph(IAGPQueryZonePtr vRoot, IAGPQueryZoneWeak& vOutSelectedQuery, IAGPQueryZoneWeak vParent,
-                                    uint32_t vDepth);
-    bool m_DrawCircularFlameGraph(IAGPQueryZonePtr vRoot, IAGPQueryZoneWeak& vOutSelectedQuery, IAGPQueryZoneWeak vParent,
-                                  uint32_t vDepth);
+    std::atomic<uint64_t> m_Times[IN_APP_GPU_OVERHEAD_Count]{};
+    std::atomic<uint64_t> m_Calls[IN_APP_GPU_OVERHEAD_Count]{};
+    // only used by the ui
+    counter m_LastCounters[IN_APP_GPU_OVERHEAD_Count];
+    InAppGpuEmaSmoothing m_FrameTimes[IN_APP_GPU_OVERHEAD_Count];  // in us per frame
+    InAppGpuEmaSmoothing m_FrameCalls[IN_APP_GPU_OVERHEAD_Count];
+    int m_LastFrame = -1;
+
+public:
+    void Add(const InAppGpuOverheadEnum vCounter, const uint64_t vTime);
+    counter Get(const InAppGpuOverheadEnum vCounter) const;
+    void Update(const int vFrame);  // the imgui frame count
+    double GetFrameTime(const InAppGpuOverheadEnum vCounter) const;
+    double GetFrameCalls(const InAppGpuOverheadEnum vCounter) const;
+    static const char* GetName(const InAppGpuOverheadEnum vCounter);
+};
+
+// add the cpu time of its scope in a counter of the overhead
+class IN_APP_GPU_PROFILER_API InAppGpuOverheadTimer {
+private:
+    InAppGpuOverheadEnum m_Counter;
+    int64_t m_StartTime = 0;
+
+public:
+    explicit InAppGpuOverheadTimer(const InAppGpuOverheadEnum vCounter);
+    ~InAppGpuOverheadTimer();
+};
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
+#ifdef IAGP_USE_FLIGHT_RECORDER
+// append the collected frames in a memory mapped file, used as a ring
+// the last frames are in the file even if the application crash
+// file : [fileHeader][string table][ring of frames]
+//  - a string : [u32 size][u64 context][u32 generation][u32 zone][u32 parent]["section\0name\0"]
+//  - a frame : [u32 sFrameMagic][u32 size][varints : context, generation, frame, base time, zones count]
+//              then by zone [varints : zone, count, zigzag(start - base), zigzag(end - start), zigzag(cpu start - base), zigzag(cpu end - cpu start)]
+class IN_APP_GPU_PROFILER_API InAppGpuFlightRecorder {
+public:
+    static constexpr uint32_t sFrameMagic = 0x46504741U;  // "AGPF"
+    static constexpr uint32_t sVersion = 1U;
+    struct fileHeader {
+        char magic[8];                // "IAGPFR01"
+        uint32_t version = 0U;
+        uint32_t session = 0U;        // incremented at each open
+        uint64_t stringsCapacity = 0U;
+        uint64_t stringsSize = 0U;
+        uint64_t ringCapacity = 0U;
+        uint64_t head = 0U;           // where the next frame will be written
+        uint64_t tail = 0U;           // the oldest frame
+        uint64_t endPos = 0U;         // the end of the frames before the head was wrapped
+        uint64_t framesCount = 0U;    // the frames in the ring
+        uint64_t framesWritten = 0U;
+        uint64_t framesDropped = 0U;  // the recorder was busy, or the frame was too big
+        uint32_t wrapped = 0U;        // the frames are in [tail, endPos) then in [0, head)
+        uint32_t stringsDropped = 0U;
+    };
+    struct recordedName {
+        uint64_t context = 0U;
+        uint32_t generation = 0U;
+        uint32_t zoneIdx = 0U;
+        uint32_t parentIdx = 0U;
+        std::string section;
+        std::string name;
+    };
+    struct recordedFrame {
+        uint64_t context = 0U;
+        uint32_t generation = 0U;
+        uint64_t frameId = 0U;
+        std::vector<InAppGpuCollectedZone> zones;
+    };
+
+private:
+    std::mutex m_Mutex;  // never waited by the collecting threads, a busy recorder drop the frame
+    std::atomic<bool> m_IsOpened{false};
+    uint32_t m_Session = 0U;
+    uint8_t* m_Datas = nullptr;  // the mapped file
+    size_t m_DatasSize = 0U;
+    fileHeader* m_HeaderPtr = nullptr;
+    uint8_t* m_StringsPtr = nullptr;
+    uint8_t* m_RingPtr = nullptr;
+#ifdef _WIN32
+    void* m_FileHandle = nullptr;
+    void* m_MappingHandle = nullptr;
+#else
+    int m_FileDescriptor = -1;
+#endif
+
+public:
+    ~InAppGpuFlightRecorder();
+    bool Open(const std::string& vFilePathName, const size_t vRingSize = IAGP_FLIGHT_RECORDER_SIZE,
+              const size_t vStringsSize = IAGP_FLIGHT_RECORDER_STRINGS_SIZE);
+    void Close();
+    bool IsOpened() const;
+    void RecordFrame(const uint64_t vContext, const uint32_t vGeneration, const uint64_t vFrameId, InAppGpuZoneStore& vStore,
+                     const std::vector<InAppGpuCollectedZone>& vZones);
+    static bool Load(const std::string& vFilePathName, std::vector<recordedName>& vOutNames, std::vector<recordedFrame>& vOutFrames);
+    // the names are all given before the frames, the frames are given one by one from the oldest
+    static bool Load(const std::string& vFilePathName, const std::function<void(const recordedName&)>& vNameFunctor,
+                     const std::function<void(const recordedFrame&)>& vFrameFunctor);
+
+private:
+    bool m_Map(const std::string& vFilePathName, const size_t vSize);
+    void m_Unmap();
+    void m_WriteName(const uint64_t vContext, const uint32_t vGeneration, const uint32_t vZoneIdx, const InAppGpuZoneStore& vStore);
+    void m_PopFrame();
+};
+#endif  // IAGP_USE_FLIGHT_RECORDER
+
+// write the zones in a chrome trace event json file (chrome://tracing, perfetto)
+// the events are written one by one, so the document is never in memory
+// one track by context for the gpu, and one for the cpu
+class IN_APP_GPU_PROFILER_API InAppGpuTraceExporter {
+private:
+    FILE* m_FilePtr = nullptr;
+    bool m_IsFirstEvent = true;
+    bool m_IsBaseTimeSet = false;
+    GLuint64 m_BaseTime = 0U;                        // the first timestamp, the events are relative to it
+    std::unordered_map<uint64_t, uint32_t> m_Tracks;  // context to track
+    std::string m_Escaped;
+
+public:
+    ~InAppGpuTraceExporter();
+    bool Open(const std::string& vFilePathName);
+    void Close();
+    bool IsOpened() const;
+    void AddFrame(const std::vector<InAppGpuCollectedZone>& vZones);  // before the zones of the frame
+    void AddZone(const uint64_t vContext, const uint64_t vFrameId, const std::string& vSection, const std::string& vName, const InAppGpuCollectedZone& vZone);
+
+private:
+    uint32_t m_GetTrack(const uint64_t vContext);
+    void m_WriteEvent(const uint32_t vTrack, const uint64_t vFrameId, const std::string& vSection, const std::string& vName, const GLuint64 vStart,
+                      const GLuint64 vEnd, const GLuint vCount);
+    const char* m_Escape(const std::string& vStr);
+};
+
+#ifdef IAGP_USE_COLLECTOR_THREAD
+// lock free queue for one producer thread and one consumer thread
+template <typename T, uint32_t N>
+class InAppGpuSpscQueue {
+private:
+    std::array<T, N + 1U> m_Items;  // one item is always free, for distinguish full and empty
+    std::atomic<uint32_t> m_Head{0U};  // next item to read, written by the consumer
+    std::atomic<uint32_t> m_Tail{0U};  // next item to write, written by the producer
+
+public:
+    bool Push(const T& vItem) {  // producer only
+        const uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+        const uint32_t next = (tail + 1U) % (N + 1U);
+        if (next == m_Head.load(std::memory_order_acquire)) {
+            return false;  // full
+        }
+        m_Items[tail] = vItem;
+        m_Tail.store(next, std::memory_order_release);
+        return true;
+    }
+    bool Front(T& vOutItem) const {  // consumer only
+        const uint32_t head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_Tail.load(std::memory_order_acquire)) {
+            return false;  // empty
+        }
+        vOutItem = m_Items[head];
+        return true;
+    }
+    void Pop() {  // consumer only, after Front
+        const uint32_t head = m_Head.load(std::memory_order_relaxed);
+        m_Head.store((head + 1U) % (N + 1U), std::memory_order_release);
+    }
+};
+#endif  // IAGP_USE_COLLECTOR_THREAD
+
+// the bars of a row of the flame graph merged by the lod, in pixels
+struct InAppGpuLodBlock {
+    float start = 0.0f;
+    float end = 0.0f;
+    uint32_t count = 0U;
+    double time = 0.0;
+    // the bars are not added in x order, so a bar can be at the left or at the right of the block
+    bool IsContiguous(const float vStart, const float vSize) const {
+        return (count == 0U) || (vStart <= end + 1.0f && vStart + vSize >= start - 1.0f);
+    }
+    void Add(const float vStart, const float vSize, const double vTime) {
+        start = (count == 0U || vStart < start) ? vStart : start;
+        end = (count == 0U || vStart + vSize > end) ? vStart + vSize : end;
+        ++count;
+        time += vTime;
+    }
 };
 
 class IN_APP_GPU_PROFILER_API InAppGpuGLContext {
+private:
+    struct readbackRecord {
+        GLuint queryId = 0U;
+        uint32_t zoneIdx = 0U;
+        bool isEnd = false;
+        GLuint count = 0U;  // count of calls of the zone, set on the ends at the end of the frame for the collector thread
+    };
+    struct frameSlot {
+        uint64_t frameId = 0U;                  // the frame recorded in this slot
+        GLsync fence = nullptr;                 // signaled when the gpu have retired the frame
+        GLuint lastQueryId = 0U;                // the last query issued in the frame
+        int64_t clockOffset = 0;                // gpu time - cpu time, when the frame was started
+        bool isClockCalibrated = false;         // false if the backend cant give the gpu time
+        std::vector<readbackRecord> records;    // queries of the frame to retrieve, in issue order
+        InAppGpuBackend::frameQueries queries;  // the gpu objects of the frame, for the backends needing them
+        std::vector<GLuint> invocationQueries;  // the query pairs of the zones called several times, the excess is released each frame
+        uint32_t invocationQueriesUsed = 0U;    // count of queries used in the frame
+#ifdef IAGP_USE_COLLECTOR_THREAD
+        GLuint resultsBuffer = 0U;              // the query results, written by the gpu, read by the collector thread
+        uint32_t resultsCapacity = 0U;          // count of results the buffer can contain
+        std::atomic<bool> pending{false};       // the slot is owned by the collector thread
+#endif  // IAGP_USE_COLLECTOR_THREAD
+    };
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    struct frameToken {
+        uint64_t frameId = 0U;
+        uint32_t slotIdx = 0U;
+        uint32_t generation = 0U;  // the generation of the zones when the frame was recorded
+    };
+#endif  // IAGP_USE_COLLECTOR_THREAD
+    // the times drawn by the ui, the smoothed times of the store or the exact times of a frame of the history
+    struct shownTimes {
+        const double* startTimes = nullptr;
+        const double* endTimes = nullptr;
+        const double* elapsedTimes = nullptr;
+        const double* cpuStartTimes = nullptr;
+        const double* cpuEndTimes = nullptr;
+        const double* cpuElapsedTimes = nullptr;
+        const GLuint* counts = nullptr;
+    };
+    // a ring sector of the circular flame graph, the angles are in turns [0:1]
+    struct circularSector {
+        uint32_t zoneIdx = 0U;
+        int32_t ring = 0;
+        float start = 0.0f;
+        float end = 0.0f;
+        ImU32 color = 0U;
+        bool highlighted = false;  // by the label graph
+    };
+    // the nodes of the views for a zone of the store
+    struct aggregateLinks {
+        uint32_t bottomUpOffset = 0U;  // in m_BottomUpNodes, the node of the zone, then of each of its callers
+        uint32_t mergedNode = 0U;      // the zone by name
+        uint32_t mergedChildNode = InAppGpuAggregateTree::sInvalidIndex;  // the zone by name under its parent by name
+        uint32_t sectionNode = 0U;     // the zone by name under its section
+        bool isNested = false;         // the zone is in a zone of the same name, its time is already counted by the merged view
+    };
+    // a row of the details table, the expanded tree is flattened for the clipper
+    struct detailsRow {
+        uint32_t zoneIdx = 0U;
+        uint32_t depth = 0U;  // the indent of the row
+        bool hasChilds = false;
+    };
+    struct inspectedTimes {
+        std::vector<double> startTimes;
+        std::vector<double> endTimes;
+        std::vector<double> elapsedTimes;
+        std::vector<double> cpuStartTimes;
+        std::vector<double> cpuEndTimes;
+        std::vector<double> cpuElapsedTimes;
+        std::vector<GLuint> counts;
+    };
+
 private:
     IAGPContextWeak m_This;
     IAGP_GPU_CONTEXT m_Context;
-    IAGPQueryZonePtr m_RootZone = nullptr;
-    IAGPQueryZoneWeak m_SelectedQuery; // query to show the flamegraph in this context
-    std::unordered_map<GLuint, IAGPQueryZonePtr> m_QueryIDToZone;    // Get the zone for a query id because a query have to id's : start and end
-    std::unordered_map<GLuint, IAGPQueryZonePtr> m_DepthToLastZone;  // last zone registered at this depth
-    std::set<GLuint> m_PendingUpdate;                                // some queries msut but retrieveds
+    InAppGpuQueryPool m_QueryPool;
+    InAppGpuZoneStore m_Store;
+    uint32_t m_Generation = 0U;                                      // changed at each Clear, for invalidate the zone indexs
+    uint32_t m_SelectedZone = InAppGpuZoneStore::sInvalidIndex;      // zone to show the flamegraph in this context
+    std::vector<uint32_t> m_DepthToLastZone;                         // last zone registered at this depth
+    std::vector<int32_t> m_DrawRows;                                 // the row of the childs of each zone in the flame graph
+    std::vector<InAppGpuLodBlock> m_LodBlocks;                               // the current merged block of each row of the flame graph
+    std::vector<circularSector> m_CircularSectors;                   // the shown sectors of the circular flame graph, sorted by ring
+    std::vector<ImVec2> m_CircularTrig;                              // the cos/sin of the count_point + 1 points of the circle
+    int32_t m_CircularTrigCount = 0;                                 // the count_point of m_CircularTrig
+    std::vector<ImVec2> m_CircularOutline;                           // the points of the outline of a sector
+    std::vector<detailsRow> m_DetailsRows;                           // the rows of the details table, rebuilt only when dirty
+    std::vector<uint8_t> m_DetailsShownZones;                        // the zones with a time to show, updated by the collected zones
+    std::vector<uint32_t> m_DetailsChilds;                           // the shown childs of the zones in the flattening, by level
+    std::vector<double> m_DetailsSortValues;                         // the values of the sorted column, by zone
+    bool m_DetailsDirty = true;                                      // the tree, the expanded zones or the shown zones have changed
+    bool m_DetailsTimesChanged = false;                              // a frame was collected since the last sort
+    bool m_DetailsShownInspected = false;                            // m_DetailsShownZones is for an inspected frame
+    uint64_t m_DetailsShownFrameId = 0U;                             // the inspected frame of m_DetailsShownZones
+    double m_DetailsSortTime = 0.0;                                  // the imgui time of the last sort
+    InAppGpuDetailsColumnEnum m_DetailsSortColumn = InAppGpuDetailsColumnEnum::IN_APP_GPU_DETAILS_TREE;
+    bool m_DetailsSortDescending = false;
+    InAppGpuAggregateTree m_BottomUpTree;
+    InAppGpuAggregateTree m_MergedTree;
+    InAppGpuAggregateTree m_SectionsTree;
+    std::vector<aggregateLinks> m_AggregateLinks;                    // by zone, only added, so the views are updated incrementally
+    std::vector<uint32_t> m_BottomUpNodes;
+    std::vector<std::string> m_AggregateLabels;                      // the section and name of the zones
+    std::vector<double> m_AggregateTimes;                            // the times of the zones in the last frame, in ms
+    std::vector<double> m_AggregateSelfTimes;                        // without the times of the childs
+    std::vector<float> m_AggregateCursors;                           // the start of the next child of the nodes in the flame graph
+    uint32_t m_CurrentDepth = 0U;                                    // depth of the scope in recording
+    uint32_t m_MaxDepth = 0U;                                        // max depth catched ever
+    std::mutex m_Mutex;                                              // the store against the ui, only locked when the tree change
+    std::array<frameSlot, IAGP_FRAMES_IN_FLIGHT> m_FrameSlots;      // the frames in flight, the gpu is some frames late
+    std::vector<GLuint> m_ReadBackIds;                               // the queries of the frame to read
+    std::vector<GLuint64> m_ReadBackResults;                         // the results of the frame
+    std::vector<InAppGpuCollectedZone> m_CollectedZones;             // the timings of the last frame collected
+    std::vector<InAppGpuHistoryFrame> m_FrameHistory;                        // ring of the last IAGP_FRAME_HISTORY_COUNT frames collected
+    uint32_t m_FrameHistoryHead = 0U;                                // the next frame to write
+    uint32_t m_FrameHistoryCount = 0U;
+    bool m_IsFrameInspected = false;                                 // a frame of the history is shown in place of the smoothed times
+    uint64_t m_InspectedFrameId = 0U;
+    inspectedTimes m_InspectedTimes;
+    shownTimes m_Shown;                                              // updated at each draw
+    std::vector<InAppGpuTriggerRule> m_TriggerRules;                 // copy of the rules of the profiler
+    uint32_t m_TriggerRulesVersion = 0U;
+    bool m_HasMedianRules = false;
+    std::vector<uint32_t> m_TriggerMasks;                            // the rules of each zone, a bit per rule
+    std::vector<InAppGpuMedianSmoothing> m_TriggerMedians;           // the median of each zone, for the rules with a median factor
+    InAppGpuCapture m_PendingCapture;                                // waiting the frames after the fired frame
+    bool m_IsCapturePending = false;
+    bool m_PauseAfterCapture = false;
+    uint32_t m_CaptureFramesLeft = 0U;
+    uint64_t m_CurrentFrameId = 0U;                                  // the last frame started
+    uint64_t m_RetiredFrameId = 0U;                                  // the last frame retrieved
+    uint64_t m_NextCalibrationFrameId = 0U;                          // the frame where the clocks will be calibrated
+    int64_t m_ClockOffset = 0;                                       // gpu time - cpu time, at the last calibration
+    bool m_IsClockCalibrated = false;
+    bool m_IsFrameRecorded = true;                                   // false if not sampled, or if the slot is still owned by the collector thread
+    bool m_IsCostMeasured = false;                                   // the cpu time of the profiler is measured for the adaptive sampling
+    int64_t m_SamplingCost = 0;                                      // cpu time of the profiler since the last sampled frame, in ns
+    InAppGpuEmaSmoothing m_SampledFrameCost;                         // cpu time of the profiler per sampled frame, in us
+    uint32_t m_SamplingPeriod = 1U;                                  // the period of the adaptive sampling
+    uint64_t m_LastSampledFrameId = 0U;
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    bool m_UseCollector = false;                                     // the current frame is collected by the collector thread
+    InAppGpuSpscQueue<frameToken, IAGP_FRAMES_IN_FLIGHT> m_CollectorQueue;  // the frames ended, from the context thread to the collector thread
+    std::vector<GLuint64> m_CollectorResults;                        // used only by the collector thread
+#endif  // IAGP_USE_COLLECTOR_THREAD
 
 public:
     static IAGPContextPtr create(IAGP_GPU_CONTEXT vContext);
 
 public:
     InAppGpuGLContext(IAGP_GPU_CONTEXT vContext);
+    ~InAppGpuGLContext();
     void Clear();
     void Init();
     void Unit();
     void Collect();
+    void EndFrame();
+    void WriteStartTimeStamp(const uint32_t vZoneIdx, const uint32_t vGeneration);
+    void WriteEndTimeStamp(const uint32_t vZoneIdx, const uint32_t vGeneration);
+    uint32_t GetCurrentSlot() const;
+    uint32_t GetGeneration() const;
+    uint32_t& GetCurrentDepthRef();
+    uint32_t GetMaxDepth();
+    bool IsZoneAlive(const uint32_t vZoneIdx, const uint32_t vGeneration) const;
+    const InAppGpuZoneStore& GetZoneStore() const;
+    const InAppGpuQueryPool::poolStats& GetQueryPoolStats() const;
+    uint32_t GetSamplingPeriod() const;
+    double GetSamplingCost() const;
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+    size_t GetZoneTreeBytes();
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
     void DrawFlamGraph(const InAppGpuGraphTypeEnum& vGraphType);
-    void DrawDetails();
-    IAGPQueryZonePtr GetQueryZoneForName(const void* vPtr, const std::string& vName, const std::string& vSection = "", const bool vIsRoot = false);
+    bool DrawFlamGraph(const InAppGpuGraphTypeEnum& vGraphType, const uint32_t vZoneIdx, const uint32_t vGeneration, uint32_t& vOutSelectedZone);
+    void DrawDetails(const InAppGpuDetailsColumnEnum& vSortColumn, const bool vSortDescending);
+    void DrawAggregateFlamGraph(const InAppGpuViewEnum& vView);
+    void DrawAggregateDetails(const InAppGpuViewEnum& vView, const InAppGpuDetailsColumnEnum& vSortColumn, const bool vSortDescending);
+    const InAppGpuAggregateTree* GetAggregateTree(const InAppGpuViewEnum& vView) const;
+    void ResetStatistics();
+    bool InspectFrame(const InAppGpuHistoryFrame& vFrame);
+    std::string GetZoneTitle(const uint32_t vZoneIdx, const uint32_t vGeneration);
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    bool CollectFromThread();
+    void ReleaseCollectorFrames();
+#endif  // IAGP_USE_COLLECTOR_THREAD
+    uint32_t GetQueryZoneForName(const void* vPtr, const std::string& vName, const std::string& vSection = "", const bool vIsRoot = false);
+    uint32_t GetQueryZoneForCallSite(const void* vPtr, InAppGpuCallSite& vCallSite, const bool vIsRoot);
+    // rebuild the zones and the timings of a recorded capture, without gpu
+    uint32_t AddRecordedZone(const uint32_t vParentIdx, const std::string& vName, const std::string& vSection);
+    void ReplayFrame(const std::vector<InAppGpuCollectedZone>& vZones);
 
 private:
-    void m_SetQueryZoneForDepth(IAGPQueryZonePtr vQueryZone, GLuint vDepth);
-    IAGPQueryZonePtr m_GetQueryZoneFromDepth(GLuint vDepth);
+    uint32_t m_GetQueryZone(const void* vPtr, const char* vName, const char* vSection, const uint64_t vLabelHash, const bool vIsRoot);
+    uint32_t m_AddZone(const uint32_t vParentIdx, const void* vPtr, const char* vName, const char* vSection, const uint64_t vLabelHash, const bool vIsRoot);
+    void m_DrawFlamGraph(const InAppGpuGraphTypeEnum& vGraphType, const uint32_t vZoneIdx, uint32_t& vOutSelectedZone);
+    void m_BeginFrame();
+    bool m_IsFrameSampled();
+    bool m_IsZoneSampled(const uint32_t vZoneIdx) const;
+    bool m_IsFrameRetired(frameSlot& vSlot, const bool vWait);
+    void m_ReadBackFrame(const uint32_t vSlotIdx);
+    void m_ReleaseFrame(frameSlot& vSlot, const bool vIsRetired);
+    const GLuint* m_GetInvocationQueries(frameSlot& vSlot);
+    void m_CollectRecord(const readbackRecord& vRecord, const GLuint64 vValue, const uint32_t vSlotIdx, const int64_t vClockOffset, const GLuint vCount);
+    void m_CalibrateClocks();
+    void m_AddCollectedZone(const uint32_t vZoneIdx);
+    void m_OnFrameCollected(const uint64_t vFrameId);
+    void m_AddFrameToHistory(const uint64_t vFrameId);
+    void m_InspectFrame(const InAppGpuHistoryFrame& vFrame);
+    void m_CheckTriggers(const InAppGpuHistoryFrame& vFrame);
+    void m_StartCapture(const uint32_t vRuleIdx, const InAppGpuHistoryZone& vZone, const double vLimit);
+    void m_EndCapture();
+    void m_UpdateShownTimes();
+    void m_DrawFrameHistory();
+    int64_t m_GetClockOffset(const uint32_t vSlotIdx, const GLuint64* vResults);
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    void m_PushFrameToCollector(const uint32_t vSlotIdx);
+#endif  // IAGP_USE_COLLECTOR_THREAD
+    void m_SetQueryZoneForDepth(const uint32_t vZoneIdx, const uint32_t vDepth);
+    uint32_t m_GetQueryZoneFromDepth(const uint32_t vDepth);
+    void m_UpdateBreadCrumbTrail(const uint32_t vZoneIdx);
+    void m_DrawBreadCrumbTrail(const uint32_t vZoneIdx, uint32_t& vOutSelectedZone);
+    void m_UpdateDetailsRows(const InAppGpuDetailsColumnEnum& vSortColumn, const bool vSortDescending);
+    void m_UpdateDetailsShownZones(const std::vector<InAppGpuCollectedZone>& vZones);
+    uint8_t m_IsDetailsZoneShown(const uint32_t vZoneIdx, const double* vElapsedTimes) const;
+    void m_AddDetailsRows(const uint32_t vZoneIdx, const uint32_t vDepth);
+    double m_GetDetailsValue(const uint32_t vZoneIdx, const InAppGpuDetailsColumnEnum& vColumn) const;
+    void m_DrawDetailsRow(const detailsRow& vRow);
+    void m_ClearAggregates();
+    void m_MapZoneOnAggregates(const uint32_t vZoneIdx);
+    void m_UpdateAggregates(const std::vector<InAppGpuCollectedZone>& vZones);
+    InAppGpuAggregateTree* m_GetAggregateTree(const InAppGpuViewEnum& vView);
+    void m_DrawAggregateDetailsRow(InAppGpuAggregateTree& vTree, const uint32_t vNodeIdx, const InAppGpuDetailsColumnEnum& vSortColumn,
+                                   const bool vSortDescending);
+    void m_DrawList_DrawBar(const char* vLabel, const ImVec2& vLabelSize, const ImRect& vRect, const ImVec4& vColor, const bool vHovered);
+    bool m_ComputeRatios(const uint32_t vZoneIdx, const uint32_t vRootIdx, const uint32_t vParentIdx, float& vOutStartRatio, float& vOutSizeRatio);
+    bool m_DrawHorizontalFlameGraph(const uint32_t vRootIdx, uint32_t& vOutSelectedZone);
+    bool m_DrawCircularFlameGraph(const uint32_t vRootIdx, uint32_t& vOutSelectedZone);
+    void m_DrawZoneTooltip(const uint32_t vZoneIdx);
+    void m_UpdateCircularTrig(const int32_t vCount);
+    ImVec2 m_GetCircularPoint(const float vTurn) const;
 };
 
+// the depth of the scopes is kept by the context, so each thread record its own tree
 class IN_APP_GPU_PROFILER_API InAppGpuScopedZone {
 public:
-    static GLuint sCurrentDepth;  // current depth catched by Profiler
-    static GLuint sMaxDepth;      // max depth catched ever
-
-public:
-    IAGPQueryZonePtr queryPtr = nullptr;
+    uint32_t zoneIdx = InAppGpuZoneStore::sInvalidIndex;
+    uint32_t generation = 0U;
+    IAGPContextPtr contextPtr = nullptr;
 
 public:
     InAppGpuScopedZone(const bool vIsRoot, const void* vPtr, const std::string& vSection, const char* fmt, ...);
+    InAppGpuScopedZone(const bool vIsRoot, const void* vPtr, InAppGpuCallSite* vCallSite, ...);
     ~InAppGpuScopedZone();
+
+private:
+    void m_Start(const IAGPContextPtr& vContextPtr);
 };
 
 class IN_APP_GPU_PROFILER_API InAppGpuProfiler {
@@ -283,14 +1626,48 @@ public:
     typedef std::function<bool(const char*, bool*, ImGuiWindowFlags)> ImGuiBeginFunctor;
     typedef std::function<void()> ImGuiEndFunctor;
 
+private:
+    struct tabbedQueryZone {
+        IAGPContextWeak context;
+        uint32_t zoneIdx = 0U;
+        uint32_t generation = 0U;
+    };
+
 public:
     static bool sIsActive;
-    static bool sIsPaused;
+    static std::atomic<bool> sIsPaused;  // written by the ui and by the triggers, in the collecting thread
+    static InAppGpuSamplingEnum sSamplingMode;
+    static int32_t sSamplingPeriod;  // the nth frame recorded, or the count of subtrees in rotation
+    static float sSamplingBudget;    // in us per frame, for the adaptive sampling
 
 private:
     std::unordered_map<intptr_t, IAGPContextPtr> m_Contexts;
+    std::mutex m_ContextsMutex;                           // only locked for register a context, the threads keep their context
+    std::atomic<uint32_t> m_ContextsGeneration{0U};       // incremented at each Clear, for invalidate the contexts kept by the threads
+    std::vector<std::pair<intptr_t, IAGPContextPtr>> m_ContextsToDraw;  // copy of the contexts for the ui
+    std::vector<std::pair<intptr_t, IAGPContextPtr>> m_ContextsToRelease;  // cleared contexts, destroyed by the thread where they are current
+    std::atomic<uint32_t> m_ContextsToReleaseCount{0U};
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    std::thread m_CollectorThread;
+    std::atomic<bool> m_CollectorRunning{false};  // the contexts send their frames to the collector thread
+    std::atomic<bool> m_CollectorStopped{true};   // the collector thread is ended, the contexts can release their frames
+#endif  // IAGP_USE_COLLECTOR_THREAD
+#ifdef IAGP_USE_FLIGHT_RECORDER
+    InAppGpuFlightRecorder m_FlightRecorder;
+#endif  // IAGP_USE_FLIGHT_RECORDER
+    InAppGpuTraceExporter m_TraceExporter;
+    std::mutex m_TraceExporterMutex;
+    std::atomic<bool> m_IsTraceExporting{false};
+    uint64_t m_TraceFirstFrameId = 0U;                    // the range of frames to export, for each context
+    uint64_t m_TraceLastFrameId = 0U;
+    std::vector<InAppGpuTriggerRule> m_TriggerRules;
+    std::atomic<uint32_t> m_TriggerRulesVersion{0U};      // the contexts copy the rules when it change
+    std::vector<InAppGpuCapture> m_Captures;
+    std::mutex m_TriggersMutex;                           // the rules and the captures, against the collecting threads
     InAppGpuGraphTypeEnum m_GraphType = InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL;
-    IAGPQueryZoneWeak m_SelectedQuery;
+    InAppGpuViewEnum m_View = InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE;  // of the flame graph and of the details
+    std::vector<tabbedQueryZone> m_TabbedQueryZones;
+    uint32_t m_SelectedZone = InAppGpuZoneStore::sInvalidIndex;
     int32_t m_QueryZoneToClose = -1;
     ImGuiBeginFunctor m_ImGuiBeginFunctor =                                     //
         [](const char* vLabel, bool* pOpen, ImGuiWindowFlags vFlags) -> bool {  //
@@ -298,6 +1675,10 @@ private:
     };
     ImGuiEndFunctor m_ImGuiEndFunctor = []() { ImGui::End(); };
     bool m_ShowDetails = false;
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+    InAppGpuOverhead m_Overhead;
+    bool m_ShowOverhead = false;
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
 
 public:
     void Clear();
@@ -305,17 +1686,62 @@ public:
     void DrawFlamGraph(const char* vLabel, bool* pOpen, ImGuiWindowFlags vFlags = 0);
     void DrawFlamGraphNoWin();
     void DrawFlamGraphChilds(ImGuiWindowFlags vFlags = 0);
+    void OpenTabbedQueryZone(const IAGPContextWeak& vContext, const uint32_t vZoneIdx);
     void SetImGuiBeginFunctor(const ImGuiBeginFunctor& vImGuiBeginFunctor);
     void SetImGuiEndFunctor(const ImGuiEndFunctor& vImGuiEndFunctor);
     void DrawDetails(ImGuiWindowFlags vFlags = 0);
     void DrawDetailsNoWin();
+#ifdef IAGP_USE_SELF_INSTRUMENTATION
+    void DrawOverhead(ImGuiWindowFlags vFlags = 0);
+    void DrawOverheadNoWin();
+    InAppGpuOverhead& GetOverheadRef() {
+        return m_Overhead;
+    }
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+    void ResetStatistics();
     IAGPContextPtr GetContextPtr(IAGP_GPU_CONTEXT vContext);
+    void OnFrameCollected(IAGP_GPU_CONTEXT vContext, const uint32_t vGeneration, const uint64_t vFrameId, InAppGpuZoneStore& vStore,
+                          const std::vector<InAppGpuCollectedZone>& vZones);
+#ifdef IAGP_USE_FLIGHT_RECORDER
+    bool StartFlightRecorder(const std::string& vFilePathName, const size_t vSize = IAGP_FLIGHT_RECORDER_SIZE);
+    void StopFlightRecorder();
+    InAppGpuFlightRecorder& GetFlightRecorderRef();
+    static bool ExportFlightRecorderToTrace(const std::string& vRecorderFilePathName, const std::string& vTraceFilePathName,
+                                            const uint64_t vFirstFrameId = 0U, const uint64_t vLastFrameId = UINT64_MAX);
+#endif  // IAGP_USE_FLIGHT_RECORDER
+    // the frames collected from now, in the range of frame ids of each context, are written in a chrome trace json
+    bool StartTraceExport(const std::string& vFilePathName, const uint64_t vFirstFrameId = 0U, const uint64_t vLastFrameId = UINT64_MAX);
+    void StopTraceExport();
+    bool IsTraceExporting() const;
+    // the rules are checked on each collected frame, 32 rules max
+    uint32_t AddTriggerRule(const InAppGpuTriggerRule& vRule);
+    void ClearTriggerRules();
+    uint32_t GetTriggerRulesVersion() const;
+    void GetTriggerRules(std::vector<InAppGpuTriggerRule>& vOutRules, uint32_t& vOutVersion);
+    void AddCapture(InAppGpuCapture& vCapture);
+    std::vector<InAppGpuCapture> GetCaptures();
+    void ClearCaptures();
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    bool StartCollectorThread(IAGP_GPU_CONTEXT vSharedContext);
+    void StopCollectorThread();
+    bool IsCollectorThreadRunning() const;
+    bool IsCollectorThreadStopped() const;
+#endif  // IAGP_USE_COLLECTOR_THREAD
     InAppGpuGraphTypeEnum& GetGraphTypeRef() {
         return m_GraphType;
     }
+    InAppGpuViewEnum& GetViewRef() {
+        return m_View;
+    }
 
 private:
     void m_DrawMenuBar();
+    void m_DrawCapturesMenu();
+    const std::vector<std::pair<intptr_t, IAGPContextPtr>>& m_GetContextsToDraw();
+    void m_ReleaseContexts(IAGP_GPU_CONTEXT vThreadPtr);
+#ifdef IAGP_USE_COLLECTOR_THREAD
+    void m_CollectorLoop(IAGP_GPU_CONTEXT vSharedContext);
+#endif  // IAGP_USE_COLLECTOR_THREAD
 
 public:
     static InAppGpuProfiler* Instance() {
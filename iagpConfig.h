@@ -25,9 +25,24 @@
 // OPTIONNAL ///////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////
 
+// the backend doing the gpu calls, selected at compile time
+// InAppGpuGLBackend : opengl (default)
+// InAppGpuMockBackend : a fake gpu with a clock you control, for test or bench without gpu
+// InAppGpuVulkanBackend : vulkan, need IAGP_USE_VULKAN
+//#define IAGP_BACKEND InAppGpuMockBackend
+
+// enable the vulkan backend, you need to include vulkan/vulkan.h before
+//#define IAGP_USE_VULKAN
+
+// for a build without opengl, the gl types used by IAGP are defined by IAGP
+//#define IAGP_NO_OPENGL
+
 // the title of the profiler detail imgui windows
 //#define IAGP_DETAILS_TITLE "Profiler Details"
 
+// the title of the imgui window of the overhead of the profiler, see IAGP_USE_SELF_INSTRUMENTATION
+//#define IAGP_OVERHEAD_TITLE "Profiler Overhead"
+
 // the max level of recursion for profiler queries
 //#define IAGP_RECURSIVE_LEVELS_COUNT 20U
 
@@ -35,6 +50,80 @@
 // all the values will be smoothed on 60 frames (1s of 60fps diosplay)
 //#define IAGP_MEAN_AVERAGE_LEVELS_COUNT 60U
 
+// the median smoothing level, the median of the last 15 frames
+//#define IAGP_MEDIAN_LEVELS_COUNT 15U
+
+// the smoothing of the times of the zones :
+// InAppGpuEmaSmoothing (by default, 16 bytes per value), InAppGpuMeanSmoothing, InAppGpuMedianSmoothing
+// or InAppGpuRuntimeSmoothing for choose it in the menu bar, but its 40 time bigger than the ema
+//#define IAGP_SMOOTHING_POLICY InAppGpuEmaSmoothing
+
+// the count of parents a call site keep its zone for, a helper scope called from more parents
+// than that is searched by hash at each call
+//#define IAGP_CALL_SITE_PARENTS_COUNT 4U
+
+// the count of frames the gpu can be late before Collect wait for it
+// the metrics are retrieved this count of frames later, without stalling the cpu
+// 1 mean the cpu will wait the gpu at each Collect
+//#define IAGP_FRAMES_IN_FLIGHT 3U
+
+// the count of queries the query pool of a context allocate in one driver call
+// the pool stats (capacity, in use, high water) can help you to size it
+//#define IAGP_QUERY_POOL_CHUNK_SIZE 1024U
+
+// the max time in ns Collect can wait the gpu when all frames in flight are used
+//#define IAGP_FENCE_TIMEOUT 1000000000U
+
+// the count of frames between two calibrations of the cpu clock on the gpu clock
+//#define IAGP_CLOCK_CALIBRATION_PERIOD 60U
+
+// the count of last frames kept by each context, for the frame time chart and the inspection of a past frame
+// a frame use 24 bytes per zone
+//#define IAGP_FRAME_HISTORY_COUNT 600U
+
+// the count of captures of the trigger rules kept by the profiler, the oldest are removed
+//#define IAGP_CAPTURES_COUNT 16U
+
+// the count of frames captured before and after the frame where a trigger rule was fired
+//#define IAGP_CAPTURE_FRAMES_AROUND 5U
+
+// the width in pixels under which the bars of the flame graph are merged in one block when the lod is enabled
+//#define IAGP_LOD_MIN_BAR_WIDTH 2.0f
+
+// the period in ms of the sort of the details table when sorted by a time, the rows dont move at each frame
+//#define IAGP_DETAILS_SORT_PERIOD 250U
+
+// the default period of the sampling, each nth frame is recorded, or one of the n subtrees of the root by frame
+//#define IAGP_SAMPLING_PERIOD 4
+
+// the default budget in us per frame of the cpu time of the profiler, with the adaptive sampling
+//#define IAGP_SAMPLING_BUDGET 50.0f
+
+// the max period of the adaptive sampling, at least one frame is recorded on this count
+//#define IAGP_SAMPLING_MAX_PERIOD 64U
+
+// the count of bits of the buckets per power of two, in the histograms of the zones (min, max, percentiles)
+// a zone use 2 * (33 - bits) * 2^bits bytes, the error of a percentile is about 1 / 2^(bits + 1)
+//#define IAGP_HISTOGRAM_SUB_BUCKETS_BITS 3U
+
+// collect the metrics in a background thread, with its own context shared with the profiled contexts
+// need opengl 4.4 (or ARB_query_buffer_object), see InAppGpuProfiler::StartCollectorThread
+//#define IAGP_USE_COLLECTOR_THREAD
+
+// the time in ns the collector thread wait a frame, or sleep when there is nothing to collect
+//#define IAGP_COLLECTOR_WAIT_TIMEOUT 1000000U
+
+// measure the cpu time and the calls of the hot paths of the profiler, shown in the overhead window
+// with the memory held by the zone tree. without it, nothing is measured
+//#define IAGP_USE_SELF_INSTRUMENTATION
+
+// record the collected frames in a memory mapped file, see InAppGpuProfiler::StartFlightRecorder
+//#define IAGP_USE_FLIGHT_RECORDER
+
+// the size in bytes of the ring of frames, and of the zone names table, of the flight recorder file
+//#define IAGP_FLIGHT_RECORDER_SIZE 16777216U
+//#define IAGP_FLIGHT_RECORDER_STRINGS_SIZE 1048576U
+
 //the minimal size of imgui sub window, when you openif by click right on a progiler bar
 //#define IAGP_SUB_WINDOW_MIN_SIZE ImVec2(300, 100)
 
@@ -0,0 +1,392 @@
+﻿/*
+MIT License
+
+Copyright (c) 2021-2024 Stephane Cuillerdier (aka aiekick)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// iagp_bench : measure the hot paths of the profiler on synthetic zone trees, without gpu and without display
+// the timestamps are written by the mock backend, the ui is drawn in an offscreen imgui context
+//
+// usage : iagp_bench [-shape wide|deep|mixed] [-path name|callsite] [-zones N] [-frames N] [-draws N] [-json file.json]
+//  -shape  : the shape of the tree, all the shapes by default
+//     wide  : all the zones are childs of the root
+//     deep  : chains of IAGP_RECURSIVE_LEVELS_COUNT - 1 zones under the root
+//     mixed : passes, sub passes, draws and some nested draws, with pseudo random fanouts
+//  -path   : how the scopes find their zones, the two paths by default
+//     name     : the formatted label, hashed and searched at each call (GetQueryZoneForName)
+//     callsite : a call site descriptor by zone, like IAGPScoped, the zone is cached per parent (GetQueryZoneForCallSite)
+//  -zones  : the count of zones of the tree, 100, 1000, 5000, 10000 and 100000 by default
+//  -frames : the count of frames recorded and collected (30 by default), the first frame create the zones
+//  -draws  : the count of imgui frames where the flame graphs and the details are drawn (10 by default)
+//            the horizontal flame graph is drawn with and without the lod
+//  -json   : write the results in a json file, for compare them between two builds
+//
+// the times of the scopes and of the zone lookups come from the self instrumentation (IAGP_USE_SELF_INSTRUMENTATION)
+// the other times are measured around the calls, the record of a frame include the clock of the mock backend
+
+#include "iagp.h"
+
+#ifndef IAGP_USE_SELF_INSTRUMENTATION
+#error "iagp_bench need IAGP_USE_SELF_INSTRUMENTATION"
+#endif  // IAGP_USE_SELF_INSTRUMENTATION
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+using namespace iagp;
+
+struct benchTree {
+    std::string shape;
+    std::vector<uint32_t> firstChilds;  // the root is the zone 0
+    std::vector<uint32_t> nextSiblings;
+    std::vector<uint32_t> lastChilds;
+    std::vector<std::string> names;
+    std::vector<InAppGpuCallSite> callSites;  // by zone, the static descriptors of IAGPScoped, the names cant be literals here
+    uint32_t maxDepth = 0U;
+};
+
+struct benchResult {
+    std::string shape;
+    std::string path;
+    uint32_t zones = 0U;
+    uint32_t depth = 0U;
+    uint32_t frames = 0U;
+    double createMs = 0.0;          // the first frame, where the zones are created
+    double recordFrameUs = 0.0;     // a frame where the zones exist
+    double scopeNs = 0.0;           // the record of a frame by zone
+    double scopeBeginNs = 0.0;      // by call
+    double scopeEndNs = 0.0;
+    double getQueryZoneNs = 0.0;
+    double collectUs = 0.0;         // by frame
+    double drawHorizontalUs = 0.0;  // by imgui frame
+    double drawNoLodUs = 0.0;       // the horizontal flame graph without the lod
+    double drawCircularUs = 0.0;
+    double drawDetailsUs = 0.0;
+    uint64_t treeBytes = 0U;
+    uint32_t queries = 0U;
+};
+
+static int64_t GetTime() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a deterministic pseudo random generator, so the mixed trees are the same between two builds
+static uint32_t GetRandom(uint32_t& vSeed, const uint32_t vMin, const uint32_t vMax) {
+    vSeed = vSeed * 1664525U + 1013904223U;
+    return vMin + (vSeed >> 8U) % (vMax - vMin + 1U);
+}
+
+static uint32_t AddZone(benchTree& vTree, const uint32_t vParentIdx, const char* vPrefix) {
+    const uint32_t idx = (uint32_t)vTree.names.size();
+    vTree.firstChilds.push_back(InAppGpuZoneStore::sInvalidIndex);
+    vTree.nextSiblings.push_back(InAppGpuZoneStore::sInvalidIndex);
+    vTree.lastChilds.push_back(InAppGpuZoneStore::sInvalidIndex);
+    vTree.names.push_back(vPrefix + std::to_string(idx));  // the siblings must have different names, else they are the same zone
+    if (vParentIdx != InAppGpuZoneStore::sInvalidIndex) {
+        if (vTree.firstChilds[vParentIdx] == InAppGpuZoneStore::sInvalidIndex) {
+            vTree.firstChilds[vParentIdx] = idx;
+        } else {
+            vTree.nextSiblings[vTree.lastChilds[vParentIdx]] = idx;
+        }
+        vTree.lastChilds[vParentIdx] = idx;
+    }
+    return idx;
+}
+
+static void AddMixedZones(benchTree& vTree, const uint32_t vParentIdx, const uint32_t vDepth, const uint32_t vZonesCount, uint32_t& vSeed) {
+    // the fanouts by depth : sub passes, draws, nested draws
+    static const uint32_t s_MinFanouts[] = {2U, 4U, 0U, 0U};
+    static const uint32_t s_MaxFanouts[] = {12U, 40U, 6U, 3U};
+    static const char* s_Prefixes[] = {"sub pass ", "draw ", "nested draw ", "nested draw "};
+    if (vDepth > 4U) {
+        return;
+    }
+    const uint32_t fanout = GetRandom(vSeed, s_MinFanouts[vDepth - 1U], s_MaxFanouts[vDepth - 1U]);
+    for (uint32_t idx = 0U; idx < fanout && (uint32_t)vTree.names.size() < vZonesCount; ++idx) {
+        const uint32_t zone_idx = AddZone(vTree, vParentIdx, s_Prefixes[vDepth - 1U]);
+        vTree.maxDepth = (vDepth + 1U > vTree.maxDepth) ? vDepth + 1U : vTree.maxDepth;
+        AddMixedZones(vTree, zone_idx, vDepth + 1U, vZonesCount, vSeed);
+    }
+}
+
+static benchTree CreateTree(const std::string& vShape, const uint32_t vZonesCount) {
+    benchTree res;
+    res.shape = vShape;
+    AddZone(res, InAppGpuZoneStore::sInvalidIndex, "frame ");
+    if (vShape == "wide") {
+        res.maxDepth = 1U;
+        while ((uint32_t)res.names.size() < vZonesCount) {
+            AddZone(res, 0U, "zone ");
+        }
+    } else if (vShape == "deep") {
+        // the breadcrumb trail can show IAGP_RECURSIVE_LEVELS_COUNT levels
+        const uint32_t chain_size = IAGP_RECURSIVE_LEVELS_COUNT - 1U;
+        while ((uint32_t)res.names.size() < vZonesCount) {
+            uint32_t parent_idx = 0U;
+            for (uint32_t depth = 0U; depth < chain_size && (uint32_t)res.names.size() < vZonesCount; ++depth) {
+                parent_idx = AddZone(res, parent_idx, "zone ");
+                res.maxDepth = (depth + 1U > res.maxDepth) ? depth + 1U : res.maxDepth;
+            }
+        }
+    } else {
+        // the root have as many passes as needed for reach the count of zones
+        uint32_t seed = 12345U;
+        while ((uint32_t)res.names.size() < vZonesCount) {
+            const uint32_t pass_idx = AddZone(res, 0U, "pass ");
+            AddMixedZones(res, pass_idx, 1U, vZonesCount, seed);
+        }
+    }
+    return res;
+}
+
+// the descriptors point on the names, so they are created when the tree will not be moved anymore
+static void CreateCallSites(benchTree& vTree) {
+    vTree.callSites.clear();
+    vTree.callSites.reserve(vTree.names.size());
+    for (const auto& name : vTree.names) {
+        vTree.callSites.emplace_back("Bench", name.c_str(), HashZoneLabel("Bench", name.c_str()), false);
+    }
+}
+
+static void RecordChilds(benchTree& vTree, const uint32_t vZoneIdx, const bool vUseCallSites);
+
+static void RecordZone(benchTree& vTree, const uint32_t vZoneIdx, const bool vUseCallSites) {
+    if (vUseCallSites) {
+        InAppGpuScopedZone zone(false, nullptr, &vTree.callSites[vZoneIdx]);
+        RecordChilds(vTree, vZoneIdx, vUseCallSites);
+    } else {
+        InAppGpuScopedZone zone(false, nullptr, "Bench", "%s", vTree.names[vZoneIdx].c_str());
+        RecordChilds(vTree, vZoneIdx, vUseCallSites);
+    }
+}
+
+static void RecordChilds(benchTree& vTree, const uint32_t vZoneIdx, const bool vUseCallSites) {
+    if (vTree.firstChilds[vZoneIdx] == InAppGpuZoneStore::sInvalidIndex) {
+        InAppGpuMockBackend::AdvanceClock(1000U);  // the leafs take 1 us on the fake gpu
+    }
+    for (uint32_t idx = vTree.firstChilds[vZoneIdx]; idx != InAppGpuZoneStore::sInvalidIndex; idx = vTree.nextSiblings[idx]) {
+        RecordZone(vTree, idx, vUseCallSites);
+    }
+}
+
+static void RecordFrame(benchTree& vTree, const bool vUseCallSites) {
+    if (vUseCallSites) {
+        InAppGpuScopedZone zone(true, nullptr, &vTree.callSites[0]);
+        RecordChilds(vTree, 0U, vUseCallSites);
+    } else {
+        InAppGpuScopedZone zone(true, nullptr, "Bench", "%s", vTree.names[0].c_str());
+        RecordChilds(vTree, 0U, vUseCallSites);
+    }
+}
+
+// the mean time by call of a counter of the overhead, between two states of the counters
+static double GetCallTime(const InAppGpuOverhead::counter& vStart, const InAppGpuOverhead::counter& vEnd) {
+    const uint64_t calls = vEnd.calls - vStart.calls;
+    return (calls > 0U) ? (double)(vEnd.time - vStart.time) / (double)calls : 0.0;
+}
+
+// an imgui frame with the flame graph and the details, return the time of the drawing of the profiler in ns
+static int64_t DrawFrame(const InAppGpuGraphTypeEnum& vGraphType, const bool vDrawDetails) {
+    auto* profiler_ptr = InAppGpuProfiler::Instance();
+    profiler_ptr->GetGraphTypeRef() = vGraphType;
+    int64_t res = 0;
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowSize(ImVec2(1920.0f, 540.0f));
+    if (ImGui::Begin("Flame Graph", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_MenuBar)) {
+        const int64_t start = GetTime();
+        if (vDrawDetails) {
+            profiler_ptr->DrawDetailsNoWin();
+        } else {
+            profiler_ptr->DrawFlamGraphNoWin();
+        }
+        res = GetTime() - start;
+    }
+    ImGui::End();
+    ImGui::Render();
+    return res;
+}
+
+static double DrawFrames(const InAppGpuGraphTypeEnum& vGraphType, const bool vDrawDetails, const uint32_t vDrawsCount) {
+    DrawFrame(vGraphType, vDrawDetails);  // the first frame compute the sizes and the labels
+    int64_t time = 0;
+    for (uint32_t idx = 0U; idx < vDrawsCount; ++idx) {
+        time += DrawFrame(vGraphType, vDrawDetails);
+    }
+    return (double)time * 1e-3 / (double)vDrawsCount;
+}
+
+static benchResult RunBench(benchTree& vTree, const bool vUseCallSites, const uint32_t vFramesCount, const uint32_t vDrawsCount) {
+    auto* profiler_ptr = InAppGpuProfiler::Instance();
+    profiler_ptr->Clear();
+    InAppGpuMockBackend::Reset();
+
+    benchResult res;
+    res.shape = vTree.shape;
+    res.path = vUseCallSites ? "callsite" : "name";
+    res.zones = (uint32_t)vTree.names.size();
+    res.depth = vTree.maxDepth;
+    res.frames = vFramesCount;
+
+    // the first frame create the zones
+    int64_t start = GetTime();
+    RecordFrame(vTree, vUseCallSites);
+    res.createMs = (double)(GetTime() - start) * 1e-6;
+    IAGPCollect;
+
+    auto& overhead = profiler_ptr->GetOverheadRef();
+    const auto begin_start = overhead.Get(InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_SCOPE_BEGIN);
+    const auto end_start = overhead.Get(InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_SCOPE_END);
+    const auto query_zone_start = overhead.Get(InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_GET_QUERY_ZONE);
+    int64_t record_time = 0;
+    int64_t collect_time = 0;
+    for (uint32_t idx = 1U; idx < vFramesCount; ++idx) {
+        start = GetTime();
+        RecordFrame(vTree, vUseCallSites);
+        const int64_t end = GetTime();
+        IAGPCollect;
+        record_time += end - start;
+        collect_time += GetTime() - end;
+    }
+    const uint32_t frames_count = (vFramesCount > 1U) ? vFramesCount - 1U : 1U;
+    res.recordFrameUs = (double)record_time * 1e-3 / (double)frames_count;
+    res.scopeNs = res.recordFrameUs * 1e3 / (double)res.zones;
+    res.collectUs = (double)collect_time * 1e-3 / (double)frames_count;
+    res.scopeBeginNs = GetCallTime(begin_start, overhead.Get(InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_SCOPE_BEGIN));
+    res.scopeEndNs = GetCallTime(end_start, overhead.Get(InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_SCOPE_END));
+    res.getQueryZoneNs = GetCallTime(query_zone_start, overhead.Get(InAppGpuOverheadEnum::IN_APP_GPU_OVERHEAD_GET_QUERY_ZONE));
+
+    res.drawHorizontalUs = DrawFrames(InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL, false, vDrawsCount);
+    InAppGpuQueryZone::sUseLod = false;
+    res.drawNoLodUs = DrawFrames(InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL, false, vDrawsCount);
+    InAppGpuQueryZone::sUseLod = true;
+    res.drawCircularUs = DrawFrames(InAppGpuGraphTypeEnum::IN_APP_GPU_CIRCULAR, false, vDrawsCount);
+    res.drawDetailsUs = DrawFrames(InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL, true, vDrawsCount);
+
+    auto context_ptr = profiler_ptr->GetContextPtr(iagp_bench::GetCurrentContext());
+    if (context_ptr != nullptr) {
+        res.treeBytes = (uint64_t)context_ptr->GetZoneTreeBytes();
+        res.queries = context_ptr->GetQueryPoolStats().capacity;
+    }
+    return res;
+}
+
+static bool WriteJson(const std::string& vFilePathName, const std::vector<benchResult>& vResults) {
+    FILE* file_ptr = fopen(vFilePathName.c_str(), "wb");
+    if (file_ptr == nullptr) {
+        return false;
+    }
+    fprintf(file_ptr, "{\n  \"results\": [\n");
+    for (size_t idx = 0U; idx < vResults.size(); ++idx) {
+        const auto& r = vResults[idx];
+        fprintf(file_ptr,
+                "    {\"shape\": \"%s\", \"path\": \"%s\", \"zones\": %u, \"depth\": %u, \"frames\": %u, \"create_ms\": %.4f, "
+                "\"record_frame_us\": %.3f, \"scope_ns\": %.2f, \"scope_begin_ns\": %.2f, \"scope_end_ns\": %.2f, \"get_query_zone_ns\": %.2f, "
+                "\"collect_us\": %.3f, \"draw_horizontal_us\": %.3f, \"draw_horizontal_nolod_us\": %.3f, \"draw_circular_us\": %.3f, "
+                "\"draw_details_us\": %.3f, \"tree_bytes\": %llu, \"queries\": %u}%s\n",
+                r.shape.c_str(), r.path.c_str(), r.zones, r.depth, r.frames, r.createMs, r.recordFrameUs, r.scopeNs, r.scopeBeginNs, r.scopeEndNs,
+                r.getQueryZoneNs, r.collectUs, r.drawHorizontalUs, r.drawNoLodUs, r.drawCircularUs, r.drawDetailsUs,
+                (unsigned long long)r.treeBytes, r.queries, (idx + 1U < vResults.size()) ? "," : "");
+    }
+    fprintf(file_ptr, "  ]\n}\n");
+    fclose(file_ptr);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> shapes = {"wide", "deep", "mixed"};
+    std::vector<std::string> paths = {"name", "callsite"};
+    std::vector<uint32_t> zones_counts = {100U, 1000U, 5000U, 10000U, 100000U};
+    uint32_t frames_count = 30U;
+    uint32_t draws_count = 10U;
+    std::string json_file;
+    for (int idx = 1; idx + 1 < argc; idx += 2) {
+        if (strcmp(argv[idx], "-shape") == 0) {
+            shapes = {argv[idx + 1]};
+        } else if (strcmp(argv[idx], "-path") == 0) {
+            paths = {argv[idx + 1]};
+        } else if (strcmp(argv[idx], "-zones") == 0) {
+            zones_counts = {(uint32_t)strtoul(argv[idx + 1], nullptr, 10)};
+        } else if (strcmp(argv[idx], "-frames") == 0) {
+            frames_count = (uint32_t)strtoul(argv[idx + 1], nullptr, 10);
+        } else if (strcmp(argv[idx], "-draws") == 0) {
+            draws_count = (uint32_t)strtoul(argv[idx + 1], nullptr, 10);
+        } else if (strcmp(argv[idx], "-json") == 0) {
+            json_file = argv[idx + 1];
+        } else {
+            printf("usage : %s [-shape wide|deep|mixed] [-path name|callsite] [-zones N] [-frames N] [-draws N] [-json file.json]\n", argv[0]);
+            return 1;
+        }
+    }
+    frames_count = (frames_count < 1U) ? 1U : frames_count;
+    draws_count = (draws_count < 1U) ? 1U : draws_count;
+
+    // the profiler need to be active for record the zones, the mock backend replace the gpu
+    InAppGpuProfiler::sIsActive = true;
+
+    ImGuiContext* imgui_context_ptr = ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);  // the atlas must be built, but no texture is needed
+
+    printf("%6s | %8s | %7s | %5s | %10s | %12s | %9s | %9s | %9s | %9s | %10s | %10s | %10s | %10s | %10s | %10s\n",  //
+           "shape", "path", "zones", "depth", "create ms", "record us", "scope ns", "begin ns", "end ns", "lookup ns", "collect us", "flame us",
+           "no lod us", "circle us", "details us", "tree KB");
+    std::vector<benchResult> results;
+    for (const auto& shape : shapes) {
+        if (shape != "wide" && shape != "deep" && shape != "mixed") {
+            printf("unknown shape %s\n", shape.c_str());
+            continue;
+        }
+        for (const auto zones_count : zones_counts) {
+            auto tree = CreateTree(shape, (zones_count < 1U) ? 1U : zones_count);
+            CreateCallSites(tree);
+            for (const auto& path : paths) {
+                if (path != "name" && path != "callsite") {
+                    printf("unknown path %s\n", path.c_str());
+                    continue;
+                }
+                const auto r = RunBench(tree, path == "callsite", frames_count, draws_count);
+                printf("%6s | %8s | %7u | %5u | %10.3f | %12.2f | %9.1f | %9.1f | %9.1f | %9.1f | %10.2f | %10.2f | %10.2f | %10.2f | %10.2f | %10.1f\n",  //
+                       r.shape.c_str(), r.path.c_str(), r.zones, r.depth, r.createMs, r.recordFrameUs, r.scopeNs, r.scopeBeginNs, r.scopeEndNs,
+                       r.getQueryZoneNs, r.collectUs, r.drawHorizontalUs, r.drawNoLodUs, r.drawCircularUs, r.drawDetailsUs,
+                       (double)r.treeBytes / 1024.0);
+                results.push_back(r);
+            }
+        }
+    }
+    InAppGpuProfiler::Instance()->Clear();
+    ImGui::DestroyContext(imgui_context_ptr);
+
+    if (!json_file.empty()) {
+        if (!WriteJson(json_file, results)) {
+            printf("cant write the results in %s\n", json_file.c_str());
+            return 1;
+        }
+        printf("results written in %s\n", json_file.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+﻿/*
+MIT License
+
+Copyright (c) 2021-2024 Stephane Cuillerdier (aka aiekick)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// the config of iagp_bench, see iagpConfig.h for the other settings
+// the scopes of the bench are recorded in one fake context
+
+#pragma once
+
+#include "iagpConfig.h"
+
+namespace iagp_bench {
+inline void* GetCurrentContext() {
+    static int s_Context = 0;
+    return &s_Context;
+}
+inline void SetCurrentContext(void* /*vContextPtr*/) {
+}
+}  // namespace iagp_bench
+
+#define IAGP_GET_CURRENT_CONTEXT iagp_bench::GetCurrentContext
+#define IAGP_SET_CURRENT_CONTEXT iagp_bench::SetCurrentContext
@@ -0,0 +1,271 @@
+﻿/*
+MIT License
+
+Copyright (c) 2021-2024 Stephane Cuillerdier (aka aiekick)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// iagp_replay : analyse a flight recorder capture, without gpu and without display
+// the zones of the capture are rebuilt in profiler contexts, with the mock backend
+//
+// usage : iagp_replay capture.iagpfr [-top N] [-first FRAME] [-last FRAME] [-svg file.svg]
+//  -top   : the count of zones to print, sorted by gpu time (10 by default)
+//  -first : the first frame to analyse
+//  -last  : the last frame to analyse
+//  -svg   : draw the horizontal flame graph of the last frame of each context with an offscreen imgui context
+//           only the bars are written, the labels are textured by imgui
+
+#include "iagp.h"
+
+#include <map>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using namespace iagp;
+
+struct zoneStats {
+    uint64_t framesCount = 0U;
+    uint64_t callsCount = 0U;
+    double gpuTotal = 0.0;  // in ms
+    double gpuMin = DBL_MAX;
+    double gpuMax = 0.0;
+    uint64_t cpuFramesCount = 0U;
+    double cpuTotal = 0.0;
+};
+
+struct replayContext {
+    uint64_t context = 0U;
+    uint32_t generation = 0U;
+    IAGPContextPtr contextPtr = nullptr;
+    std::vector<zoneStats> stats;  // by zone
+};
+
+struct zoneRank {
+    const replayContext* replayPtr = nullptr;
+    uint32_t zoneIdx = 0U;
+};
+
+typedef std::pair<uint64_t, uint32_t> contextKey;  // context, generation
+
+static std::string GetZonePath(const InAppGpuZoneStore& vStore, const uint32_t vZoneIdx) {
+    std::string res = vStore.zones[vZoneIdx].name;
+    for (uint32_t parent_idx = vStore.parents[vZoneIdx]; parent_idx != InAppGpuZoneStore::sInvalidIndex; parent_idx = vStore.parents[parent_idx]) {
+        res = vStore.zones[parent_idx].name + " > " + res;
+    }
+    return res;
+}
+
+static void AddZonesUntil(replayContext& vReplay, const uint32_t vZoneIdx) {
+    // the names can be missing if the string table of the capture was full
+    while (vReplay.contextPtr->GetZoneStore().size() <= vZoneIdx) {
+        const uint32_t parent_idx = (vReplay.contextPtr->GetZoneStore().size() == 0U) ? InAppGpuZoneStore::sInvalidIndex : 0U;
+        vReplay.contextPtr->AddRecordedZone(parent_idx, "?", "?");
+    }
+    if (vReplay.stats.size() <= vZoneIdx) {
+        vReplay.stats.resize(vZoneIdx + 1U);
+    }
+}
+
+static replayContext& GetReplayContext(std::map<contextKey, replayContext>& vReplays, const std::vector<InAppGpuFlightRecorder::recordedName>& vNames,
+                                       const uint64_t vContext, const uint32_t vGeneration) {
+    const contextKey key(vContext, vGeneration);
+    auto it = vReplays.find(key);
+    if (it != vReplays.end()) {
+        return it->second;
+    }
+    auto& replay = vReplays[key];
+    replay.context = vContext;
+    replay.generation = vGeneration;
+    replay.contextPtr = InAppGpuGLContext::create((IAGP_GPU_CONTEXT)(intptr_t)vContext);
+    // the names are sorted by zone, a parent is always before its childs
+    for (const auto& name : vNames) {
+        if (name.context == vContext && name.generation == vGeneration) {
+            if (name.zoneIdx > 0U) {
+                AddZonesUntil(replay, name.zoneIdx - 1U);
+            }
+            if (replay.contextPtr->GetZoneStore().size() == name.zoneIdx) {
+                replay.contextPtr->AddRecordedZone(name.parentIdx, name.name, name.section);
+            }
+        }
+    }
+    return replay;
+}
+
+static bool RenderFlameGraphToSvg(const IAGPContextPtr& vContextPtr, const std::string& vFilePathName, const ImVec2& vSize) {
+    ImGuiContext* imgui_context_ptr = ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = vSize;
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);  // the atlas must be built, but no texture is needed
+    for (int frame_idx = 0; frame_idx < 2; ++frame_idx) {     // the first frame compute the sizes
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+        ImGui::SetNextWindowSize(vSize);
+        if (ImGui::Begin("Flame Graph", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_MenuBar)) {
+            vContextPtr->DrawFlamGraph(InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL);
+        }
+        ImGui::End();
+        ImGui::Render();
+    }
+
+    bool res = false;
+    FILE* file_ptr = fopen(vFilePathName.c_str(), "wb");
+    if (file_ptr != nullptr) {
+        fprintf(file_ptr, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\">\n", vSize.x, vSize.y);
+        const ImVec2 white_uv = io.Fonts->TexUvWhitePixel;
+        const auto is_solid = [&white_uv](const ImDrawVert& vVert) { return (vVert.uv.x == white_uv.x && vVert.uv.y == white_uv.y); };
+        const ImDrawData* draw_data_ptr = ImGui::GetDrawData();
+        for (int list_idx = 0; list_idx < draw_data_ptr->CmdListsCount; ++list_idx) {
+            const ImDrawList* list_ptr = draw_data_ptr->CmdLists[list_idx];
+            for (const auto& cmd : list_ptr->CmdBuffer) {
+                for (unsigned int idx = cmd.IdxOffset; idx + 2U < cmd.IdxOffset + cmd.ElemCount; idx += 3U) {
+                    const ImDrawVert& v0 = list_ptr->VtxBuffer[(int)(cmd.VtxOffset + list_ptr->IdxBuffer[(int)idx])];
+                    const ImDrawVert& v1 = list_ptr->VtxBuffer[(int)(cmd.VtxOffset + list_ptr->IdxBuffer[(int)idx + 1])];
+                    const ImDrawVert& v2 = list_ptr->VtxBuffer[(int)(cmd.VtxOffset + list_ptr->IdxBuffer[(int)idx + 2])];
+                    if (!is_solid(v0) || !is_solid(v1) || !is_solid(v2)) {
+                        continue;  // a glyph
+                    }
+                    fprintf(file_ptr, "<polygon points=\"%.1f,%.1f %.1f,%.1f %.1f,%.1f\" fill=\"rgb(%u,%u,%u)\" fill-opacity=\"%.2f\"/>\n",  //
+                            v0.pos.x, v0.pos.y, v1.pos.x, v1.pos.y, v2.pos.x, v2.pos.y,                                               //
+                            (v0.col >> IM_COL32_R_SHIFT) & 0xFF, (v0.col >> IM_COL32_G_SHIFT) & 0xFF, (v0.col >> IM_COL32_B_SHIFT) & 0xFF,
+                            (float)((v0.col >> IM_COL32_A_SHIFT) & 0xFF) / 255.0f);
+                }
+            }
+        }
+        fprintf(file_ptr, "</svg>\n");
+        fclose(file_ptr);
+        res = true;
+    }
+    ImGui::DestroyContext(imgui_context_ptr);
+    return res;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage : %s capture.iagpfr [-top N] [-first FRAME] [-last FRAME] [-svg file.svg]\n", argv[0]);
+        return 1;
+    }
+    std::string capture_file = argv[1];
+    std::string svg_file;
+    uint32_t top_count = 10U;
+    uint64_t first_frame = 0U;
+    uint64_t last_frame = UINT64_MAX;
+    for (int idx = 2; idx + 1 < argc; idx += 2) {
+        if (strcmp(argv[idx], "-top") == 0) {
+            top_count = (uint32_t)strtoul(argv[idx + 1], nullptr, 10);
+        } else if (strcmp(argv[idx], "-first") == 0) {
+            first_frame = strtoull(argv[idx + 1], nullptr, 10);
+        } else if (strcmp(argv[idx], "-last") == 0) {
+            last_frame = strtoull(argv[idx + 1], nullptr, 10);
+        } else if (strcmp(argv[idx], "-svg") == 0) {
+            svg_file = argv[idx + 1];
+        }
+    }
+
+    // the profiler need to be active for register the zones, the mock backend replace the gpu
+    InAppGpuProfiler::sIsActive = true;
+
+    std::vector<InAppGpuFlightRecorder::recordedName> names;
+    std::map<contextKey, replayContext> replays;
+    uint64_t frames_count = 0U;
+    const auto name_functor = [&names](const InAppGpuFlightRecorder::recordedName& vName) { names.push_back(vName); };
+    const auto frame_functor = [&](const InAppGpuFlightRecorder::recordedFrame& vFrame) {
+        if (vFrame.frameId < first_frame || vFrame.frameId > last_frame) {
+            return;
+        }
+        if (frames_count == 0U) {
+            std::sort(names.begin(), names.end(),  //
+                      [](const InAppGpuFlightRecorder::recordedName& a, const InAppGpuFlightRecorder::recordedName& b) { return a.zoneIdx < b.zoneIdx; });
+        }
+        ++frames_count;
+        auto& replay = GetReplayContext(replays, names, vFrame.context, vFrame.generation);
+        for (const auto& zone : vFrame.zones) {
+            AddZonesUntil(replay, zone.zoneIdx);
+            auto& stats = replay.stats[zone.zoneIdx];
+            const double gpu_time = (double)(zone.endTimeStamp - zone.startTimeStamp) * 1e-6;
+            ++stats.framesCount;
+            stats.callsCount += zone.count;
+            stats.gpuTotal += gpu_time;
+            stats.gpuMin = (gpu_time < stats.gpuMin) ? gpu_time : stats.gpuMin;
+            stats.gpuMax = (gpu_time > stats.gpuMax) ? gpu_time : stats.gpuMax;
+            if (zone.cpuEndTimeStamp > 0U) {
+                ++stats.cpuFramesCount;
+                stats.cpuTotal += (double)(zone.cpuEndTimeStamp - zone.cpuStartTimeStamp) * 1e-6;
+            }
+        }
+        replay.contextPtr->ReplayFrame(vFrame.zones);
+    };
+    if (!InAppGpuFlightRecorder::Load(capture_file, name_functor, frame_functor)) {
+        printf("cant load the capture %s\n", capture_file.c_str());
+        return 1;
+    }
+
+    printf("capture : %s\n", capture_file.c_str());
+    printf("frames : %llu, contexts : %u\n", (unsigned long long)frames_count, (uint32_t)replays.size());
+
+    std::vector<zoneRank> ranks;
+    for (const auto& replay : replays) {
+        for (uint32_t zone_idx = 0U; zone_idx < (uint32_t)replay.second.stats.size(); ++zone_idx) {
+            if (replay.second.stats[zone_idx].framesCount > 0U) {
+                ranks.push_back({&replay.second, zone_idx});
+            }
+        }
+    }
+    std::sort(ranks.begin(), ranks.end(), [](const zoneRank& a, const zoneRank& b) {  //
+        return a.replayPtr->stats[a.zoneIdx].gpuTotal > b.replayPtr->stats[b.zoneIdx].gpuTotal;
+    });
+    if (ranks.size() > top_count) {
+        ranks.resize(top_count);
+    }
+
+    printf("\ntop %u zones by gpu time :\n", (uint32_t)ranks.size());
+    printf("%4s | %12s | %10s | %10s | %10s | %10s | %10s | %10s | %8s | %s\n",  //
+           "rank", "total ms", "mean ms", "min ms", "p95 ms", "p99 ms", "max ms", "cpu ms", "calls", "zone");
+    for (size_t idx = 0U; idx < ranks.size(); ++idx) {
+        const auto& replay = *ranks[idx].replayPtr;
+        const auto& stats = replay.stats[ranks[idx].zoneIdx];
+        const double cpu_mean = (stats.cpuFramesCount > 0U) ? stats.cpuTotal / (double)stats.cpuFramesCount : 0.0;
+        const auto percentiles = replay.contextPtr->GetZoneStore().zones[ranks[idx].zoneIdx].histogram.GetPercentiles();
+        printf("%4u | %12.4f | %10.5f | %10.5f | %10.5f | %10.5f | %10.5f | %10.5f | %8.2f | [0x%llx] %s\n",  //
+               (uint32_t)idx + 1U, stats.gpuTotal, stats.gpuTotal / (double)stats.framesCount, stats.gpuMin,  //
+               percentiles.p95 * 1e-6, percentiles.p99 * 1e-6, stats.gpuMax, cpu_mean,
+               (double)stats.callsCount / (double)stats.framesCount, (unsigned long long)replay.context,
+               GetZonePath(replay.contextPtr->GetZoneStore(), ranks[idx].zoneIdx).c_str());
+    }
+
+    if (!svg_file.empty()) {
+        uint32_t svg_idx = 0U;
+        for (const auto& replay : replays) {
+            const std::string file = (svg_idx == 0U) ? svg_file : svg_file + "." + std::to_string(svg_idx) + ".svg";
+            if (RenderFlameGraphToSvg(replay.second.contextPtr, file, ImVec2(1920.0f, 400.0f))) {
+                printf("flame graph of context 0x%llx written in %s\n", (unsigned long long)replay.second.context, file.c_str());
+            }
+            ++svg_idx;
+        }
+    }
+
+    replays.clear();
+    return 0;
+}
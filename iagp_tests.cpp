@@ -0,0 +1,847 @@
+﻿/*
+MIT License
+
+Copyright (c) 2021-2024 Stephane Cuillerdier (aka aiekick)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// iagp_tests : the tests of the profiler, without gpu and without display
+// the timestamps are written by the mock backend, so the timings are deterministic
+//
+// usage : iagp_tests [test name], all the tests by default
+// return 0 if all the checks pass
+
+#include "iagp.h"
+
+#ifndef IAGP_USE_FLIGHT_RECORDER
+#error "iagp_tests need IAGP_USE_FLIGHT_RECORDER"
+#endif  // IAGP_USE_FLIGHT_RECORDER
+
+#include <cstring>
+#include <thread>
+
+using namespace iagp;
+
+static uint32_t s_FailedChecks = 0U;
+
+#define IAGP_CHECK(COND)                                                              \
+    if (!(COND)) {                                                                    \
+        printf("%s:%i : check failed : %s\n", __FILE__, __LINE__, #COND);            \
+        ++s_FailedChecks;                                                             \
+    }
+
+// a fresh profiler and a fresh fake gpu, the scopes are recorded in vContextPtr
+static IAGPContextPtr BeginTest(void* vContextPtr, const GLuint64 vLatency) {
+    InAppGpuProfiler::sIsActive = true;
+    InAppGpuProfiler::Instance()->Clear();
+    InAppGpuMockBackend::Reset();
+    InAppGpuMockBackend::SetLatency(vLatency);
+    iagp_tests::SetCurrentContext(vContextPtr);
+    return (vContextPtr != nullptr) ? InAppGpuProfiler::Instance()->GetContextPtr(vContextPtr) : nullptr;
+}
+
+static uint32_t FindZone(const InAppGpuZoneStore& vStore, const uint32_t vParentIdx, const char* vName) {
+    for (uint32_t idx = 0U; idx < vStore.size(); ++idx) {
+        if (vStore.parents[idx] == vParentIdx && vStore.zones[idx].name == vName) {
+            return idx;
+        }
+    }
+    return InAppGpuZoneStore::sInvalidIndex;
+}
+
+////////////////////////////////////////////////////////////
+/////////////////////// FRAME RING /////////////////////////
+////////////////////////////////////////////////////////////
+
+// a frame is read back when the gpu retired it, and Collect only wait for the frame
+// whose slot will be reused, so the timings are IAGP_FRAMES_IN_FLIGHT - 1 frames late
+static void TestFrameRing() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 100000000U);  // the fake gpu is late of 100 frames
+    const auto& store = context_ptr->GetZoneStore();
+    std::vector<GLuint64> collected_times;
+    for (uint32_t frame_idx = 0U; frame_idx < 20U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            IAGPScoped("Tests", "Draw");
+            InAppGpuMockBackend::AdvanceClock(1000U * (frame_idx + 1U));  // each frame have its own time
+        }
+        IAGPCollect;
+        const uint32_t draw_idx = FindZone(store, 0U, "Draw");
+        if (draw_idx != InAppGpuZoneStore::sInvalidIndex && store.lastCounts[draw_idx] > 0U) {
+            collected_times.push_back(store.zones[draw_idx].invocationSumTime);
+        } else {
+            collected_times.push_back(0U);
+        }
+    }
+    // no frame is lost or read twice, and the gpu is waited only when the ring is full
+    const uint32_t lag = IAGP_FRAMES_IN_FLIGHT - 1U;
+    for (uint32_t frame_idx = 0U; frame_idx < 20U; ++frame_idx) {
+        const GLuint64 expected = (frame_idx >= lag) ? 1000U * (frame_idx - lag + 1U) : 0U;
+        IAGP_CHECK(collected_times[frame_idx] == expected);
+    }
+}
+
+// without latency the frame is read back by the Collect after its end
+static void TestFrameRingNoLatency() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 0U);
+    const auto& store = context_ptr->GetZoneStore();
+    for (uint32_t frame_idx = 0U; frame_idx < 10U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            IAGPScoped("Tests", "Draw");
+            InAppGpuMockBackend::AdvanceClock(1000U * (frame_idx + 1U));
+        }
+        IAGPCollect;
+        const uint32_t draw_idx = FindZone(store, 0U, "Draw");
+        IAGP_CHECK(draw_idx != InAppGpuZoneStore::sInvalidIndex);
+        if (draw_idx != InAppGpuZoneStore::sInvalidIndex) {
+            IAGP_CHECK(store.zones[draw_idx].invocationSumTime == 1000U * (frame_idx + 1U));
+        }
+    }
+}
+
+// the queries go back to the pool when a frame is retired or the zones are cleared
+// so the pool stop to grow after the first frames
+static void TestQueryPoolReuse() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 2000U);
+    const auto record_frames = [](const uint32_t vFramesCount) {
+        for (uint32_t frame_idx = 0U; frame_idx < vFramesCount; ++frame_idx) {
+            {
+                IAGPNewFrame("Tests", "Frame");
+                for (uint32_t draw_idx = 0U; draw_idx < 8U; ++draw_idx) {
+                    IAGPScoped("Tests", "Draw %u", draw_idx);
+                    InAppGpuMockBackend::AdvanceClock(100U);
+                }
+            }
+            IAGPCollect;
+        }
+    };
+    record_frames(10U);
+    const auto stats = context_ptr->GetQueryPoolStats();
+    IAGP_CHECK(stats.capacity > 0U);
+    IAGP_CHECK(stats.inUse <= stats.capacity);
+    record_frames(100U);
+    IAGP_CHECK(context_ptr->GetQueryPoolStats().capacity == stats.capacity);
+    IAGP_CHECK(context_ptr->GetQueryPoolStats().chunksCount == stats.chunksCount);
+    IAGP_CHECK(context_ptr->GetQueryPoolStats().highWater == stats.highWater);
+
+    // the new zones take the queries released by the clear, without driver allocation
+    context_ptr->Clear();
+    IAGP_CHECK(context_ptr->GetZoneStore().size() == 0U);
+    record_frames(10U);
+    IAGP_CHECK(context_ptr->GetZoneStore().size() == 9U);
+    IAGP_CHECK(context_ptr->GetQueryPoolStats().capacity == stats.capacity);
+    IAGP_CHECK(context_ptr->GetQueryPoolStats().chunksCount == stats.chunksCount);
+}
+
+////////////////////////////////////////////////////////////
+/////////////////////// CALL SITES /////////////////////////
+////////////////////////////////////////////////////////////
+
+static void RecordHelper() {
+    IAGPScoped("Tests", "Helper");
+    InAppGpuMockBackend::AdvanceClock(100U);
+}
+
+// a helper called from two parents is one zone per parent
+static void TestCallSiteParents() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 0U);
+    const auto& store = context_ptr->GetZoneStore();
+    for (uint32_t frame_idx = 0U; frame_idx < 5U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            {
+                IAGPScoped("Tests", "A");
+                RecordHelper();
+            }
+            {
+                IAGPScoped("Tests", "B");
+                RecordHelper();
+                RecordHelper();
+            }
+        }
+        IAGPCollect;
+    }
+    IAGP_CHECK(store.size() == 5U);
+    const uint32_t a_idx = FindZone(store, 0U, "A");
+    const uint32_t b_idx = FindZone(store, 0U, "B");
+    IAGP_CHECK(a_idx != InAppGpuZoneStore::sInvalidIndex && b_idx != InAppGpuZoneStore::sInvalidIndex);
+    const uint32_t a_helper_idx = FindZone(store, a_idx, "Helper");
+    const uint32_t b_helper_idx = FindZone(store, b_idx, "Helper");
+    IAGP_CHECK(a_helper_idx != InAppGpuZoneStore::sInvalidIndex && b_helper_idx != InAppGpuZoneStore::sInvalidIndex);
+    if (a_helper_idx != InAppGpuZoneStore::sInvalidIndex && b_helper_idx != InAppGpuZoneStore::sInvalidIndex) {
+        IAGP_CHECK(store.lastCounts[a_helper_idx] == 1U);
+        IAGP_CHECK(store.lastCounts[b_helper_idx] == 2U);
+    }
+
+    // the cached zones of the call sites are invalid after a clear
+    InAppGpuProfiler::Instance()->Clear();
+    auto new_context_ptr = InAppGpuProfiler::Instance()->GetContextPtr(&s_Context);
+    {
+        IAGPNewFrame("Tests", "Frame");
+        RecordHelper();
+    }
+    IAGPCollect;
+    const auto& new_store = new_context_ptr->GetZoneStore();
+    IAGP_CHECK(new_store.size() == 2U);
+    IAGP_CHECK(FindZone(new_store, 0U, "Helper") == 1U);
+}
+
+// two threads record the same call sites in their own context in same time
+static void TestCallSiteThreads() {
+    static int s_Contexts[2] = {};
+    BeginTest(nullptr, 0U);
+    const auto record_thread = [](const uint32_t vThreadIdx) {
+        iagp_tests::SetCurrentContext(&s_Contexts[vThreadIdx]);
+        for (uint32_t frame_idx = 0U; frame_idx < 200U; ++frame_idx) {
+            {
+                IAGPNewFrame("Tests", "Frame");
+                if (vThreadIdx == 0U) {
+                    IAGPScoped("Tests", "A");
+                    {
+                        IAGPScoped("Tests", "B");  // the helper is deeper in this context
+                        RecordHelper();
+                    }
+                } else {
+                    RecordHelper();
+                }
+            }
+            IAGPCollect;
+        }
+        iagp_tests::SetCurrentContext(nullptr);
+    };
+    std::thread first_thread(record_thread, 0U);
+    std::thread second_thread(record_thread, 1U);
+    first_thread.join();
+    second_thread.join();
+    auto first_context_ptr = InAppGpuProfiler::Instance()->GetContextPtr(&s_Contexts[0]);
+    auto second_context_ptr = InAppGpuProfiler::Instance()->GetContextPtr(&s_Contexts[1]);
+    IAGP_CHECK(first_context_ptr != second_context_ptr);
+    const auto& first_store = first_context_ptr->GetZoneStore();
+    const auto& second_store = second_context_ptr->GetZoneStore();
+    IAGP_CHECK(first_store.size() == 4U);
+    IAGP_CHECK(second_store.size() == 2U);
+    if (first_store.size() == 4U && second_store.size() == 2U) {
+        IAGP_CHECK(first_store.zones[3].name == "Helper" && first_store.depths[3] == 3U && first_store.lastCounts[3] == 1U);
+        IAGP_CHECK(second_store.zones[1].name == "Helper" && second_store.depths[1] == 1U && second_store.lastCounts[1] == 1U);
+    }
+}
+
+////////////////////////////////////////////////////////////
+////////////////////// INVOCATIONS /////////////////////////
+////////////////////////////////////////////////////////////
+
+// a zone called several times in a frame sum its calls, and keep the min and the max of the calls
+// its bar go from the start of its first call to the end of its last call
+static void TestInvocations() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 0U);
+    const auto& store = context_ptr->GetZoneStore();
+    for (uint32_t frame_idx = 0U; frame_idx < 6U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            for (uint32_t call_idx = 0U; call_idx < 4U + frame_idx * 20U; ++call_idx) {
+                {
+                    IAGPScoped("Tests", "Draw");
+                    InAppGpuMockBackend::AdvanceClock(100000U * (call_idx % 4U + 1U));
+                }
+                InAppGpuMockBackend::AdvanceClock(50000U);  // the gpu do something else between the calls
+            }
+        }
+        IAGPCollect;
+        const uint32_t draw_idx = FindZone(store, 0U, "Draw");
+        IAGP_CHECK(draw_idx != InAppGpuZoneStore::sInvalidIndex);
+        if (draw_idx != InAppGpuZoneStore::sInvalidIndex) {
+            // 1 + 2 + 3 + 4 times 0.1 ms by group of 4 calls
+            const uint32_t calls_count = 4U + frame_idx * 20U;
+            IAGP_CHECK(store.lastCounts[draw_idx] == calls_count);
+            IAGP_CHECK(store.zones[draw_idx].invocationSumTime == (GLuint64)calls_count / 4U * 1000000U);
+            IAGP_CHECK(store.zones[draw_idx].invocationMinTime == 100000U);
+            IAGP_CHECK(store.zones[draw_idx].invocationMaxTime == 400000U);
+            // the gaps between the calls are in the bar, not in the sum
+            IAGP_CHECK(store.endTimeStamps[draw_idx] - store.startTimeStamps[draw_idx] == store.zones[draw_idx].invocationSumTime + (calls_count - 1U) * 50000U);
+        }
+    }
+    // the queries of the calls are reused
+    const auto stats = context_ptr->GetQueryPoolStats();
+    for (uint32_t frame_idx = 0U; frame_idx < 10U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            for (uint32_t call_idx = 0U; call_idx < 100U; ++call_idx) {
+                IAGPScoped("Tests", "Draw");
+                InAppGpuMockBackend::AdvanceClock(1000U);
+            }
+        }
+        IAGPCollect;
+    }
+    IAGP_CHECK(context_ptr->GetQueryPoolStats().chunksCount == stats.chunksCount);
+    // a spike of calls dont keep its queries in the frames
+    for (uint32_t frame_idx = 0U; frame_idx < IAGP_FRAMES_IN_FLIGHT * 2U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            IAGPScoped("Tests", "Draw");
+            InAppGpuMockBackend::AdvanceClock(1000U);
+        }
+        IAGPCollect;
+    }
+    IAGP_CHECK(context_ptr->GetQueryPoolStats().inUse < stats.inUse);
+    // the calls interleaved with another zone keep their real bounds
+    for (uint32_t frame_idx = 0U; frame_idx < 3U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            for (uint32_t call_idx = 0U; call_idx < 2U; ++call_idx) {
+                {
+                    IAGPScoped("Tests", "A");
+                    InAppGpuMockBackend::AdvanceClock(1000U);
+                }
+                {
+                    IAGPScoped("Tests", "B");
+                    InAppGpuMockBackend::AdvanceClock(2000U);
+                }
+            }
+        }
+        IAGPCollect;
+    }
+    const uint32_t a_idx = FindZone(store, 0U, "A");
+    const uint32_t b_idx = FindZone(store, 0U, "B");
+    IAGP_CHECK(a_idx != InAppGpuZoneStore::sInvalidIndex && b_idx != InAppGpuZoneStore::sInvalidIndex);
+    if (a_idx != InAppGpuZoneStore::sInvalidIndex && b_idx != InAppGpuZoneStore::sInvalidIndex) {
+        // A B A B : A end at the end of its second call, after the first B
+        IAGP_CHECK(store.zones[a_idx].invocationSumTime == 2000U && store.zones[b_idx].invocationSumTime == 4000U);
+        IAGP_CHECK(store.endTimeStamps[a_idx] - store.startTimeStamps[a_idx] == 4000U);
+        IAGP_CHECK(store.endTimeStamps[b_idx] - store.startTimeStamps[b_idx] == 5000U);
+        IAGP_CHECK(store.startTimeStamps[b_idx] < store.endTimeStamps[a_idx]);
+    }
+}
+
+////////////////////////////////////////////////////////////
+/////////////////////// HISTOGRAM //////////////////////////
+////////////////////////////////////////////////////////////
+
+// the error of a percentile is less than the half of a bucket
+static bool IsNear(const GLuint64 vValue, const GLuint64 vExpected) {
+    const double error = 0.5 / (double)(1U << IAGP_HISTOGRAM_SUB_BUCKETS_BITS);
+    return (double)vValue >= (double)vExpected * (1.0 - error) && (double)vValue <= (double)vExpected * (1.0 + error);
+}
+
+static void TestHistogram() {
+    InAppGpuHistogram histogram;
+    IAGP_CHECK(histogram.GetCount() == 0U);
+    IAGP_CHECK(histogram.GetPercentile(0.5) == 0U);
+    // 1 to 1000 us, the percentiles are the values
+    for (GLuint64 value = 1000U; value <= 1000000U; value += 1000U) {
+        histogram.AddValue(value);
+    }
+    IAGP_CHECK(histogram.GetCount() == 1000U);
+    IAGP_CHECK(histogram.GetMin() == 1000U);
+    IAGP_CHECK(histogram.GetMax() == 1000000U);
+    const auto percentiles = histogram.GetPercentiles();
+    IAGP_CHECK(IsNear(percentiles.p50, 500000U));
+    IAGP_CHECK(IsNear(percentiles.p95, 950000U));
+    IAGP_CHECK(IsNear(percentiles.p99, 990000U));
+    IAGP_CHECK(percentiles.p95 == histogram.GetPercentile(0.95));
+    IAGP_CHECK(histogram.GetPercentile(1.0) == histogram.GetMax());
+
+    // a spike change the max and the p99, not the p50
+    for (uint32_t idx = 0U; idx < 20U; ++idx) {
+        histogram.AddValue(50000000U);
+    }
+    IAGP_CHECK(histogram.GetMax() == 50000000U);
+    IAGP_CHECK(IsNear(histogram.GetPercentile(0.5), 510000U));
+    IAGP_CHECK(IsNear(histogram.GetPercentile(0.99), 50000000U));
+
+    histogram.Reset();
+    IAGP_CHECK(histogram.GetCount() == 0U);
+    histogram.AddValue(0U);
+    IAGP_CHECK(histogram.GetMin() == 0U && histogram.GetMax() == 0U);
+
+    // a full bucket halve all the buckets, the count and the percentiles stay right
+    histogram.Reset();
+    for (uint32_t idx = 0U; idx < 200000U; ++idx) {
+        histogram.AddValue((idx % 10U == 0U) ? 2000000U : 1000000U);
+    }
+    IAGP_CHECK(histogram.GetCount() == 200000U);
+    IAGP_CHECK(IsNear(histogram.GetPercentile(0.5), 1000000U));
+    IAGP_CHECK(IsNear(histogram.GetPercentile(0.95), 2000000U));
+    IAGP_CHECK(sizeof(InAppGpuHistogram) <= 512U);
+}
+
+////////////////////////////////////////////////////////////
+//////////////////// FLIGHT RECORDER ///////////////////////
+////////////////////////////////////////////////////////////
+
+// the frames are written in varints, with the deltas in zigzag, they must be loaded as recorded
+static void TestFlightRecorder() {
+    const std::string file_path_name = "iagp_tests.iagpfr";
+    InAppGpuZoneStore store;
+    const uint32_t root_idx = store.AddZone(InAppGpuZoneStore::sInvalidIndex, nullptr, "Frame", "Tests", HashZoneLabel("Tests", "Frame"), true);
+    const uint32_t draw_idx = store.AddZone(root_idx, nullptr, "Draw", "Tests", HashZoneLabel("Tests", "Draw"), false);
+    std::vector<InAppGpuCollectedZone> zones(2U);
+    zones[0].zoneIdx = root_idx;
+    zones[0].count = 1U;
+    zones[0].startTimeStamp = 1ULL << 40U;  // the varints have several bytes
+    zones[0].endTimeStamp = zones[0].startTimeStamp + 16000000U;
+    zones[0].cpuStartTimeStamp = zones[0].startTimeStamp - 3000000U;  // the cpu is before the gpu, a negative delta
+    zones[0].cpuEndTimeStamp = zones[0].cpuStartTimeStamp + 500000U;
+    zones[1].zoneIdx = draw_idx;
+    zones[1].count = 300U;
+    zones[1].startTimeStamp = zones[0].startTimeStamp + 1U;
+    zones[1].endTimeStamp = zones[1].startTimeStamp;  // empty
+    zones[1].cpuStartTimeStamp = zones[0].startTimeStamp - 1U;
+    zones[1].cpuEndTimeStamp = zones[1].cpuStartTimeStamp + 127U;
+
+    {
+        InAppGpuFlightRecorder recorder;
+        IAGP_CHECK(recorder.Open(file_path_name, 4096U, 4096U));
+        for (uint64_t frame_id = 0U; frame_id < 3U; ++frame_id) {
+            recorder.RecordFrame(0x123456789ULL, 7U, 1000000000000ULL + frame_id, store, zones);
+        }
+        recorder.Close();
+    }
+
+    std::vector<InAppGpuFlightRecorder::recordedName> names;
+    std::vector<InAppGpuFlightRecorder::recordedFrame> frames;
+    IAGP_CHECK(InAppGpuFlightRecorder::Load(file_path_name, names, frames));
+    IAGP_CHECK(names.size() == 2U);
+    if (names.size() == 2U) {
+        IAGP_CHECK(names[0].name == "Frame" && names[0].section == "Tests" && names[0].context == 0x123456789ULL && names[0].generation == 7U);
+        IAGP_CHECK(names[1].name == "Draw" && names[1].parentIdx == root_idx && names[1].zoneIdx == draw_idx);
+    }
+    IAGP_CHECK(frames.size() == 3U);
+    for (size_t frame_idx = 0U; frame_idx < frames.size(); ++frame_idx) {
+        const auto& frame = frames[frame_idx];
+        IAGP_CHECK(frame.frameId == 1000000000000ULL + frame_idx);
+        IAGP_CHECK(frame.context == 0x123456789ULL && frame.generation == 7U);
+        IAGP_CHECK(frame.zones.size() == zones.size());
+        for (size_t zone_idx = 0U; zone_idx < frame.zones.size() && zone_idx < zones.size(); ++zone_idx) {
+            const auto& zone = frame.zones[zone_idx];
+            const auto& expected = zones[zone_idx];
+            IAGP_CHECK(zone.zoneIdx == expected.zoneIdx && zone.count == expected.count);
+            IAGP_CHECK(zone.startTimeStamp == expected.startTimeStamp && zone.endTimeStamp == expected.endTimeStamp);
+            IAGP_CHECK(zone.cpuStartTimeStamp == expected.cpuStartTimeStamp && zone.cpuEndTimeStamp == expected.cpuEndTimeStamp);
+        }
+    }
+    remove(file_path_name.c_str());
+}
+
+////////////////////////////////////////////////////////////
+////////////////////// TRACE EXPORT ////////////////////////
+////////////////////////////////////////////////////////////
+
+// the events of the gpu track of the trace, one by line, with their time and duration in us
+struct traceEvent {
+    std::string name;
+    double ts = 0.0;
+    double dur = 0.0;
+};
+
+// one complete event by zone and by frame, in a json readable by chrome://tracing and perfetto
+static void TestTraceExport() {
+    static int s_Context = 0;
+    BeginTest(&s_Context, 0U);
+    const std::string file_path_name = "iagp_tests.json";
+    IAGP_CHECK(InAppGpuProfiler::Instance()->StartTraceExport(file_path_name));
+    IAGP_CHECK(InAppGpuProfiler::Instance()->IsTraceExporting());
+    for (uint32_t frame_idx = 0U; frame_idx < 5U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            InAppGpuMockBackend::AdvanceClock(1000U);
+            {
+                IAGPScoped("Tests", "Draw \"%u\"", 1U);  // the quotes are escaped
+                InAppGpuMockBackend::AdvanceClock(3000U);
+            }
+            InAppGpuMockBackend::AdvanceClock(6000U);
+        }
+        IAGPCollect;
+    }
+    InAppGpuProfiler::Instance()->StopTraceExport();
+    IAGP_CHECK(!InAppGpuProfiler::Instance()->IsTraceExporting());
+
+    std::string trace;
+    FILE* file_ptr = fopen(file_path_name.c_str(), "rb");
+    IAGP_CHECK(file_ptr != nullptr);
+    if (file_ptr != nullptr) {
+        char buffer[4096];
+        size_t read_size = 0U;
+        while ((read_size = fread(buffer, 1U, sizeof(buffer), file_ptr)) > 0U) {
+            trace.append(buffer, read_size);
+        }
+        fclose(file_ptr);
+    }
+    remove(file_path_name.c_str());
+    IAGP_CHECK(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0U);
+    IAGP_CHECK(trace.size() > 4U && trace.compare(trace.size() - 4U, 4U, "\n]}\n") == 0);
+    IAGP_CHECK(trace.find("\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU context") != std::string::npos);
+
+    // the gpu track is the tid 1, the frames are after each other, and the zones of a frame in the order of their ends
+    std::vector<traceEvent> events;
+    size_t line_start = 0U;
+    while (line_start < trace.size()) {
+        size_t line_end = trace.find('\n', line_start);
+        line_end = (line_end == std::string::npos) ? trace.size() : line_end;
+        const std::string line = trace.substr(line_start, line_end - line_start);
+        line_start = line_end + 1U;
+        if (line.find("\"ph\":\"X\"") == std::string::npos || line.find("\"tid\":1,") == std::string::npos) {
+            continue;
+        }
+        const size_t name_start = line.find("{\"name\":\"") + 9U;
+        const size_t name_end = line.find("\",\"cat\":\"Tests\"");
+        IAGP_CHECK(name_end != std::string::npos);
+        if (name_end == std::string::npos) {
+            continue;
+        }
+        traceEvent event;
+        event.name = line.substr(name_start, name_end - name_start);
+        IAGP_CHECK(sscanf(line.c_str() + line.find("\"ts\":"), "\"ts\":%lf,\"dur\":%lf", &event.ts, &event.dur) == 2);
+        events.push_back(event);
+    }
+    IAGP_CHECK(events.size() == 10U);
+    if (events.size() != 10U) {
+        return;
+    }
+    for (size_t idx = 0U; idx < events.size(); idx += 2U) {
+        const auto& draw = events[idx];
+        const auto& frame = events[idx + 1U];
+        IAGP_CHECK(draw.name == "Draw \\\"1\\\"" && frame.name == "Frame");
+        IAGP_CHECK(fabs(frame.dur - 10.0) < 1e-6 && fabs(draw.dur - 3.0) < 1e-6);
+        IAGP_CHECK(fabs(draw.ts - frame.ts - 1.0) < 1e-6);
+        if (idx > 0U) {
+            IAGP_CHECK(fabs(frame.ts - events[idx - 1U].ts - 10.0) < 1e-6);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+////////////////////////// LOD /////////////////////////////
+////////////////////////////////////////////////////////////
+
+// the small bars of a row are merged when they touch, in any order
+static void TestLodBlocks() {
+    InAppGpuLodBlock block;
+    IAGP_CHECK(block.IsContiguous(500.0f, 0.5f));  // an empty block take any bar
+    block.Add(10.0f, 0.5f, 1.0);
+    IAGP_CHECK(block.IsContiguous(11.0f, 0.5f));
+    block.Add(11.0f, 0.5f, 2.0);
+    IAGP_CHECK(block.start == 10.0f && block.end == 11.5f && block.count == 2U && block.time == 3.0);
+    // a bar at the left, touching the block
+    IAGP_CHECK(block.IsContiguous(8.8f, 0.5f));
+    block.Add(8.8f, 0.5f, 1.0);
+    IAGP_CHECK(block.start == 8.8f && block.end == 11.5f && block.count == 3U);
+    // far bars, at the right and at the left, must not stretch the block over the bars between them
+    IAGP_CHECK(!block.IsContiguous(100.0f, 0.5f));
+    IAGP_CHECK(!block.IsContiguous(2.0f, 0.5f));
+    // a bar in the block
+    IAGP_CHECK(block.IsContiguous(9.5f, 0.1f));
+}
+
+// one imgui frame with the horizontal flame graph, like the bench
+static void DrawFlameGraphFrame() {
+    auto* profiler_ptr = InAppGpuProfiler::Instance();
+    profiler_ptr->GetGraphTypeRef() = InAppGpuGraphTypeEnum::IN_APP_GPU_HORIZONTAL;
+    profiler_ptr->GetViewRef() = InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE;
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowSize(ImVec2(1920.0f, 540.0f));
+    if (ImGui::Begin("Flame Graph", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_MenuBar)) {
+        profiler_ptr->DrawFlamGraphNoWin();
+    }
+    ImGui::End();
+    ImGui::Render();
+}
+
+// with the lod, the labels are only computed for the bars large enough to show them
+// a root of 10 ms, a big child of 5 ms, and tiny childs of 1 us, less than a pixel
+static void TestLodLabels() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 0U);
+    const auto& store = context_ptr->GetZoneStore();
+    for (uint32_t frame_idx = 0U; frame_idx < 3U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            {
+                IAGPScoped("Tests", "Big");
+                InAppGpuMockBackend::AdvanceClock(5000000U);
+            }
+            for (uint32_t tiny_idx = 0U; tiny_idx < 100U; ++tiny_idx) {
+                IAGPScoped("Tests", "Tiny %u", tiny_idx);
+                InAppGpuMockBackend::AdvanceClock(1000U);
+            }
+            InAppGpuMockBackend::AdvanceClock(4900000U);
+        }
+        IAGPCollect;
+    }
+    IAGP_CHECK(store.size() == 102U);
+    const uint32_t big_idx = FindZone(store, 0U, "Big");
+    const uint32_t tiny_idx = FindZone(store, 0U, "Tiny 50");
+    IAGP_CHECK(big_idx != InAppGpuZoneStore::sInvalidIndex && tiny_idx != InAppGpuZoneStore::sInvalidIndex);
+    if (big_idx == InAppGpuZoneStore::sInvalidIndex || tiny_idx == InAppGpuZoneStore::sInvalidIndex) {
+        return;
+    }
+
+    ImGuiContext* imgui_context_ptr = ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    const bool use_lod = InAppGpuQueryZone::sUseLod;
+
+    InAppGpuQueryZone::sUseLod = true;
+    DrawFlameGraphFrame();
+    IAGP_CHECK(store.zones[0].barLabelKey == 1000);  // 10 ms, in 1/100 ms
+    IAGP_CHECK(store.zones[big_idx].barLabelKey == 500);
+    IAGP_CHECK(store.zones[big_idx].barLabel.find("Big (5.00 ms") == 0U);
+    uint32_t tiny_labels_count = 0U;
+    for (uint32_t idx = 0U; idx < store.size(); ++idx) {
+        if (store.zones[idx].name.find("Tiny") == 0U && store.zones[idx].barLabelKey != -1) {
+            ++tiny_labels_count;
+        }
+    }
+    IAGP_CHECK(tiny_labels_count == 0U);
+
+    // without the lod, every bar have its label
+    InAppGpuQueryZone::sUseLod = false;
+    DrawFlameGraphFrame();
+    IAGP_CHECK(store.zones[tiny_idx].barLabelKey == 0);  // 0.001 ms is rounded to 0.00
+    IAGP_CHECK(store.zones[tiny_idx].barLabel.find("Tiny 50 (0.00 ms") == 0U);
+
+    InAppGpuQueryZone::sUseLod = use_lod;
+    ImGui::DestroyContext(imgui_context_ptr);
+}
+
+////////////////////////////////////////////////////////////
+////////////////////// ZONE STORE //////////////////////////
+////////////////////////////////////////////////////////////
+
+// the arrays touched by the scopes and Collect stay small, the statistics and the ui are in the cold zones
+// about 144 bytes by zone, and 36 by frame in flight
+static void TestZoneStore() {
+    InAppGpuZoneStore store;
+    const uint32_t root_idx = store.AddZone(InAppGpuZoneStore::sInvalidIndex, nullptr, "Frame", "Tests", 0U, true);
+    for (uint32_t idx = 1U; idx < 1000U; ++idx) {
+        store.AddZone(root_idx, nullptr, "Draw", "Tests", idx, false);
+    }
+    IAGP_CHECK(store.size() == 1000U && store.zones.size() == 1000U);
+    IAGP_CHECK(store.GetHotBytes() / store.size() <= 160U + 40U * IAGP_FRAMES_IN_FLIGHT);
+    store.Clear();
+    IAGP_CHECK(store.size() == 0U && store.GetHotBytes() == 0U);
+}
+
+////////////////////////////////////////////////////////////
+///////////////////////// LAYOUT ///////////////////////////
+////////////////////////////////////////////////////////////
+
+static bool IsNearMs(const double vValue, const double vExpected) {
+    return fabs(vValue - vExpected) < 1e-9;
+}
+
+// the bars of the flame graph are placed from the times of the zones, relative to the root
+// root 0..10 us, A 1..4 us, A1 2..3 us, B 5..9 us
+static void TestZoneLayout() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 0U);
+    const auto& store = context_ptr->GetZoneStore();
+    for (uint32_t frame_idx = 0U; frame_idx < 5U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            InAppGpuMockBackend::AdvanceClock(1000U);
+            {
+                IAGPScoped("Tests", "A");
+                InAppGpuMockBackend::AdvanceClock(1000U);
+                {
+                    IAGPScoped("Tests", "A1");
+                    InAppGpuMockBackend::AdvanceClock(1000U);
+                }
+                InAppGpuMockBackend::AdvanceClock(1000U);
+            }
+            InAppGpuMockBackend::AdvanceClock(1000U);
+            {
+                IAGPScoped("Tests", "B");
+                InAppGpuMockBackend::AdvanceClock(4000U);
+            }
+            InAppGpuMockBackend::AdvanceClock(1000U);
+        }
+        IAGPCollect;
+    }
+    IAGP_CHECK(store.size() == 4U);
+    const uint32_t root_idx = FindZone(store, InAppGpuZoneStore::sInvalidIndex, "Frame");
+    const uint32_t a_idx = FindZone(store, root_idx, "A");
+    const uint32_t a1_idx = FindZone(store, a_idx, "A1");
+    const uint32_t b_idx = FindZone(store, root_idx, "B");
+    IAGP_CHECK(root_idx != InAppGpuZoneStore::sInvalidIndex && a_idx != InAppGpuZoneStore::sInvalidIndex);
+    IAGP_CHECK(a1_idx != InAppGpuZoneStore::sInvalidIndex && b_idx != InAppGpuZoneStore::sInvalidIndex);
+    if (store.size() != 4U || a1_idx == InAppGpuZoneStore::sInvalidIndex || b_idx == InAppGpuZoneStore::sInvalidIndex) {
+        return;
+    }
+    IAGP_CHECK(store.depths[root_idx] == 0U && store.depths[a_idx] == 1U && store.depths[a1_idx] == 2U && store.depths[b_idx] == 1U);
+    IAGP_CHECK(store.firstChilds[root_idx] == a_idx && store.nextSiblings[a_idx] == b_idx);
+    IAGP_CHECK(store.firstChilds[a_idx] == a1_idx && store.firstChilds[b_idx] == InAppGpuZoneStore::sInvalidIndex);
+
+    // the times are in ms, the smoothing of a constant time is the time
+    IAGP_CHECK(IsNearMs(store.startTimes[root_idx], 0.0) && IsNearMs(store.elapsedTimes[root_idx], 0.010));
+    IAGP_CHECK(IsNearMs(store.startTimes[a_idx], 0.001) && IsNearMs(store.elapsedTimes[a_idx], 0.003));
+    IAGP_CHECK(IsNearMs(store.startTimes[a1_idx], 0.002) && IsNearMs(store.elapsedTimes[a1_idx], 0.001));
+    IAGP_CHECK(IsNearMs(store.startTimes[b_idx], 0.005) && IsNearMs(store.elapsedTimes[b_idx], 0.004));
+
+    // the ratios of the bars on the root, and the childs in their parent
+    const double root_time = store.elapsedTimes[root_idx];
+    IAGP_CHECK(IsNearMs(store.startTimes[a_idx] / root_time, 0.1) && IsNearMs(store.elapsedTimes[a_idx] / root_time, 0.3));
+    IAGP_CHECK(IsNearMs(store.startTimes[a1_idx] / root_time, 0.2) && IsNearMs(store.elapsedTimes[a1_idx] / root_time, 0.1));
+    IAGP_CHECK(IsNearMs(store.startTimes[b_idx] / root_time, 0.5) && IsNearMs(store.elapsedTimes[b_idx] / root_time, 0.4));
+    for (const uint32_t idx : {a_idx, a1_idx, b_idx}) {
+        const uint32_t parent_idx = store.parents[idx];
+        IAGP_CHECK(store.startTimes[idx] >= store.startTimes[parent_idx] && store.endTimes[idx] <= store.endTimes[parent_idx]);
+    }
+    IAGP_CHECK(store.endTimes[a_idx] <= store.startTimes[b_idx]);  // the siblings dont overlap
+}
+
+////////////////////////////////////////////////////////////
+/////////////////////// AGGREGATES /////////////////////////
+////////////////////////////////////////////////////////////
+
+static uint32_t FindNode(const InAppGpuAggregateTree& vTree, const uint32_t vParentIdx, const char* vName) {
+    for (uint32_t idx = 0U; idx < vTree.size(); ++idx) {
+        if (vTree.parents[idx] == vParentIdx && vTree.names[idx] == vName) {
+            return idx;
+        }
+    }
+    return InAppGpuAggregateTree::sInvalidIndex;
+}
+
+static void RecordSectionHelper(const GLuint64 vTime) {
+    IAGPScoped("S2", "Helper");
+    InAppGpuMockBackend::AdvanceClock(vTime);
+}
+
+// a helper of the section S2 called by A and B of the section S1
+// A : 3 us, with 1 us of self time, B : 3.5 us with 0.5 us of self time, the helper : 2 us in A and 3 us in B
+static void TestAggregateViews() {
+    static int s_Context = 0;
+    auto context_ptr = BeginTest(&s_Context, 0U);
+    for (uint32_t frame_idx = 0U; frame_idx < 5U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            {
+                IAGPScoped("S1", "A");
+                InAppGpuMockBackend::AdvanceClock(1000U);
+                RecordSectionHelper(2000U);
+            }
+            {
+                IAGPScoped("S1", "B");
+                RecordSectionHelper(3000U);
+                InAppGpuMockBackend::AdvanceClock(500U);
+            }
+        }
+        IAGPCollect;
+    }
+    const auto* merged_ptr = context_ptr->GetAggregateTree(InAppGpuViewEnum::IN_APP_GPU_VIEW_MERGED);
+    const auto* bottom_up_ptr = context_ptr->GetAggregateTree(InAppGpuViewEnum::IN_APP_GPU_VIEW_BOTTOM_UP);
+    const auto* sections_ptr = context_ptr->GetAggregateTree(InAppGpuViewEnum::IN_APP_GPU_VIEW_SECTIONS);
+    IAGP_CHECK(merged_ptr != nullptr && bottom_up_ptr != nullptr && sections_ptr != nullptr);
+    IAGP_CHECK(context_ptr->GetAggregateTree(InAppGpuViewEnum::IN_APP_GPU_VIEW_TIMELINE) == nullptr);
+    if (merged_ptr == nullptr || bottom_up_ptr == nullptr || sections_ptr == nullptr) {
+        return;
+    }
+    const auto is_node = [](const InAppGpuAggregateTree& vTree, const uint32_t vNodeIdx, const double vTime, const GLuint vCount) {
+        return vNodeIdx != InAppGpuAggregateTree::sInvalidIndex && IsNearMs(vTree.elapsedTimes[vNodeIdx], vTime) && vTree.counts[vNodeIdx] == vCount;
+    };
+
+    // merged : the helper is one node with the time of its two parents, and one node under each parent
+    const auto& merged = *merged_ptr;
+    IAGP_CHECK(IsNearMs(merged.elapsedTimes[0], 0.0065));
+    const uint32_t merged_a_idx = FindNode(merged, 0U, "S1 : A");
+    IAGP_CHECK(is_node(merged, merged_a_idx, 0.003, 1U));
+    IAGP_CHECK(is_node(merged, FindNode(merged, 0U, "S1 : B"), 0.0035, 1U));
+    IAGP_CHECK(is_node(merged, FindNode(merged, 0U, "S2 : Helper"), 0.005, 2U));
+    IAGP_CHECK(is_node(merged, FindNode(merged, merged_a_idx, "S2 : Helper"), 0.002, 1U));
+
+    // bottom up : the self time of the helper, then its callers, then the root
+    const auto& bottom_up = *bottom_up_ptr;
+    IAGP_CHECK(IsNearMs(bottom_up.elapsedTimes[0], 0.0065));
+    const uint32_t helper_idx = FindNode(bottom_up, 0U, "S2 : Helper");
+    IAGP_CHECK(is_node(bottom_up, helper_idx, 0.005, 2U));
+    const uint32_t caller_a_idx = FindNode(bottom_up, helper_idx, "S1 : A");
+    IAGP_CHECK(is_node(bottom_up, caller_a_idx, 0.002, 1U));
+    IAGP_CHECK(is_node(bottom_up, FindNode(bottom_up, helper_idx, "S1 : B"), 0.003, 1U));
+    IAGP_CHECK(is_node(bottom_up, FindNode(bottom_up, caller_a_idx, "Tests : Frame"), 0.002, 1U));
+    IAGP_CHECK(is_node(bottom_up, FindNode(bottom_up, 0U, "S1 : A"), 0.001, 1U));
+
+    // sections : the self times summed by section, then by zone
+    const auto& sections = *sections_ptr;
+    IAGP_CHECK(IsNearMs(sections.elapsedTimes[0], 0.0065));
+    const uint32_t s1_idx = FindNode(sections, 0U, "S1");
+    IAGP_CHECK(is_node(sections, s1_idx, 0.0015, 2U));
+    IAGP_CHECK(is_node(sections, FindNode(sections, s1_idx, "A"), 0.001, 1U));
+    IAGP_CHECK(is_node(sections, FindNode(sections, s1_idx, "B"), 0.0005, 1U));
+    const uint32_t s2_idx = FindNode(sections, 0U, "S2");
+    IAGP_CHECK(is_node(sections, s2_idx, 0.005, 2U));
+    IAGP_CHECK(is_node(sections, FindNode(sections, s2_idx, "Helper"), 0.005, 2U));
+    IAGP_CHECK(is_node(sections, FindNode(sections, 0U, "Tests"), 0.0, 1U));
+}
+
+////////////////////////////////////////////////////////////
+////////////////////////// MAIN ////////////////////////////
+////////////////////////////////////////////////////////////
+
+struct testCase {
+    const char* name;
+    void (*func)();
+};
+
+int main(int argc, char** argv) {
+    static const testCase s_Tests[] = {
+        {"frame_ring", TestFrameRing},
+        {"frame_ring_no_latency", TestFrameRingNoLatency},
+        {"query_pool_reuse", TestQueryPoolReuse},
+        {"call_site_parents", TestCallSiteParents},
+        {"call_site_threads", TestCallSiteThreads},
+        {"invocations", TestInvocations},
+        {"histogram", TestHistogram},
+        {"flight_recorder", TestFlightRecorder},
+        {"trace_export", TestTraceExport},
+        {"lod_blocks", TestLodBlocks},
+        {"lod_labels", TestLodLabels},
+        {"zone_store", TestZoneStore},
+        {"zone_layout", TestZoneLayout},
+        {"aggregate_views", TestAggregateViews},
+    };
+    bool found = false;
+    for (const auto& test : s_Tests) {
+        if (argc > 1 && strcmp(argv[1], test.name) != 0) {
+            continue;
+        }
+        found = true;
+        const uint32_t failed_checks = s_FailedChecks;
+        test.func();
+        printf("%s : %s\n", test.name, (failed_checks == s_FailedChecks) ? "ok" : "failed");
+    }
+    InAppGpuProfiler::Instance()->Clear();
+    if (!found) {
+        printf("unknown test %s\n", argv[1]);
+        return 1;
+    }
+    return (s_FailedChecks == 0U) ? 0 : 1;
+}
@@ -0,0 +1,383 @@
+﻿/*
+MIT License
+
+Copyright (c) 2021-2024 Stephane Cuillerdier (aka aiekick)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// the tests of the vulkan backend, on a real device
+// without gpu they run on the mesa lavapipe driver :
+// VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ctest -R iagp_vulkan
+// each test is run by its name : iagp_vulkan_tests frames
+
+#include "iagp.h"
+
+#ifndef IAGP_USE_VULKAN
+#error "iagp_vulkan_tests need IAGP_USE_VULKAN"
+#endif  // IAGP_USE_VULKAN
+
+#include <cstring>
+#include <functional>
+
+using namespace iagp;
+
+static uint32_t s_FailedChecks = 0U;
+
+#define IAGP_CHECK(COND)                                                              \
+    if (!(COND)) {                                                                    \
+        printf("%s:%i : check failed : %s\n", __FILE__, __LINE__, #COND);            \
+        ++s_FailedChecks;                                                             \
+    }
+
+////////////////////////////////////////////////////////////
+///////////////////////// DEVICE ///////////////////////////
+////////////////////////////////////////////////////////////
+
+// one device and one queue, the command buffer is submitted and waited at each frame
+struct vulkanDevice {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t queueFamilyIndex = 0U;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+};
+static vulkanDevice s_Device;
+
+static bool HasDeviceExtension(VkPhysicalDevice vPhysicalDevice, const char* vName) {
+    uint32_t count = 0U;
+    vkEnumerateDeviceExtensionProperties(vPhysicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(vPhysicalDevice, nullptr, &count, extensions.data());
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, vName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool CreateDevice() {
+    VkApplicationInfo app_infos = {};
+    app_infos.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_infos.pApplicationName = "iagp_vulkan_tests";
+    app_infos.apiVersion = VK_API_VERSION_1_2;
+    VkInstanceCreateInfo instance_infos = {};
+    instance_infos.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instance_infos.pApplicationInfo = &app_infos;
+    if (vkCreateInstance(&instance_infos, nullptr, &s_Device.instance) != VK_SUCCESS) {
+        printf("cant create the vulkan instance\n");
+        return false;
+    }
+    uint32_t devices_count = 0U;
+    vkEnumeratePhysicalDevices(s_Device.instance, &devices_count, nullptr);
+    std::vector<VkPhysicalDevice> physical_devices(devices_count);
+    vkEnumeratePhysicalDevices(s_Device.instance, &devices_count, physical_devices.data());
+
+    // the first device with a queue having timestamps, and the host reset of the queries
+    for (const auto& physical_device : physical_devices) {
+        VkPhysicalDeviceHostQueryResetFeatures host_query_reset = {};
+        host_query_reset.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &host_query_reset;
+        vkGetPhysicalDeviceFeatures2(physical_device, &features);
+        if (host_query_reset.hostQueryReset != VK_TRUE) {
+            continue;
+        }
+        uint32_t families_count = 0U;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &families_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(families_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &families_count, families.data());
+        for (uint32_t family_idx = 0U; family_idx < families_count; ++family_idx) {
+            if (families[family_idx].timestampValidBits > 0U && (families[family_idx].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0U) {
+                s_Device.physicalDevice = physical_device;
+                s_Device.queueFamilyIndex = family_idx;
+                break;
+            }
+        }
+        if (s_Device.physicalDevice != VK_NULL_HANDLE) {
+            break;
+        }
+    }
+    if (s_Device.physicalDevice == VK_NULL_HANDLE) {
+        printf("no vulkan device with timestamps and hostQueryReset, set VK_DRIVER_FILES to the icd of lavapipe for run the tests without gpu\n");
+        return false;
+    }
+
+    const float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_infos = {};
+    queue_infos.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_infos.queueFamilyIndex = s_Device.queueFamilyIndex;
+    queue_infos.queueCount = 1U;
+    queue_infos.pQueuePriorities = &priority;
+    VkPhysicalDeviceHostQueryResetFeatures host_query_reset = {};
+    host_query_reset.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES;
+    host_query_reset.hostQueryReset = VK_TRUE;  // needed by the backend
+    std::vector<const char*> extensions;
+    if (HasDeviceExtension(s_Device.physicalDevice, "VK_EXT_calibrated_timestamps")) {
+        extensions.push_back("VK_EXT_calibrated_timestamps");  // else the cpu frames are aligned on the gpu frames
+    }
+    VkDeviceCreateInfo device_infos = {};
+    device_infos.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_infos.pNext = &host_query_reset;
+    device_infos.queueCreateInfoCount = 1U;
+    device_infos.pQueueCreateInfos = &queue_infos;
+    device_infos.enabledExtensionCount = (uint32_t)extensions.size();
+    device_infos.ppEnabledExtensionNames = extensions.data();
+    if (vkCreateDevice(s_Device.physicalDevice, &device_infos, nullptr, &s_Device.device) != VK_SUCCESS) {
+        printf("cant create the vulkan device\n");
+        return false;
+    }
+    vkGetDeviceQueue(s_Device.device, s_Device.queueFamilyIndex, 0U, &s_Device.queue);
+
+    VkCommandPoolCreateInfo pool_infos = {};
+    pool_infos.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_infos.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_infos.queueFamilyIndex = s_Device.queueFamilyIndex;
+    vkCreateCommandPool(s_Device.device, &pool_infos, nullptr, &s_Device.commandPool);
+    VkCommandBufferAllocateInfo command_buffer_infos = {};
+    command_buffer_infos.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_infos.commandPool = s_Device.commandPool;
+    command_buffer_infos.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_infos.commandBufferCount = 1U;
+    vkAllocateCommandBuffers(s_Device.device, &command_buffer_infos, &s_Device.commandBuffer);
+    VkFenceCreateInfo fence_infos = {};
+    fence_infos.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(s_Device.device, &fence_infos, nullptr, &s_Device.fence);
+
+    InAppGpuVulkanBackend::Init(s_Device.device, s_Device.physicalDevice, s_Device.queueFamilyIndex);
+    return true;
+}
+
+static void DestroyDevice() {
+    if (s_Device.device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(s_Device.device);
+        vkDestroyFence(s_Device.device, s_Device.fence, nullptr);
+        vkDestroyCommandPool(s_Device.device, s_Device.commandPool, nullptr);
+        vkDestroyDevice(s_Device.device, nullptr);
+    }
+    if (s_Device.instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(s_Device.instance, nullptr);
+    }
+    s_Device = vulkanDevice();
+}
+
+// the scopes of vRecordFunctor are recorded in the command buffer, submitted, and waited
+static void RecordFrame(const std::function<void()>& vRecordFunctor) {
+    vkResetCommandBuffer(s_Device.commandBuffer, 0U);
+    VkCommandBufferBeginInfo begin_infos = {};
+    begin_infos.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_infos.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(s_Device.commandBuffer, &begin_infos);
+    InAppGpuVulkanBackend::SetCommandBuffer(s_Device.commandBuffer);
+    vRecordFunctor();
+    vkEndCommandBuffer(s_Device.commandBuffer);
+    VkSubmitInfo submit_infos = {};
+    submit_infos.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_infos.commandBufferCount = 1U;
+    submit_infos.pCommandBuffers = &s_Device.commandBuffer;
+    vkQueueSubmit(s_Device.queue, 1U, &submit_infos, s_Device.fence);
+    vkWaitForFences(s_Device.device, 1U, &s_Device.fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(s_Device.device, 1U, &s_Device.fence);
+}
+
+// a fresh profiler, the scopes are recorded in the context of the device
+static IAGPContextPtr BeginTest() {
+    InAppGpuProfiler::sIsActive = true;
+    iagp_vulkan_tests::SetCurrentContext(&s_Device);
+    InAppGpuProfiler::Instance()->Clear();
+    IAGPCollect;  // the cleared contexts are released by the thread using them
+    return InAppGpuProfiler::Instance()->GetContextPtr(&s_Device);
+}
+
+static uint32_t FindZone(const InAppGpuZoneStore& vStore, const uint32_t vParentIdx, const char* vName) {
+    for (uint32_t idx = 0U; idx < vStore.size(); ++idx) {
+        if (vStore.parents[idx] == vParentIdx && vStore.zones[idx].name == vName) {
+            return idx;
+        }
+    }
+    return InAppGpuZoneStore::sInvalidIndex;
+}
+
+// the zones of the frame are collected, with times in their parents
+static void CheckZones(const InAppGpuZoneStore& vStore) {
+    for (uint32_t idx = 0U; idx < vStore.size(); ++idx) {
+        IAGP_CHECK(vStore.lastCounts[idx] == 1U);
+        IAGP_CHECK(vStore.startTimeStamps[idx] > 0U && vStore.endTimeStamps[idx] >= vStore.startTimeStamps[idx]);
+        const uint32_t parent_idx = vStore.parents[idx];
+        if (parent_idx != InAppGpuZoneStore::sInvalidIndex) {
+            IAGP_CHECK(vStore.startTimeStamps[idx] >= vStore.startTimeStamps[parent_idx]);
+            IAGP_CHECK(vStore.endTimeStamps[idx] <= vStore.endTimeStamps[parent_idx]);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+///////////////////////// FRAMES ///////////////////////////
+////////////////////////////////////////////////////////////
+
+// the frames are read back from the query pool of their slot, and the pool is reset for the next frames
+static void TestFrames() {
+    auto context_ptr = BeginTest();
+    IAGP_CHECK(context_ptr != nullptr);
+    if (context_ptr == nullptr) {
+        return;
+    }
+    const auto& store = context_ptr->GetZoneStore();
+    for (uint32_t frame_idx = 0U; frame_idx < 20U; ++frame_idx) {
+        RecordFrame([]() {
+            IAGPNewFrame("Tests", "Frame");
+            {
+                IAGPScoped("Tests", "A");
+                {
+                    IAGPScoped("Tests", "A1");
+                }
+            }
+            for (uint32_t draw_idx = 0U; draw_idx < 4U; ++draw_idx) {
+                IAGPScoped("Tests", "Draw %u", draw_idx);
+            }
+        });
+        IAGPCollect;
+        IAGP_CHECK(store.size() == 7U);
+        CheckZones(store);
+    }
+    const uint32_t a_idx = FindZone(store, 0U, "A");
+    IAGP_CHECK(a_idx != InAppGpuZoneStore::sInvalidIndex && FindZone(store, a_idx, "A1") != InAppGpuZoneStore::sInvalidIndex);
+
+    // the frames not collected are waited before their pool is reset
+    for (uint32_t frame_idx = 0U; frame_idx < IAGP_FRAMES_IN_FLIGHT; ++frame_idx) {
+        RecordFrame([]() {
+            IAGPNewFrame("Tests", "Frame");
+            IAGPScoped("Tests", "A");
+        });
+    }
+    context_ptr->Clear();
+    IAGP_CHECK(store.size() == 0U);
+    RecordFrame([]() {
+        IAGPNewFrame("Tests", "Frame");
+        IAGPScoped("Tests", "B");
+    });
+    IAGPCollect;
+    IAGP_CHECK(store.size() == 2U);
+    CheckZones(store);
+    IAGP_CHECK(iagp_vulkan_tests::GetErrorsCountRef() == 0U);
+}
+
+// a frame needing more queries than the pool of its slot take chunks, merged in one pool when the frame is retired
+static void TestPoolGrowth() {
+    auto context_ptr = BeginTest();
+    IAGP_CHECK(context_ptr != nullptr);
+    if (context_ptr == nullptr) {
+        return;
+    }
+    const auto& store = context_ptr->GetZoneStore();
+    for (const uint32_t draws_count : {4U, 200U, 200U, 50U, 300U}) {
+        for (uint32_t frame_idx = 0U; frame_idx < IAGP_FRAMES_IN_FLIGHT + 1U; ++frame_idx) {
+            context_ptr->Clear();
+            RecordFrame([draws_count]() {
+                IAGPNewFrame("Tests", "Frame");
+                for (uint32_t draw_idx = 0U; draw_idx < draws_count; ++draw_idx) {
+                    IAGPScoped("Tests", "Draw %u", draw_idx);
+                }
+            });
+            IAGPCollect;
+            IAGP_CHECK(store.size() == draws_count + 1U);
+            CheckZones(store);
+        }
+    }
+    IAGP_CHECK(iagp_vulkan_tests::GetErrorsCountRef() == 0U);
+}
+
+// the scopes without command buffer are logged one time, and their frame is collected without wait
+static void TestNullCommandBuffer() {
+    auto context_ptr = BeginTest();
+    IAGP_CHECK(context_ptr != nullptr);
+    if (context_ptr == nullptr) {
+        return;
+    }
+    const auto& store = context_ptr->GetZoneStore();
+    InAppGpuVulkanBackend::SetCommandBuffer(VK_NULL_HANDLE);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame_idx = 0U; frame_idx < IAGP_FRAMES_IN_FLIGHT * 2U; ++frame_idx) {
+        {
+            IAGPNewFrame("Tests", "Frame");
+            IAGPScoped("Tests", "A");
+        }
+        IAGPCollect;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    IAGP_CHECK(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() < (int64_t)IAGP_FENCE_TIMEOUT);
+    IAGP_CHECK(iagp_vulkan_tests::GetErrorsCountRef() == 1U);
+    IAGP_CHECK(store.size() == 2U);
+
+    // the next frames are measured
+    for (uint32_t frame_idx = 0U; frame_idx < IAGP_FRAMES_IN_FLIGHT + 1U; ++frame_idx) {
+        RecordFrame([]() {
+            IAGPNewFrame("Tests", "Frame");
+            IAGPScoped("Tests", "A");
+        });
+        IAGPCollect;
+    }
+    CheckZones(store);
+}
+
+////////////////////////////////////////////////////////////
+////////////////////////// MAIN ////////////////////////////
+////////////////////////////////////////////////////////////
+
+struct testCase {
+    const char* name;
+    void (*func)();
+};
+
+int main(int argc, char** argv) {
+    static const testCase s_Tests[] = {
+        {"frames", TestFrames},
+        {"pool_growth", TestPoolGrowth},
+        {"null_command_buffer", TestNullCommandBuffer},
+    };
+    if (!CreateDevice()) {
+        DestroyDevice();
+        return 1;
+    }
+    bool found = false;
+    for (const auto& test : s_Tests) {
+        if (argc > 1 && strcmp(argv[1], test.name) != 0) {
+            continue;
+        }
+        found = true;
+        const uint32_t failed_checks = s_FailedChecks;
+        iagp_vulkan_tests::GetErrorsCountRef() = 0U;
+        test.func();
+        printf("%s : %s\n", test.name, (failed_checks == s_FailedChecks) ? "ok" : "failed");
+    }
+    // the query pools are destroyed with the context, before the device
+    InAppGpuProfiler::Instance()->Clear();
+    IAGPCollect;
+    DestroyDevice();
+    if (!found) {
+        printf("unknown test %s\n", argv[1]);
+        return 1;
+    }
+    return (s_FailedChecks == 0U) ? 0 : 1;
+}
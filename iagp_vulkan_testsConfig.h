@@ -0,0 +1,66 @@
+﻿/*
+MIT License
+
+Copyright (c) 2021-2024 Stephane Cuillerdier (aka aiekick)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// the config of iagp_vulkan_tests, see iagpConfig.h for the other settings
+// the scopes of the tests are recorded in the context of the vulkan device of the tests
+
+#pragma once
+
+#include <cstdio>
+#include <cstdarg>
+#include <vulkan/vulkan.h>
+
+#include "iagpConfig.h"
+
+namespace iagp_vulkan_tests {
+inline void*& GetCurrentContextRef() {
+    static thread_local void* s_ContextPtr = nullptr;
+    return s_ContextPtr;
+}
+inline void* GetCurrentContext() {
+    return GetCurrentContextRef();
+}
+inline void SetCurrentContext(void* vContextPtr) {
+    GetCurrentContextRef() = vContextPtr;
+}
+inline uint32_t& GetErrorsCountRef() {
+    static uint32_t s_ErrorsCount = 0U;
+    return s_ErrorsCount;
+}
+inline void LogError(const char* vFmt, ...) {
+    ++GetErrorsCountRef();
+    va_list args;
+    va_start(args, vFmt);
+    vprintf(vFmt, args);
+    va_end(args);
+    printf("\n");
+}
+}  // namespace iagp_vulkan_tests
+
+#define IAGP_GET_CURRENT_CONTEXT iagp_vulkan_tests::GetCurrentContext
+#define IAGP_SET_CURRENT_CONTEXT iagp_vulkan_tests::SetCurrentContext
+#define IAGP_LOG_ERROR_MESSAGE iagp_vulkan_tests::LogError
+
+// small chunks, so the frames needing more queries than their pool are tested with few zones
+#define IAGP_QUERY_POOL_CHUNK_SIZE 64U